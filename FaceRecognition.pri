@@ -0,0 +1,15 @@
+# settings shared by every subproject
+
+CONFIG += c++11
+
+INCLUDEPATH += $$PWD/src
+DEPENDPATH += $$PWD/src
+
+unix:!macx: LIBS += -lopencv_core -lopencv_imgproc -lopencv_imgcodecs \
+                    -lopencv_highgui -lopencv_ml -lopencv_videoio \
+                    -lopencv_objdetect -fopenmp
+unix:!macx: INCLUDEPATH += /usr/local/include
+
+windows: LIBS += -lopencv_core310 -lopencv_imgproc310 -lopencv_imgcodecs310 \
+                 -lopencv_highgui310 -lopencv_ml310 -lopencv_videoio310 \
+                 -lopencv_objdetect310
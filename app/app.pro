@@ -0,0 +1,29 @@
+QT       += core gui
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+TARGET = FaceRecognition
+TEMPLATE = app
+
+include(../core/core.pri)
+
+# diagnostics on stdout, kept out of the core so the cli output stays
+# one json object per line
+DEFINES += DEBUG
+
+SOURCES += ../src/main.cpp \
+           ../src/mainwindow.cpp \
+           ../src/opencvcamera.cpp \
+           ../src/imageviewer.cpp \
+           ../src/trainingtask.cpp \
+           ../src/modelloadtask.cpp \
+           ../src/recognitionworker.cpp
+
+HEADERS  += ../src/mainwindow.h \
+            ../src/opencvcamera.h \
+            ../src/imageviewer.h \
+            ../src/trainingtask.h \
+            ../src/modelloadtask.h \
+            ../src/recognitionworker.h
+
+FORMS    += ../ui/mainwindow.ui
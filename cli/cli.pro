@@ -0,0 +1,19 @@
+# headless command line build, no QtWidgets needed
+
+QT       += core
+QT       -= gui
+
+TARGET = FaceRecognitionCli
+TEMPLATE = app
+
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../core/core.pri)
+
+SOURCES += ../src/cli.cpp \
+           ../src/trainingtask.cpp \
+           ../src/modelloadtask.cpp
+
+HEADERS  += ../src/trainingtask.h \
+            ../src/modelloadtask.h
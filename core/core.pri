@@ -0,0 +1,14 @@
+# links the core library, include before anything adding opencv
+# so the static library comes first on the link line
+
+win32:CONFIG(release, debug|release): CORE_DIR = $$OUT_PWD/../core/release
+else:win32:CONFIG(debug, debug|release): CORE_DIR = $$OUT_PWD/../core/debug
+else: CORE_DIR = $$OUT_PWD/../core
+
+LIBS += -L$$CORE_DIR -lFaceRecognitionCore
+
+win32-g++: PRE_TARGETDEPS += $$CORE_DIR/libFaceRecognitionCore.a
+else:win32: PRE_TARGETDEPS += $$CORE_DIR/FaceRecognitionCore.lib
+else: PRE_TARGETDEPS += $$CORE_DIR/libFaceRecognitionCore.a
+
+include(../FaceRecognition.pri)
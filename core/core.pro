@@ -0,0 +1,52 @@
+# everything that does not need qt, linked into the gui, the cli
+# and any benchmark or service binary built on top of it
+
+TARGET = FaceRecognitionCore
+TEMPLATE = lib
+
+CONFIG += staticlib
+CONFIG -= qt
+
+include(../FaceRecognition.pri)
+
+SOURCES += ../src/common.cpp \
+           ../src/process.cpp \
+           ../src/messenger.cpp \
+           ../src/classifier.cpp \
+           ../src/nearestneighbor.cpp \
+           ../src/hnswindex.cpp \
+           ../src/onevsrest.cpp \
+           ../src/svmevaluator.cpp \
+           ../src/modelbundle.cpp \
+           ../src/modelhandle.cpp \
+           ../src/datasplit.cpp \
+           ../src/projection.cpp \
+           ../src/featureselection.cpp \
+           ../src/trainingcheckpoint.cpp \
+           ../src/modelselection.cpp \
+           ../src/framesource.cpp \
+           ../src/framegrabber.cpp \
+           ../src/facedetector.cpp \
+           ../src/facetracker.cpp \
+           ../src/streamservice.cpp
+
+HEADERS  += ../src/common.h \
+            ../src/process.h \
+            ../src/messenger.h \
+            ../src/classifier.h \
+            ../src/nearestneighbor.h \
+            ../src/hnswindex.h \
+            ../src/onevsrest.h \
+            ../src/svmevaluator.h \
+            ../src/modelbundle.h \
+            ../src/modelhandle.h \
+            ../src/datasplit.h \
+            ../src/projection.h \
+            ../src/featureselection.h \
+            ../src/trainingcheckpoint.h \
+            ../src/modelselection.h \
+            ../src/framesource.h \
+            ../src/framegrabber.h \
+            ../src/facedetector.h \
+            ../src/facetracker.h \
+            ../src/streamservice.h
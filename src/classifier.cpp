@@ -11,6 +11,14 @@
 
 #define LTP_THRESHOLD 25
 #define MAX_ITERATION 1000
+// stop the gamma search after this many steps significantly
+// below the best accuracy seen so far
+#define EARLY_STOP_PATIENCE 20
+#define WILSON_Z 1.96
+// coarsest gamma step under a time budget, in training steps
+#define MAX_BUDGET_STRIDE 10
+// each fit shrinks the training rows by this ratio until it fits
+#define MEMORY_SHRINK_RATIO 0.9
 
 // macro
 #undef MIN
@@ -19,6 +27,22 @@
 #define IMAGE_WIDTH_KEY "ImageWidth"
 #define IMAGE_HEIGHT_KEY "ImageHeight"
 #define FEATURE_TYPE_KEY "FeatureType"
+#define BACKEND_KEY "Backend"
+#define REJECTION_THRESHOLD_KEY "RejectionThreshold"
+#define PLATT_A_KEY "PlattA"
+#define PLATT_B_KEY "PlattB"
+#define PROJECTION_TYPE_KEY "ProjectionType"
+#define PROJECTION_INPUT_KEY "ProjectionInput"
+#define PROJECTION_OUTPUT_KEY "ProjectionOutput"
+#define PROJECTION_MEAN_KEY "ProjectionMean"
+#define PROJECTION_BASIS_KEY "ProjectionBasis"
+#define SELECTION_INPUT_KEY "HaarSelectionInput"
+#define SELECTION_KEY "HaarSelection"
+
+#define PLATT_MAX_ITERATION 100
+#define PLATT_MIN_STEP 1e-10
+#define PLATT_SIGMA 1e-12
+#define PLATT_EPSILON 1e-5
 
 #ifdef QT_DEBUG
 using std::cout;
@@ -31,6 +55,7 @@ using cv::ml::TrainData;
 using cv::ml::ROW_SAMPLE;
 using cv::imread;
 using cv::resize;
+using cv::cvtColor;
 using cv::ml::StatModel;
 
 namespace classifier {
@@ -41,8 +66,47 @@ const double DEFAULT_IMAGE_SIZE = 64;
 const double DEFAULT_GAMMA = DEFAULT_G;
 const double MIN_GAMMA = 1e-16;
 const double TEST_ACCURACY_REQUIREMENT = 0.966;
+const int UNKNOWN_LABEL = INT_MIN;
+const double DEFAULT_FALSE_ACCEPT_RATE = 0.01;
+const double DEFAULT_FALSE_REJECT_RATE = 0.05;
+const int DEFAULT_TOP_K = 3;
+const unsigned int DEFAULT_SPLIT_SEED = 0;
+const long DEFAULT_SESSION_GAP = 60;
+const int DEFAULT_LATENCY_SAMPLES = 200;
 // local constants
 
+void computeFeature(Mat& image, FeatureType type, Mat& feature) {
+  unsigned int featureLength = 0;
+  switch (type) {
+    case LBP:
+      process::computeLBP(image, feature);
+      break;
+    case LTP:
+      process::computeLTP(image, feature, LTP_THRESHOLD);
+      break;
+    case CSLTP:
+      process::computeCSLTP(image, feature, LTP_THRESHOLD);
+      break;
+    case HAAR:
+      process::computeHaar(image, feature, featureLength);
+      break;
+  }
+}
+
+const char* featureName(FeatureType type) {
+  switch (type) {
+    case LBP:
+      return "LBP";
+    case LTP:
+      return "LTP";
+    case CSLTP:
+      return "CSLTP";
+    case HAAR:
+      return "HAAR";
+  }
+  return "";
+}
+
 /***** TrainingDataLoader ******/
 TrainingDataLoader::TrainingDataLoader(const LoadingParams params) {
   this->directory = params.directory;
@@ -52,11 +116,33 @@ TrainingDataLoader::TrainingDataLoader(const LoadingParams params) {
   this->posDir = params.posDir;
   this->negDir = params.negDir;
   this->imageSize = params.imageSize;
+  this->includeBackground = params.includeBackground;
+  this->seed = params.seed;
+  this->sessionGap = params.sessionGap;
 }
 
 void TrainingDataLoader::load(Mat& trainingData,
                               Mat& trainingLabel,
                               map<int,string>& names) {
+  DataSplit split;
+  this->load(trainingData, trainingLabel, names, split);
+}
+
+void TrainingDataLoader::load(Mat& trainingData,
+                              Mat& trainingLabel,
+                              map<int,string>& names,
+                              DataSplit& split) {
+  vector<FeatureType> types(1, featureType);
+  vector<Mat> data;
+  this->load(types, data, trainingLabel, names, split);
+  trainingData = data[0];
+}
+
+void TrainingDataLoader::load(const vector<FeatureType>& types,
+                              vector<Mat>& data,
+                              Mat& trainingLabel,
+                              map<int,string>& names,
+                              DataSplit& split) {
   // directory constants
   size_t trainingSize = 0, testingSize = 0;
   vector<string> userFiles, exclusion;
@@ -64,19 +150,26 @@ void TrainingDataLoader::load(Mat& trainingData,
   exclusion.push_back("..");
 
   scanDir(directory, userFiles, exclusion);
+  if (!includeBackground) {
+    // only enrolled identities become classes
+    userFiles.erase(std::remove(userFiles.begin(), userFiles.end(), bgDir),
+                    userFiles.end());
+  }
+  vector<vector<string> > trainingFiles(userFiles.size());
+  vector<vector<string> > testingFiles(userFiles.size());
+  vector<string> userPaths(userFiles.size());
   for (uint32_t i = 0 ; i < userFiles.size() ; i ++) {
-    string path;
-    vector<string> imagePaths;
     if (strcmp(userFiles[i].c_str(), bgDir.c_str()) == 0) {
       // background images
-      path = directory + string(SEPARATOR) + userFiles[i];
+      userPaths[i] = directory + string(SEPARATOR) + userFiles[i];
     } else {
       // users images
-      path = directory + string(SEPARATOR) + userFiles[i] + posDir;
+      userPaths[i] = directory + string(SEPARATOR) + userFiles[i] + posDir;
     }
-    scanDir(path, imagePaths, exclusion);
-    trainingSize += static_cast<size_t>(imagePaths.size() * percent);
-    testingSize += static_cast<size_t>(imagePaths.size() * (1-percent));
+    splitImages(userFiles[i], userPaths[i],
+                trainingFiles[i], testingFiles[i]);
+    trainingSize += trainingFiles[i].size();
+    testingSize += testingFiles[i].size();
 
     // mappings
     names.insert(pair<int,string>((i-userFiles.size()/2),
@@ -89,212 +182,210 @@ void TrainingDataLoader::load(Mat& trainingData,
 #endif
 
 #ifdef QT_DEBUG
-  sendMessage(QString("training size: ") +
-              QString::number(trainingSize));
+  sendMessage(string("training size: ") +
+              toString(trainingSize));
 #endif
 
-  // prepare the matrix for training
-  uint32_t featureLength = 0;
-  switch (featureType) {
-    case LBP:
-      featureLength = process::LBP_FEATURE_LENGTH;
-      break;
-    case LTP:
-      featureLength = process::LTP_FEATURE_LENGTH;
-      break;
-    case CSLTP:
-      featureLength = process::CSLTP_FEATURE_LENGTH;
-      break;
-    case HAAR:
-      featureLength = 0;
-      break;
-  }
+  // prepare one matrix per feature type
+  vector<uint32_t> featureLength(types.size(), 0);
+  string typeNames;
+  for (size_t t = 0 ; t < types.size() ; t ++) {
+    switch (types[t]) {
+      case LBP:
+        featureLength[t] = process::LBP_FEATURE_LENGTH;
+        break;
+      case LTP:
+        featureLength[t] = process::LTP_FEATURE_LENGTH;
+        break;
+      case CSLTP:
+        featureLength[t] = process::CSLTP_FEATURE_LENGTH;
+        break;
+      case HAAR:
+        featureLength[t] = 0;
+        break;
+    }
+    typeNames += string(t > 0 ? ", " : "") +
+        string(featureName(types[t]));
 
 #ifdef DEBUG
-  cout << "feature length: " << featureLength << endl;
+    cout << featureName(types[t]) << " feature length: "
+         << featureLength[t] << endl;
 #endif
 
 #ifdef QT_DEBUG
-  sendMessage(QString("feature length: ") +
-              QString::number(featureLength));
+    sendMessage(string(featureName(types[t])) +
+                string(" feature length: ") +
+                toString(featureLength[t]));
 #endif
+  }
 
-  // data
-  Mat tnd = Mat::zeros(trainingSize, featureLength, CV_32FC1);
-  Mat ttd = Mat::zeros(testingSize, featureLength, CV_32FC1);
-  // labels
-  Mat tnl = Mat::zeros(trainingSize, 1, CV_32SC1);
-  Mat ttl = Mat::zeros(testingSize, 1, CV_32SC1);
-  Mat image, X;
+  // every sample is written straight to its final row,
+  // training rows first and testing rows right after them
+  data.assign(types.size(), Mat());
+  for (size_t t = 0 ; t < types.size() ; t ++) {
+    data[t] = Mat::zeros(trainingSize + testingSize, featureLength[t],
+                         CV_32FC1);
+  }
+  trainingLabel = Mat::zeros(trainingSize + testingSize, 1, CV_32SC1);
+  extractionTime.clear();
+  vector<int64_t> extractionTicks(types.size(), 0);
+  Mat image, resized, gray, X;
 
-  // extracting lbp/ctlp data for individual samples
-  size_t trainingPos = 0, testingPos = 0;
+  // each image is decoded, resized and converted once,
+  // every extractor reads the same grayscale buffer
+  size_t trainingPos = 0, testingPos = trainingSize;
   for (uint32_t i = 0 ; i < userFiles.size() ; i ++) {
-    string path;
-    vector<string> imagePaths;
-    if (strcmp(userFiles[i].c_str(), bgDir.c_str()) == 0) {
-      // background images
-      path = directory + string(SEPARATOR) + userFiles[i];
-    } else {
-      // users images
-      path = directory + string(SEPARATOR) + userFiles[i] + posDir;
-    }
-    scanDir(path, imagePaths, exclusion);
-
 #ifdef DEBUG
     cout << "current training size: " << trainingPos << endl;
 #endif
 
 #ifdef QT_DEBUG
-    sendMessage(QString("current training size: ") +
-                QString::number(trainingPos));
+    sendMessage(string("current training size: ") +
+                toString(trainingPos));
 #endif
 
-    // read individual images for training
-    size_t trainingImageCount = static_cast<size_t>(imagePaths.size() * percent);
-    for (uint32_t j = 0 ; j < trainingImageCount ; j ++) {
-      QString processingType;
-      string briefMat;
-      string imagePath = path + string(SEPARATOR) + imagePaths[j];
+    const size_t trainingImageCount = trainingFiles[i].size();
+    const size_t testingImageCount = testingFiles[i].size();
+    for (size_t j = 0 ; j < trainingImageCount + testingImageCount ; j ++) {
+      const bool training = j < trainingImageCount;
+      string imagePath = userPaths[i] + string(SEPARATOR) +
+          (training ? trainingFiles[i][j]
+                    : testingFiles[i][j - trainingImageCount]);
       image = imread(imagePath);
+      if (!image.data) {
+        continue;
+      }
 
-      if (image.data) {
-        Mat resized = Mat::zeros(imageSize, image.type());
-        resize(image, resized, imageSize);
-        // compute feature
-        switch (featureType) {
-          case LBP:
-            process::computeLBP(resized, X);
-            processingType = "LBP";
-            break;
-          case LTP:
-            process::computeLTP(resized, X, LTP_THRESHOLD);
-            processingType = "LTP";
-            break;
-          case CSLTP:
-            process::computeCSLTP(resized, X, LTP_THRESHOLD);
-            processingType = "CSLTP";
-            break;
-          case HAAR:
-            process::computeHaar(resized, X, featureLength);
-            if (tnd.cols == 0) {
-              tnd = Mat::zeros(trainingSize, featureLength,
-                               CV_32FC1);
-            }
-            processingType = "HAAR";
-            break;
+      resize(image, resized, imageSize);
+      cvtColor(resized, gray, CV_BGR2GRAY);
+      size_t& pos = training ? trainingPos : testingPos;
+      for (size_t t = 0 ; t < types.size() ; t ++) {
+        const int64_t begin = cv::getTickCount();
+        computeFeature(gray, types[t], X);
+        extractionTicks[t] += cv::getTickCount() - begin;
+        if (data[t].cols == 0) {
+          // haar feature length is only known after the first image
+          featureLength[t] = X.cols;
+          data[t] = Mat::zeros(trainingSize + testingSize,
+                               featureLength[t], CV_32FC1);
         }
-
-#ifdef DEBUG
-      cout << "tnd.rows = " << tnd.rows << " j = " << j << endl;
-#endif
-
+        X.row(0).copyTo(data[t].row(pos));
+#ifdef QT_DEBUG
+        string briefMat;
         TrainingDataLoader::brief(X, briefMat);
-        sendMessage(QString("Training: loading image from ") +
-                    QString(imagePath.c_str()) +
-                    QString(" | processing image with ") +
-                    processingType);
-        sendMessage(QString("Training sample: ") +
-                    QString(briefMat.c_str()));
-
-        // copy the x sample to tnd
-        for (uint32_t k = 0 ; k < featureLength ; k ++) {
-          tnd.ptr<float>(j + trainingPos)[k] =
-              X.ptr<float>(0)[k];
-        }
-
-        // set label for this sample
-        tnl.ptr<int>(j + trainingPos)[0] = i - userFiles.size() / 2;
+        sendMessage(string("sample: ") + briefMat);
+#endif
       }
-    }
-    trainingPos += trainingImageCount;
-
-    // read individual images for testing
-    size_t testingImageCount = static_cast<size_t>(imagePaths.size() * (1-percent));
-    for (uint32_t j = 0 ; j < testingImageCount ; j ++) {
-      QString processingType;
-      string imagePath = path + string(SEPARATOR) +
-          imagePaths[j + (size_t)(imagePaths.size() * percent)];
-      image = imread(imagePath);
-
-      if (image.data) {
-        Mat resized = Mat::zeros(imageSize, image.type());
-        resize(image, resized, imageSize);
-        // compute feature
-        switch (featureType) {
-          case LBP:
-            process::computeLBP(resized, X);
-            processingType = "LBP";
-            break;
-          case LTP:
-            process::computeLTP(resized, X, LTP_THRESHOLD);
-            processingType = "LTP";
-            break;
-          case CSLTP:
-            process::computeCSLTP(resized, X, LTP_THRESHOLD);
-            processingType = "CSLTP";
-            break;
-          case HAAR:
-            process::computeHaar(resized, X, featureLength);
-            processingType = "HAAR";
-            if (ttd.cols == 0) {
-              ttd = Mat::zeros(testingSize, featureLength,
-                               CV_32FC1);
-            }
-            break;
-        }
+      trainingLabel.ptr<int>(pos)[0] = i - userFiles.size() / 2;
+      pos ++;
 
-        sendMessage(QString("Testing: loading image from ") +
-                    QString(imagePath.c_str()) +
-                    QString(" | processing image with ") +
-                    processingType);
+      sendMessage(string(training ? "Training" : "Testing") +
+                  string(": loading image from ") +
+                  imagePath +
+                  string(" | processing image with ") + typeNames);
+    }
+  }
 
-        // copy the x sample to tnd
-        for (uint32_t k = 0 ; k < featureLength ; k ++) {
-          ttd.ptr<float>(j + testingPos)[k] =
-              X.ptr<float>(0)[k];
-        }
-        // set label for this sample
-        ttl.ptr<int>(j + testingPos)[0] = i - userFiles.size() / 2;
+  // close the gap left by unreadable training images
+  const size_t testingCount = testingPos - trainingSize;
+  if (trainingPos < trainingSize) {
+    for (size_t r = 0 ; r < testingCount ; r ++) {
+      for (size_t t = 0 ; t < types.size() ; t ++) {
+        data[t].row(trainingSize + r).copyTo(
+            data[t].row(trainingPos + r));
       }
+      trainingLabel.ptr<int>(trainingPos + r)[0] =
+          trainingLabel.ptr<int>(trainingSize + r)[0];
     }
-    testingPos += testingImageCount;
   }
+  const size_t loaded = trainingPos + testingCount;
+  for (size_t t = 0 ; t < types.size() ; t ++) {
+    data[t] = data[t].rowRange(0, loaded);
+    extractionTime[types[t]] = loaded == 0 ? 0 :
+        extractionTicks[t] * 1000.0 / cv::getTickFrequency() / loaded;
+  }
+  trainingLabel = trainingLabel.rowRange(0, loaded);
+  split = DataSplit::ordered(trainingPos, testingCount);
 
-  // debug info
 #ifdef DEBUG
-//  cout << tnd << endl;
-//  cout << ttd << endl;
-//  cout << tnl << endl;
-//  cout << ttl << endl;
+  for (size_t t = 0 ; t < types.size() ; t ++) {
+    cout << data[t] << endl;
+  }
+  cout << trainingLabel << endl;
 #endif
+}
 
-  // put all data/lables into trainingData/Labels
-  trainingData = Mat::zeros(trainingSize + testingSize, featureLength, CV_32FC1);
-  trainingLabel = Mat::zeros(trainingSize + testingSize, 1, CV_32SC1);
+double TrainingDataLoader::getExtractionTime(FeatureType type) const {
+  auto it = extractionTime.find(type);
+  return it == extractionTime.end() ? 0 : it->second;
+}
 
-  const uint32_t cols = trainingData.cols;
-  for (uint32_t i = 0 ; i < trainingSize ; i ++) {
-    // training data
-    for (uint32_t j = 0 ; j < cols ; j ++) {
-      trainingData.ptr<float>(i)[j] = tnd.ptr<float>(i)[j];
+void TrainingDataLoader::splitImages(const string name, const string path,
+                                     vector<string>& training,
+                                     vector<string>& testing) {
+  vector<string> listing, imagePaths, exclusion;
+  exclusion.push_back(".");
+  exclusion.push_back("..");
+  scanDir(path, listing, exclusion);
+
+  // webcam frames taken in one sitting are near duplicates,
+  // so a whole session is either trained or tested
+  vector<long> captureTimes;
+  for (size_t i = 0 ; i < listing.size() ; i ++) {
+    const long time = getModifiedTime(path + string(SEPARATOR) +
+                                      listing[i]);
+    if (time != -1) {
+      imagePaths.push_back(listing[i]);
+      captureTimes.push_back(time);
     }
-    // training label
-    trainingLabel.ptr<int>(i)[0] = tnl.ptr<int>(i)[0];
   }
-  for (uint32_t i = 0 ; i < testingSize ; i ++) {
-    // testing data
-    for (uint32_t j = 0 ; j < cols ; j ++) {
-      trainingData.ptr<float>(i + trainingSize)[j] = ttd.ptr<float>(i)[j];
+  // the class name keeps the shuffle independent of directory order
+  vector<unsigned int> material(name.begin(), name.end());
+  material.push_back(seed);
+  std::seed_seq sequence(material.begin(), material.end());
+  unsigned int classSeed = 0;
+  sequence.generate(&classSeed, &classSeed + 1);
+
+  vector<int> trainIndex, testIndex;
+  DataSplit::holdOutSessions(captureTimes, sessionGap, 1.0 - percent,
+                             classSeed, trainIndex, testIndex);
+  training.clear();
+  testing.clear();
+  for (size_t i = 0 ; i < trainIndex.size() ; i ++) {
+    training.push_back(imagePaths[trainIndex[i]]);
+  }
+  for (size_t i = 0 ; i < testIndex.size() ; i ++) {
+    testing.push_back(imagePaths[testIndex[i]]);
+  }
+}
+
+void TrainingDataLoader::loadPerson(const string name, Mat& data) {
+  vector<string> imagePaths, exclusion;
+  exclusion.push_back(".");
+  exclusion.push_back("..");
+
+  string path;
+  if (name == bgDir) {
+    path = directory + string(SEPARATOR) + name;
+  } else {
+    path = directory + string(SEPARATOR) + name + posDir;
+  }
+  scanDir(path, imagePaths, exclusion);
+
+  data.release();
+  Mat image, resized, X;
+  for (size_t i = 0 ; i < imagePaths.size() ; i ++) {
+    string imagePath = path + string(SEPARATOR) + imagePaths[i];
+    image = imread(imagePath);
+    if (image.data) {
+      resize(image, resized, imageSize);
+      computeFeature(resized, featureType, X);
+      data.push_back(X);
     }
-    // testing label
-    trainingLabel.ptr<int>(i + trainingSize)[0] = ttl.ptr<int>(i)[0];
   }
 
-#ifdef DEBUG
-  cout << trainingData << endl;
-  cout << trainingLabel << endl;
-#endif
+  sendMessage(string("loaded ") + toString(data.rows) +
+              string(" images of ") + name);
 }
 
 void TrainingDataLoader::brief(const Mat& mat, string& str) {
@@ -564,6 +655,17 @@ FaceClassifier::FaceClassifier() {
   this->p = DEFAULT_P;
 
   this->imageSize = Size(DEFAULT_IMAGE_SIZE, DEFAULT_IMAGE_SIZE);
+  this->featureType = LBP;
+  this->backend = SVM_BACKEND;
+  this->rejection = false;
+  this->rejectionThreshold = 0;
+  this->calibrated = false;
+  this->plattA = 0;
+  this->plattB = 0;
+  this->projectionType = NO_PROJECTION;
+  this->projectionComponents = DEFAULT_PROJECTION_COMPONENTS;
+  this->selectionCount = DEFAULT_HAAR_SELECTION;
+  this->checkpoint = nullptr;
 
   this->setupSVM();
 }
@@ -582,9 +684,23 @@ FaceClassifier::FaceClassifier(FaceClassifierParams param) {
 
   // other parameter
   this->imageSize = param.imageSize;
+  this->featureType = param.featureType;
   this->trainingStep = param.trainingStep;
   this->testPercent = param.testingPercent;
 
+  // recognition backend
+  this->backend = param.backend;
+  this->nearestNeighbor.setDistance(param.distance);
+  this->rejection = false;
+  this->rejectionThreshold = 0;
+  this->calibrated = false;
+  this->plattA = 0;
+  this->plattB = 0;
+  this->projectionType = param.projection;
+  this->projectionComponents = param.projectionComponents;
+  this->selectionCount = param.haarSelection;
+  this->checkpoint = nullptr;
+
   this->setupSVM();
 }
 
@@ -603,9 +719,23 @@ FaceClassifier::FaceClassifier(FaceClassifierParams param,
 
   // other parameter
   this->imageSize = param.imageSize;
+  this->featureType = param.featureType;
   this->trainingStep = param.trainingStep;
   this->testPercent = param.testingPercent;
 
+  // recognition backend
+  this->backend = param.backend;
+  this->nearestNeighbor.setDistance(param.distance);
+  this->rejection = false;
+  this->rejectionThreshold = 0;
+  this->calibrated = false;
+  this->plattA = 0;
+  this->plattB = 0;
+  this->projectionType = param.projection;
+  this->projectionComponents = param.projectionComponents;
+  this->selectionCount = param.haarSelection;
+  this->checkpoint = nullptr;
+
   this->setupSVM();
   this->setupTrainingData(data, label);
 }
@@ -685,122 +815,412 @@ void FaceClassifier::setupTrainingData(Mat &data, Mat &label) {
   size_t trainingSize = data.rows - testingSize;
 
   if (data.type() == CV_32FC1 && label.type() == CV_32SC1) {
-    trainingData = Mat::zeros(trainingSize, data.cols, data.type());
-    testingData = Mat::zeros(testingSize, data.cols, data.type());
-    trainingLabel = Mat::zeros(trainingSize,
-                               label.cols, label.type());
-    testingLabel = Mat::zeros(testingSize,
-                              label.cols, label.type());
-
-    for (int i = 0 ; i < trainingData.rows ; i ++) {
-      for (int j = 0 ; j < trainingData.cols ; j ++) {
-        trainingData.ptr<float>(i)[j] =
-          data.ptr<float>(i)[j];
-      }
-      trainingLabel.ptr<int>(i)[0] = label.ptr<int>(i)[0];
-    }
-    for (int i = 0 ; i < testingData.rows ; i ++) {
-      for (int j = 0 ; j < testingData.cols ; j ++) {
-        testingData.ptr<float>(i)[j] =
-          data.ptr<float>(trainingData.rows + i)[j];
-      }
-      testingLabel.ptr<int>(i)[0] = label.ptr<int>(trainingLabel.rows + i)[0];
-    }
+    // shares the loader's buffers, the split only picks rows
+    this->samples = data;
+    this->sampleLabels = label;
+    this->setSplit(DataSplit::ordered(trainingSize, testingSize));
+  }
+}
+
+void FaceClassifier::setSplit(const DataSplit& newSplit) {
+  if (!this->samples.data || newSplit.isEmpty()) {
+    return;
+  }
+  this->split = newSplit;
+  DataSplit::select(samples, split.getTrainIndex(), trainingData);
+  DataSplit::select(samples, split.getTestIndex(), testingData);
+  DataSplit::select(sampleLabels, split.getTrainIndex(), trainingLabel);
+  DataSplit::select(sampleLabels, split.getTestIndex(), testingLabel);
+  if (selection.isEnabled() || projection.isEnabled()) {
+    Mat transformed;
+    this->transform(trainingData, transformed);
+    trainingData = transformed;
+    this->transform(testingData, transformed);
+    testingData = transformed;
+  }
+}
+
+void FaceClassifier::setCheckpoint(TrainingCheckpoint* checkpoint) {
+  this->checkpoint = checkpoint;
+}
+
+void FaceClassifier::setBudget(const TrainingBudget& budget) {
+  this->budget = budget;
+}
+
+void FaceClassifier::fitMemoryBudget() {
+  if (budget.memoryBytes == 0 || split.isEmpty() ||
+      backend == NEAREST_NEIGHBOR_BACKEND || backend == ANN_BACKEND) {
+    return;
+  }
+
+  // a fit copies the rows and caches kernel rows between them
+  const double rowBytes = trainingData.cols * 2.0 * sizeof(float);
+  double rows = trainingData.rows;
+  while (rows > 1 && rows * (rowBytes + rows * sizeof(float)) >
+         static_cast<double>(budget.memoryBytes)) {
+    rows *= MEMORY_SHRINK_RATIO;
+  }
+  if (rows >= trainingData.rows) {
+    return;
+  }
+
+  const vector<int> kept = DataSplit::subsample(
+      sampleLabels, split.getTrainIndex(), rows / trainingData.rows,
+      DEFAULT_SPLIT_SEED);
+  sendMessage(string("memory budget: training on ") +
+              toString(kept.size()) + string(" of ") +
+              toString(trainingData.rows) + string(" samples"));
+  this->setSplit(DataSplit(kept, split.getTestIndex()));
+}
+
+void FaceClassifier::transform(const Mat& features,
+                               Mat& transformed) const {
+  Mat selected;
+  selection.apply(features, selected);
+  projection.apply(selected, transformed);
+}
+
+void FaceClassifier::fitSelection() {
+  selection.clear();
+  projection.clear();
+  if (selectionCount <= 0 || split.isEmpty()) {
+    return;
+  }
+
+  // only haar codes are discrete per position. the length cannot
+  // tell, haar at 20 pixels is as long as lbp
+  if (featureType != HAAR) {
+    return;
+  }
+  if (backend == NEAREST_NEIGHBOR_BACKEND || backend == ANN_BACKEND) {
+    // the gallery compares whole histograms
+    sendMessage("haar selection skipped, the gallery needs raw histograms");
+    return;
+  }
+  this->setSplit(split);
+  const int length = trainingData.cols;
+  if (selectionCount >= length) {
+    return;
+  }
+  if (!selection.fit(trainingData, trainingLabel, selectionCount,
+                     process::HAAR_CODE_COUNT)) {
+    sendMessage("haar selection could not be fitted, keeping all positions");
+    return;
+  }
+  this->setSplit(split);
+  sendMessage(string("haar positions selected: ") +
+              toString(selection.getOutputLength()) +
+              string(" of ") +
+              toString(selection.getInputLength()));
+}
+
+void FaceClassifier::fitProjection() {
+  projection.clear();
+  if (projectionType == NO_PROJECTION) {
+    return;
   }
+  if (backend == NEAREST_NEIGHBOR_BACKEND || backend == ANN_BACKEND) {
+    // histogram distances are meaningless on projected rows
+    sendMessage("projection skipped, the gallery needs raw histograms");
+    return;
+  }
+
+  if (split.isEmpty()) {
+    sendMessage("projection needs the loaded samples, using raw features");
+    return;
+  }
+
+  // fitted on the training rows of the current split
+  this->setSplit(split);
+  if (!projection.fit(trainingData, trainingLabel,
+                      projectionType, projectionComponents)) {
+    sendMessage("projection could not be fitted, using raw features");
+    return;
+  }
+  this->setSplit(split);
+  sendMessage(string("feature projected from ") +
+              toString(projection.getInputLength()) +
+              string(" to ") +
+              toString(projection.getOutputLength()) +
+              string(" dimensions"));
 }
 
 void FaceClassifier::setImageSize(Size newSize) {
   this->imageSize = newSize;
 }
 
+Size FaceClassifier::getImageSize() {
+  return this->imageSize;
+}
+
+// values are numbers or base64, nothing to escape
+static void writeElement(std::ofstream& out, const char* key,
+                         const string& value) {
+  out << "<" << key << ">" << value << "</" << key << ">\n";
+}
+
+// enough digits for a float to read back unchanged
+static string exactString(float value) {
+  std::ostringstream stream;
+  stream.precision(9);
+  stream << value;
+  return stream.str();
+}
+
 void FaceClassifier::saveModel(const string modelPath,
                                const string extraInfoPath) {
-  this->svm->save(modelPath);
-
-  QFile nameMapFile(QString(extraInfoPath.c_str()));
+  if (backend == NEAREST_NEIGHBOR_BACKEND) {
+    this->nearestNeighbor.save(modelPath);
+  } else if (backend == ANN_BACKEND) {
+    this->annIndex.save(modelPath);
+  } else if (backend == ONE_VS_REST_BACKEND) {
+    this->oneVsRest.save(modelPath);
+  } else {
+    this->svm->save(modelPath);
+  }
 
-  if (nameMapFile.open(QIODevice::WriteOnly)) {
-    QXmlStreamWriter out(&nameMapFile);
-    out.setAutoFormatting(true);
-    out.setAutoFormattingIndent(2);
-    out.writeStartDocument();
+  std::ofstream out(extraInfoPath.c_str());
+  if (out.is_open()) {
+    // the layout QXmlStreamWriter used to write, older models still load
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
 
     // write image width/height and feature type to extra info
-    out.writeTextElement(IMAGE_WIDTH_KEY,
-                         QString::number(imageSize.width));
-    out.writeTextElement(IMAGE_HEIGHT_KEY,
-                         QString::number(imageSize.height));
-    out.writeTextElement(FEATURE_TYPE_KEY,
-                         QString::number(featureType));
+    writeElement(out, IMAGE_WIDTH_KEY, toString(imageSize.width));
+    writeElement(out, IMAGE_HEIGHT_KEY, toString(imageSize.height));
+    writeElement(out, FEATURE_TYPE_KEY, toString(featureType));
+    writeElement(out, BACKEND_KEY, toString(backend));
+    if (rejection) {
+      writeElement(out, REJECTION_THRESHOLD_KEY,
+                   exactString(rejectionThreshold));
+    }
+    if (calibrated) {
+      writeElement(out, PLATT_A_KEY, exactString(plattA));
+      writeElement(out, PLATT_B_KEY, exactString(plattB));
+    }
+    if (selection.isEnabled()) {
+      // int32 positions, base64 encoded
+      const vector<int>& columns = selection.getColumns();
+      writeElement(out, SELECTION_INPUT_KEY,
+                   toString(selection.getInputLength()));
+      writeElement(out, SELECTION_KEY, encodeBase64(
+          reinterpret_cast<const char*>(columns.data()),
+          columns.size() * sizeof(int)));
+    }
+    if (projection.isEnabled()) {
+      // raw float32 rows, base64 encoded
+      const Mat& mean = projection.getMean();
+      const Mat& basis = projection.getBasis();
+      writeElement(out, PROJECTION_TYPE_KEY, toString(projection.getType()));
+      writeElement(out, PROJECTION_INPUT_KEY, toString(basis.rows));
+      writeElement(out, PROJECTION_OUTPUT_KEY, toString(basis.cols));
+      writeElement(out, PROJECTION_MEAN_KEY, encodeBase64(
+          reinterpret_cast<const char*>(mean.data),
+          mean.total() * sizeof(float)));
+      writeElement(out, PROJECTION_BASIS_KEY, encodeBase64(
+          reinterpret_cast<const char*>(basis.data),
+          basis.total() * sizeof(float)));
+    }
+  }
+}
 
-    out.writeEndDocument();
+// wilson score interval of a binomial proportion
+static void wilsonInterval(double proportion, int count,
+                          double& lower, double& upper) {
+  if (count <= 0) {
+    lower = 0;
+    upper = 1;
+    return;
   }
+  const double z2 = WILSON_Z * WILSON_Z;
+  const double denominator = 1 + z2 / count;
+  const double centre = (proportion + z2 / (2 * count)) / denominator;
+  const double spread = WILSON_Z / denominator *
+      sqrt(proportion * (1 - proportion) / count + z2 / (4.0 * count * count));
+  lower = std::max(0.0, centre - spread);
+  upper = std::min(1.0, centre + spread);
 }
 
+// opencv thread count for the lifetime of the object. 0 leaves the
+// global setting alone, model selection trains candidates side by
+// side under a count it set itself
+class ThreadLimit {
+ public:
+  explicit ThreadLimit(int threads)
+      : previous(cv::getNumThreads()), changed(threads > 0) {
+    if (changed) {
+      cv::setNumThreads(threads);
+    }
+  }
+  ~ThreadLimit() {
+    if (changed) {
+      cv::setNumThreads(previous);
+    }
+  }
+
+ private:
+  int previous;
+  bool changed;
+};
+
 void FaceClassifier::train() {
   if (this->trainingData.data && this->trainingLabel.data &&
       this->testingData.data && this->testingLabel.data) {
+    ThreadLimit threadLimit(budget.threads);
+    const int64_t start = cv::getTickCount();
+    this->fitSelection();
+    this->fitProjection();
+    this->fitMemoryBudget();
+    if (backend == NEAREST_NEIGHBOR_BACKEND) {
+      this->trainNearestNeighbor();
+      return;
+    } else if (backend == ANN_BACKEND) {
+      this->trainANN();
+      return;
+    } else if (backend == ONE_VS_REST_BACKEND) {
+      this->trainOneVsRest();
+      return;
+    }
+
     // prepare training data
     Ptr<TrainData> td = TrainData::create(trainingData,
                                           ROW_SAMPLE,
                                           trainingLabel);
 
 #ifdef QT_DEBUG
-    sendMessage(QString("decreasing training parameter"));
+    sendMessage(string("decreasing training parameter"));
 #endif
 
     double maxAccuracy = 0;
     double maxGamma = 0;
     double accuracy = 0;
+    double lower = 0, upper = 0;
     double l = 0;
     double d = 0;
+    unsigned int worseCount = 0;
+    unsigned int first = 0;
+    double fitSeconds = 0;
+    Ptr<SVM> best;
+
+    SearchState state;
+    if (checkpoint != nullptr && checkpoint->loadSearch(state)) {
+      // continue right after the last fit that was recorded
+      first = state.iteration;
+      this->gamma = state.gamma;
+      this->degree = state.degree;
+      maxAccuracy = state.maxAccuracy;
+      maxGamma = state.maxGamma;
+      worseCount = state.worseCount;
+      this->setupSVM();
+      sendMessage(string("resuming gamma search at iteration ") +
+                  toString(first) +
+                  string(" | best test accuracy: ") +
+                  toString(maxAccuracy));
+    }
 
-    for (unsigned int i = 0 ; i < MAX_ITERATION ; i ++) {
-      this->svm->train(td);
-      accuracy = this->testAccuracy();
+    for (unsigned int i = first ; i < MAX_ITERATION ; i ++) {
+      const int64_t fitStart = cv::getTickCount();
+      double elapsed = (fitStart - start) / cv::getTickFrequency();
+      if (budget.seconds > 0 && i > first &&
+          elapsed + fitSeconds > budget.seconds) {
+        sendMessage(string("time budget spent after ") +
+                    toString(elapsed) + string(" s | stop searching"));
+        break;
+      }
+
+      this->svm->train(td);
+      accuracy = this->testAccuracy();
+      state.gammas.push_back(this->gamma);
+      state.accuracies.push_back(accuracy);
       if (accuracy > maxAccuracy) {
+        // setupSVM creates a new model, this one stays untouched
+        best = this->svm;
         maxAccuracy = accuracy;
         maxGamma = this->gamma;
+        if (checkpoint != nullptr) {
+          checkpoint->saveBestModel(this->svm);
+        }
       }
+      // slowest recent fit, a safe estimate for the next one
+      const double lastFit =
+          (cv::getTickCount() - fitStart) / cv::getTickFrequency();
+      fitSeconds = std::max(lastFit, 0.5 * (fitSeconds + lastFit));
+      elapsed += lastFit;
 
 #ifdef DEBUG
       fprintf(stdout, "test accuracy: %lf\n", accuracy);
 #endif
 
-      sendMessage(QString("test accuracy: ") +
-                  QString::number(accuracy) +
-                  QString(" | gamma = ") +
-                  QString::number(this->gamma) +
-                  QString(" | continue to update..."));
+      sendMessage(string("test accuracy: ") +
+                  toString(accuracy) +
+                  string(" | gamma = ") +
+                  toString(this->gamma) +
+                  string(" | continue to update..."));
+
+      // with a small held out set a lower accuracy can be noise,
+      // only a run of clearly worse gammas ends the search
+      wilsonInterval(accuracy, testingData.rows, lower, upper);
+      worseCount = upper < maxAccuracy ? worseCount + 1 : 0;
+      if (worseCount >= EARLY_STOP_PATIENCE) {
+        sendMessage(string("test accuracy: [") +
+                    toString(lower) + string(", ") +
+                    toString(upper) +
+                    string("] | below the best for ") +
+                    toString(worseCount) +
+                    string(" steps | stop searching"));
+        break;
+      }
 
       if (accuracy >= TEST_ACCURACY_REQUIREMENT) {
+        updateEvaluator();
         determineFeatureType();
-        sendMessage(QString("test accuracy: ") +
-                    QString::number(accuracy) +
-                    QString(" | requirement reach | stop training"));
+        sendMessage(string("test accuracy: ") +
+                    toString(accuracy) +
+                    string(" | requirement reach | stop training"));
         return;
       }
 
+      // short on time, skip candidates so the fits left still
+      // cover the gamma range the early stop needs to see
+      double step = trainingStep;
+      if (budget.seconds > 0 && fitSeconds > 0) {
+        const double fitsLeft =
+            std::max(1.0, (budget.seconds - elapsed) / fitSeconds);
+        if (fitsLeft < EARLY_STOP_PATIENCE) {
+          step *= std::min(static_cast<double>(MAX_BUDGET_STRIDE),
+                           ceil(EARLY_STOP_PATIENCE / fitsLeft));
+        }
+      }
+
       if (this->kernelType == LINEAR) {
       } else if (this->kernelType == POLY) {
         d = this->degree;
         d ++;
         this->degree = d;
         l = log10(this->gamma);
-        l -= trainingStep;
+        l -= step;
         this->gamma = pow(10, l);
       } else if (this->kernelType == RBF) {
         l = log10(this->gamma);
-        l -= trainingStep;
+        l -= step;
         this->gamma = pow(10, l);
       } else if (this->kernelType == SIGMOID) {
         l = log10(this->gamma);
-        l -= trainingStep;
+        l -= step;
         this->gamma = pow(10, l);
       }
 
       // set the variable after update
       this->setupSVM();
+      if (checkpoint != nullptr) {
+        state.iteration = i + 1;
+        state.gamma = this->gamma;
+        state.degree = this->degree;
+        state.maxAccuracy = maxAccuracy;
+        state.maxGamma = maxGamma;
+        state.worseCount = worseCount;
+        checkpoint->saveSearch(state);
+      }
       // break the loop if min gamma is reached
       if (this->gamma < MIN_GAMMA) {
         break;
@@ -811,15 +1231,29 @@ void FaceClassifier::train() {
     // use the gamma with highest testing accuracy
     this->gamma = maxGamma;
     this->setupSVM();
-    this->svm->train(td);
+    if (!best && checkpoint != nullptr &&
+        fileExists(checkpoint->getBestModelPath())) {
+      // the best fit was in an earlier run, it is on disk already
+      try {
+        best = StatModel::load<SVM>(checkpoint->getBestModelPath());
+      } catch (cv::Exception e) {
+        sendMessage("checkpointed model unreadable, training it again");
+      }
+    }
+    if (best && best->isTrained()) {
+      this->svm = best;
+    } else {
+      this->svm->train(td);
+    }
     accuracy = this->testAccuracy();
-    sendMessage(QString("cannot reach desire test accuracy | ") +
-                QString("using max test accuracy gamma | ") +
-                QString("test accuracy: ") +
-                QString::number(accuracy) +
-                QString(" | gamma = ") +
-                QString::number(this->gamma));
-
+    sendMessage(string("cannot reach desire test accuracy | ") +
+                string("using max test accuracy gamma | ") +
+                string("test accuracy: ") +
+                toString(accuracy) +
+                string(" | gamma = ") +
+                toString(this->gamma));
+
+    updateEvaluator();
     determineFeatureType();
   } else {
 #ifdef DEBUG
@@ -837,11 +1271,192 @@ void FaceClassifier::train(Mat& data, Mat& label) {
   this->train();
 }
 
+void FaceClassifier::updateEvaluator() {
+  // class labels in ascending order, same as inside cv::ml::SVM
+  std::set<int> labels;
+  for (int i = 0 ; i < trainingLabel.rows ; i ++) {
+    labels.insert(trainingLabel.ptr<int>(i)[0]);
+  }
+  if (!evaluator.build(svm, vector<int>(labels.begin(), labels.end()))) {
+    sendMessage("svm evaluator not built, predicting with cv::ml::SVM");
+  }
+}
+
+void FaceClassifier::trainNearestNeighbor() {
+  // enrollment is the whole training, no parameter to search
+  this->nearestNeighbor.clear();
+  this->nearestNeighbor.enroll(trainingData, trainingLabel);
+  determineFeatureType();
+
+  const double accuracy = this->testAccuracy();
+  sendMessage(string("nearest neighbor enrolled ") +
+              toString(trainingData.rows) +
+              string(" samples | test accuracy: ") +
+              toString(accuracy));
+}
+
+void FaceClassifier::trainANN() {
+  // the graph is built by incremental insert,
+  // the same path used to enroll new identities later
+  this->annIndex = HNSWIndex(nearestNeighbor.getDistance(),
+                             DEFAULT_HNSW_M,
+                             DEFAULT_HNSW_EF_CONSTRUCTION);
+  this->annIndex.insert(trainingData, trainingLabel);
+  determineFeatureType();
+
+  const double accuracy = this->testAccuracy();
+  sendMessage(string("ann index built over ") +
+              toString(annIndex.size()) +
+              string(" samples | test accuracy: ") +
+              toString(accuracy));
+}
+
+void FaceClassifier::trainOneVsRest() {
+  // every component uses the current gamma, there is no search
+  this->oneVsRest.setParams(this->gamma, this->c);
+  this->oneVsRest.train(trainingData, trainingLabel);
+  determineFeatureType();
+
+  const double accuracy = this->testAccuracy();
+  sendMessage(string("one vs rest trained ") +
+              toString(oneVsRest.size()) +
+              string(" identities | test accuracy: ") +
+              toString(accuracy) +
+              string(" | gamma = ") +
+              toString(this->gamma));
+}
+
+bool FaceClassifier::supportsEnrollment() {
+  return backend != SVM_BACKEND;
+}
+
+bool FaceClassifier::enroll(Mat& data, int label) {
+  if (!data.data || data.type() != CV_32FC1) {
+    sendMessage("no enrollment data prepared");
+    return false;
+  }
+  if (this->isLoaded() && data.cols != this->getFeatureLength()) {
+    sendMessage("enrollment data has inconsistant feature length");
+    return false;
+  }
+  Mat projected;
+  this->transform(data, projected);
+
+  switch (backend) {
+    case NEAREST_NEIGHBOR_BACKEND: {
+      std::lock_guard<std::mutex> lock(modelMutex);
+      this->nearestNeighbor.enroll(projected, label);
+      break;
+    }
+    case ANN_BACKEND: {
+      Mat labels(data.rows, 1, CV_32SC1, cv::Scalar(label));
+      std::lock_guard<std::mutex> lock(modelMutex);
+      this->annIndex.insert(projected, labels);
+      break;
+    }
+    case ONE_VS_REST_BACKEND:
+      // trains off the lock and swaps the component in atomically
+      this->oneVsRest.enroll(projected, label);
+      break;
+    default:
+      sendMessage("svm backend needs a full retraining to enroll");
+      return false;
+  }
+  determineFeatureType();
+  sendMessage(string("enrolled ") + toString(data.rows) +
+              string(" samples for label ") + toString(label));
+  return true;
+}
+
+void FaceClassifier::searchIdentities(Mat& sample, int k,
+                                      vector<pair<float, int> >& identities) {
+  identities.clear();
+  std::lock_guard<std::mutex> lock(modelMutex);
+  if (backend == ANN_BACKEND) {
+    this->annIndex.searchIdentities(sample, k, identities);
+  } else if (backend == NEAREST_NEIGHBOR_BACKEND) {
+    float distance = 0;
+    const int label = this->nearestNeighbor.predict(sample, &distance);
+    if (label != INT_MAX) {
+      identities.push_back(pair<float, int>(distance, label));
+    }
+  }
+}
+
+void FaceClassifier::decisionScores(Mat& sample, int k,
+                                    vector<pair<float, int> >& scores) {
+  // higher is more confident for every backend
+  scores.clear();
+  if (backend == NEAREST_NEIGHBOR_BACKEND || backend == ANN_BACKEND) {
+    std::lock_guard<std::mutex> lock(modelMutex);
+    if (backend == ANN_BACKEND) {
+      this->annIndex.searchIdentities(sample, k, scores);
+    } else if (k == 1) {
+      float distance = 0;
+      const int label = this->nearestNeighbor.predict(sample, &distance);
+      if (label != INT_MAX) {
+        scores.push_back(pair<float, int>(distance, label));
+      }
+    } else {
+      this->nearestNeighbor.searchIdentities(sample, k, scores);
+    }
+    for (size_t i = 0 ; i < scores.size() ; i ++) {
+      scores[i].first = -scores[i].first;
+    }
+    return;
+  } else if (backend == ONE_VS_REST_BACKEND) {
+    this->oneVsRest.decisionValues(sample, scores);
+  } else if (evaluator.isReady()) {
+    // ranked by votes, scored by the worst pairwise margin
+    vector<int> votes;
+    vector<double> margins;
+    if (!this->evaluator.classScores(sample, votes, margins)) {
+      return;
+    }
+    this->rankClasses(votes, margins, scores);
+  } else if (this->svm->isTrained()) {
+    // no evaluator, only the label is known
+    scores.push_back(pair<float, int>(
+        FLT_MAX, static_cast<int>(this->svm->predict(sample))));
+  }
+  if (static_cast<int>(scores.size()) > k) {
+    scores.resize(k);
+  }
+}
+
+int FaceClassifier::predictSample(Mat& sample) {
+  if (rejection) {
+    // label and score from the same evaluation
+    vector<pair<float, int> > scores;
+    this->decisionScores(sample, 1, scores);
+    if (scores.empty()) {
+      return INT_MAX;
+    }
+    return scores[0].first < rejectionThreshold ?
+        UNKNOWN_LABEL : scores[0].second;
+  }
+
+  if (backend == NEAREST_NEIGHBOR_BACKEND) {
+    std::lock_guard<std::mutex> lock(modelMutex);
+    return this->nearestNeighbor.predict(sample);
+  } else if (backend == ANN_BACKEND) {
+    std::lock_guard<std::mutex> lock(modelMutex);
+    return this->annIndex.predict(sample);
+  } else if (backend == ONE_VS_REST_BACKEND) {
+    return this->oneVsRest.predict(sample);
+  } else if (evaluator.isReady()) {
+    return this->evaluator.predict(sample);
+  }
+  return static_cast<int>(this->svm->predict(sample));
+}
+
 int FaceClassifier::predict(Mat& sample) {
-  if (this->svm->isTrained()) {
-    if (sample.rows == 1 && sample.cols == trainingData.cols &&
-        sample.type() == trainingData.type()) {
-      return this->svm->predict(sample);
+  if (this->isLoaded()) {
+    if (sample.rows == 1 && sample.cols == this->getFeatureLength() &&
+        sample.type() == CV_32FC1) {
+      Mat projected;
+      this->transform(sample, projected);
+      return this->predictSample(projected);
     } else {
 #ifdef DEBUG
       fprintf(stderr, "SVM not trained\n");
@@ -864,12 +1479,29 @@ int FaceClassifier::predict(Mat& sample) {
   }
 }
 
-int FaceClassifier::predictImageSample(Mat& imageSample) {
-  Mat sample, resized;
+bool FaceClassifier::computeSample(Mat& imageSample, Mat& sample) {
+  if (!this->extractFeature(imageSample, sample)) {
+    return false;
+  }
+  // the backends work in the projected space
+  if (projection.isEnabled()) {
+    Mat projected;
+    projection.apply(sample, projected);
+    sample = projected;
+  }
+  return true;
+}
+
+bool FaceClassifier::extractFeature(Mat& imageSample, Mat& sample) {
+  Mat resized;
   string briefMat;
 
-  resized = Mat::zeros(imageSize, imageSample.type());
-  resize(imageSample, resized, imageSize);
+  if (imageSample.size() == imageSize) {
+    // already cropped to the training size, e.g. by the camera
+    resized = imageSample;
+  } else {
+    resize(imageSample, resized, imageSize);
+  }
 
   switch (this->featureType) {
     case LBP:
@@ -882,13 +1514,29 @@ int FaceClassifier::predictImageSample(Mat& imageSample) {
       process::computeCSLTP(resized, sample, LTP_THRESHOLD);
       break;
     default:
+      if (selection.isEnabled()) {
+        // sparse, only the positions the model was trained on
+        const int box = static_cast<int>(process::HAAR_BOX_SIZE);
+        const int positions = (resized.cols - box) * (resized.rows - box);
+        if (positions != selection.getInputLength()) {
+#ifdef DEBUG
+          fprintf(stderr, "inconsistant feature length");
+#endif
+          return false;
+        }
+        process::computeHaar(resized, sample, selection.getColumns());
+        if (sample.cols != selection.getOutputLength()) {
+          return false;
+        }
+        break;
+      }
       unsigned int featureSize = 0;
       process::computeHaar(resized, sample, featureSize);
-      if (static_cast<int>(featureSize) != this->svm->getVarCount()) {
+      if (static_cast<int>(featureSize) != this->getFeatureLength()) {
 #ifdef DEBUG
         fprintf(stderr, "inconsistant feature length");
 #endif
-        return INT_MAX;
+        return false;
       }
       break;
   }
@@ -900,17 +1548,25 @@ int FaceClassifier::predictImageSample(Mat& imageSample) {
 
 #ifdef QT_DEBUG
   TrainingDataLoader::brief(sample, briefMat);
-  sendMessage(QString("sample mat: ") + QString(briefMat.c_str()));
+  sendMessage(string("sample mat: ") + briefMat);
 #endif
+  return true;
+}
+
+int FaceClassifier::predictImageSample(Mat& imageSample) {
+  Mat sample;
+  if (!this->computeSample(imageSample, sample)) {
+    return INT_MAX;
+  }
 
   // if the svm is train then predict the sample
-  if (this->svm->isTrained()) {
+  if (this->isLoaded()) {
 #ifdef DEBUG
-      cout << "feature length: " << this->svm->getVarCount() << endl;
+      cout << "feature length: " << this->getVarCount() << endl;
       cout << "sample length: " << sample.cols << endl;
 #endif
 
-      return this->svm->predict(sample);
+      return this->predictSample(sample);
   } else {
 #ifdef DEBUG
     fprintf(stderr, "SVM not trained\n");
@@ -923,51 +1579,262 @@ int FaceClassifier::predictImageSample(Mat& imageSample) {
   }
 }
 
+void FaceClassifier::rankClasses(const vector<int>& votes,
+                                 const vector<double>& margins,
+                                 vector<pair<float, int> >& scores) const {
+  vector<pair<pair<int, double>, int> > ranked;
+  for (size_t i = 0 ; i < votes.size() ; i ++) {
+    ranked.push_back(pair<pair<int, double>, int>(
+        pair<int, double>(votes[i], margins[i]),
+        evaluator.getClassLabel(i)));
+  }
+  std::sort(ranked.rbegin(), ranked.rend());
+  scores.clear();
+  for (size_t i = 0 ; i < ranked.size() ; i ++) {
+    scores.push_back(pair<float, int>(ranked[i].first.second,
+                                      ranked[i].second));
+  }
+}
+
+int FaceClassifier::recognize(Mat& imageSample, int k,
+                              vector<RecognitionResult>& results) {
+  results.clear();
+  Mat sample;
+  if (!this->isLoaded() || !this->computeSample(imageSample, sample)) {
+    return INT_MAX;
+  }
+
+  // label, ranking and confidence all come from one evaluation
+  vector<pair<float, int> > scores;
+  this->decisionScores(sample, k, scores);
+  return this->rankedResults(scores, results);
+}
+
+int FaceClassifier::recognize(vector<Mat>& imageSamples, int k,
+                              vector<vector<RecognitionResult> >& results,
+                              vector<int>& labels) {
+  results.assign(imageSamples.size(), vector<RecognitionResult>());
+  labels.assign(imageSamples.size(), INT_MAX);
+  if (!this->isLoaded() || imageSamples.empty()) {
+    return 0;
+  }
+
+  // every face of the frame becomes one row of a single batch
+  Mat features;
+  vector<int> rows;
+  for (size_t i = 0 ; i < imageSamples.size() ; i ++) {
+    Mat feature;
+    if (this->extractFeature(imageSamples[i], feature)) {
+      features.push_back(feature);
+      rows.push_back(static_cast<int>(i));
+    }
+  }
+  if (rows.empty()) {
+    return 0;
+  }
+  Mat samples;
+  projection.apply(features, samples);
+
+  vector<vector<int> > votes;
+  vector<vector<double> > margins;
+  const bool batched = backend == SVM_BACKEND && evaluator.isReady() &&
+      evaluator.classScores(samples, votes, margins);
+  int recognized = 0;
+  for (size_t r = 0 ; r < rows.size() ; r ++) {
+    vector<pair<float, int> > scores;
+    if (batched) {
+      this->rankClasses(votes[r], margins[r], scores);
+      if (static_cast<int>(scores.size()) > k) {
+        scores.resize(k);
+      }
+    } else {
+      Mat sample = samples.row(r);
+      this->decisionScores(sample, k, scores);
+    }
+    labels[rows[r]] = this->rankedResults(scores, results[rows[r]]);
+    if (labels[rows[r]] != INT_MAX) {
+      recognized ++;
+    }
+  }
+  return recognized;
+}
+
+int FaceClassifier::rankedResults(const vector<pair<float, int> >& scores,
+                                  vector<RecognitionResult>& results) {
+  results.clear();
+  if (scores.empty()) {
+    return INT_MAX;
+  }
+
+  vector<float> confidences(scores.size());
+  if (calibrated) {
+    for (size_t i = 0 ; i < scores.size() ; i ++) {
+      confidences[i] = confidence(scores[i].first);
+    }
+  } else {
+    // not calibrated, softmax over the candidates
+    double sum = 0;
+    for (size_t i = 0 ; i < scores.size() ; i ++) {
+      confidences[i] = exp(scores[i].first - scores[0].first);
+      sum += confidences[i];
+    }
+    for (size_t i = 0 ; i < scores.size() ; i ++) {
+      confidences[i] /= sum;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(modelMutex);
+  for (size_t i = 0 ; i < scores.size() ; i ++) {
+    RecognitionResult result;
+    result.label = scores[i].second;
+    result.score = scores[i].first;
+    result.confidence = confidences[i];
+    map<int, string>::const_iterator it = names.find(result.label);
+    if (it != names.end()) {
+      result.name = it->second;
+    }
+    results.push_back(result);
+  }
+
+  if (rejection && scores[0].first < rejectionThreshold) {
+    return UNKNOWN_LABEL;
+  }
+  return scores[0].second;
+}
+
+void FaceClassifier::setNames(const map<int, string>& names) {
+  std::lock_guard<std::mutex> lock(modelMutex);
+  this->names = names;
+}
+
+// text of <key>...</key>, found without a regex since the
+// projection elements can be megabytes long
+static bool readElement(const string& content, const char* key,
+                        string& value) {
+  const string open = string("<") + key + ">";
+  const string close = string("</") + key + ">";
+  const size_t start = content.find(open);
+  if (start == string::npos) {
+    return false;
+  }
+  const size_t end = content.find(close, start + open.length());
+  if (end == string::npos) {
+    return false;
+  }
+  value = content.substr(start + open.length(),
+                         end - start - open.length());
+  return true;
+}
+
 bool FaceClassifier::load(const string modelPath,
                           const string extraPath) {
   try {
-    svm = StatModel::load<SVM>(modelPath);
-
     // read extra info
-    QFile extraInfo(extraPath.c_str());
-    if (extraInfo.open(QIODevice::ReadOnly)) {
-      QTextStream reader(&extraInfo);
-      QString content = reader.readAll();
-
-      QRegExp widthFinder(QString("<") +
-                          QString(IMAGE_WIDTH_KEY) +
-                          ">([0-9]+)</" +
-                          QString(IMAGE_WIDTH_KEY) + ">");
-      QRegExp heightFinder(QString("<") +
-                          QString(IMAGE_HEIGHT_KEY) +
-                          ">([0-9]+)</" +
-                           QString(IMAGE_HEIGHT_KEY) + ">");
-      QRegExp featureFinder(QString("<") +
-                          QString(FEATURE_TYPE_KEY) +
-                          ">([0-9]+)</" +
-                           QString(FEATURE_TYPE_KEY) + ">");
-
-      if (widthFinder.indexIn(content)) {
-        QString width = widthFinder.cap(1);
-        imageSize.width = width.toDouble();
+    std::ifstream extraInfo(extraPath.c_str());
+    if (extraInfo.is_open()) {
+      std::ostringstream reader;
+      reader << extraInfo.rdbuf();
+      const string content = reader.str();
+
+      string width, height, feature;
+      if (readElement(content, IMAGE_WIDTH_KEY, width)) {
+        imageSize.width = atoi(width.c_str());
         sendMessage("image width: " + width);
       }
 
-      if (heightFinder.indexIn(content)) {
-        QString height = heightFinder.cap(1);
-        imageSize.height = height.toDouble();
+      if (readElement(content, IMAGE_HEIGHT_KEY, height)) {
+        imageSize.height = atoi(height.c_str());
         sendMessage("image height: " + height);
       }
 
-      if (featureFinder.indexIn(content)) {
-        QString feature = featureFinder.cap(1);
-        featureType = static_cast<FeatureType>(feature.toInt());
+      if (readElement(content, FEATURE_TYPE_KEY, feature)) {
+        featureType = static_cast<FeatureType>(atoi(feature.c_str()));
         sendMessage("feature type: " + feature);
       }
 
-      extraInfo.close();
+      // models written before the backend key are svm models
+      backend = SVM_BACKEND;
+      string backendValue;
+      if (readElement(content, BACKEND_KEY, backendValue)) {
+        backend = static_cast<FaceClassifierBackend>(
+            atoi(backendValue.c_str()));
+        sendMessage("backend: " + backendValue);
+      }
+
+      // without a threshold every face gets the closest label
+      rejection = false;
+      string threshold;
+      if (readElement(content, REJECTION_THRESHOLD_KEY, threshold)) {
+        this->setRejectionThreshold(
+            static_cast<float>(atof(threshold.c_str())));
+        sendMessage("rejection threshold: " + threshold);
+      }
+
+      calibrated = false;
+      string a, b;
+      if (readElement(content, PLATT_A_KEY, a) &&
+          readElement(content, PLATT_B_KEY, b)) {
+        calibrated = true;
+        plattA = static_cast<float>(atof(a.c_str()));
+        plattB = static_cast<float>(atof(b.c_str()));
+        sendMessage("confidence calibrated");
+      }
+
+      selection.clear();
+      string selectionInput, selectionText;
+      if (readElement(content, SELECTION_INPUT_KEY, selectionInput) &&
+          readElement(content, SELECTION_KEY, selectionText)) {
+        const string bytes = decodeBase64(selectionText);
+        vector<int> columns(bytes.size() / sizeof(int));
+        if (!columns.empty()) {
+          memcpy(columns.data(), bytes.data(),
+                 columns.size() * sizeof(int));
+        }
+        if (selection.attach(atoi(selectionInput.c_str()), columns)) {
+          sendMessage(string("haar positions selected: ") +
+                      toString(columns.size()));
+        }
+      }
+
+      projection.clear();
+      string projectionType, inputLength, outputLength;
+      string meanText, basisText;
+      if (readElement(content, PROJECTION_TYPE_KEY, projectionType) &&
+          readElement(content, PROJECTION_INPUT_KEY, inputLength) &&
+          readElement(content, PROJECTION_OUTPUT_KEY, outputLength) &&
+          readElement(content, PROJECTION_MEAN_KEY, meanText) &&
+          readElement(content, PROJECTION_BASIS_KEY, basisText)) {
+        const int rows = atoi(inputLength.c_str());
+        const int cols = atoi(outputLength.c_str());
+        const string meanBytes = decodeBase64(meanText);
+        const string basisBytes = decodeBase64(basisText);
+        if (rows > 0 && cols > 0 &&
+            meanBytes.size() == rows * sizeof(float) &&
+            basisBytes.size() == rows * cols * sizeof(float)) {
+          Mat mean(1, rows, CV_32FC1), basis(rows, cols, CV_32FC1);
+          memcpy(mean.data, meanBytes.data(), meanBytes.size());
+          memcpy(basis.data, basisBytes.data(), basisBytes.size());
+          projection.attach(
+              static_cast<ProjectionType>(atoi(projectionType.c_str())),
+              mean, basis);
+          sendMessage("feature projection: " + inputLength +
+                      " -> " + outputLength);
+        }
+      }
     }
 
+    if (backend == NEAREST_NEIGHBOR_BACKEND) {
+      return nearestNeighbor.load(modelPath);
+    } else if (backend == ANN_BACKEND) {
+      return annIndex.load(modelPath);
+    } else if (backend == ONE_VS_REST_BACKEND) {
+      return oneVsRest.load(modelPath);
+    }
+    svm = StatModel::load<SVM>(modelPath);
+
+    vector<int> classLabels;
+    SVMEvaluator::readClassLabels(modelPath, classLabels);
+    evaluator.build(svm, classLabels);
     return true;
   } catch (cv::Exception e) {
     sendMessage("Error: Not a valid svm:");
@@ -977,8 +1844,485 @@ bool FaceClassifier::load(const string modelPath,
   return false;
 }
 
+bool FaceClassifier::saveBundle(const string bundlePath,
+                                const map<int, string>& names) {
+  if (!this->isLoaded()) {
+    sendMessage("no model to write into the bundle");
+    return false;
+  }
+
+  ModelBundleWriter writer;
+  BundleMetadata metadata;
+  memset(&metadata, 0, sizeof(metadata));
+  metadata.backend = backend;
+  metadata.featureType = featureType;
+  metadata.imageWidth = imageSize.width;
+  metadata.imageHeight = imageSize.height;
+  metadata.varCount = this->getVarCount();
+  metadata.distance = backend == ANN_BACKEND ?
+      annIndex.getDistance() : nearestNeighbor.getDistance();
+  metadata.rejectionThreshold = rejectionThreshold;
+  metadata.flags = rejection ? BUNDLE_FLAG_REJECTION : 0;
+  writer.addSection(BUNDLE_METADATA, &metadata, sizeof(metadata));
+
+  vector<char> blob;
+  encodeNames(names, blob);
+  writer.addSection(BUNDLE_NAMES, blob.data(), blob.size());
+  if (calibrated) {
+    BundleCalibration calibration = {plattA, plattB, {0, 0}};
+    writer.addSection(BUNDLE_CALIBRATION, &calibration,
+                      sizeof(calibration));
+  }
+  if (selection.isEnabled()) {
+    const vector<int>& columns = selection.getColumns();
+    SelectionHeader header = {selection.getInputLength(),
+                              selection.getOutputLength(), {0, 0}};
+    writer.addSection(BUNDLE_SELECTION, &header, sizeof(header),
+                      columns.data(), columns.size() * sizeof(int));
+  }
+  if (projection.isEnabled()) {
+    const Mat& mean = projection.getMean();
+    const Mat& basis = projection.getBasis();
+    ProjectionHeader header = {projection.getType(), basis.rows,
+                               basis.cols, 0};
+    vector<char> rows(reinterpret_cast<const char*>(mean.data),
+                      reinterpret_cast<const char*>(mean.data) +
+                      mean.total() * sizeof(float));
+    rows.insert(rows.end(), reinterpret_cast<const char*>(basis.data),
+                reinterpret_cast<const char*>(basis.data) +
+                basis.total() * sizeof(float));
+    writer.addSection(BUNDLE_PROJECTION, &header, sizeof(header),
+                      rows.data(), rows.size());
+  }
+
+  std::lock_guard<std::mutex> lock(modelMutex);
+  if (backend == SVM_BACKEND) {
+    evaluator.serialize(blob);
+    if (blob.empty()) {
+      sendMessage("svm evaluator not built, bundle not written");
+      return false;
+    }
+    writer.addSection(BUNDLE_SVM, blob.data(), blob.size());
+  } else if (backend == NEAREST_NEIGHBOR_BACKEND) {
+    const Mat& gallery = nearestNeighbor.getGallery();
+    const Mat& labels = nearestNeighbor.getLabels();
+    GalleryHeader header = {gallery.rows, gallery.cols, {0, 0}};
+    writer.addSection(BUNDLE_GALLERY, &header, sizeof(header),
+                      gallery.data, gallery.total() * sizeof(float));
+    writer.addSection(BUNDLE_GALLERY_LABELS, labels.data,
+                      labels.total() * sizeof(int));
+  } else if (backend == ANN_BACKEND) {
+    GalleryHeader header = {static_cast<int32_t>(annIndex.size()),
+                            annIndex.getVarCount(), {0, 0}};
+    writer.addSection(BUNDLE_GALLERY, &header, sizeof(header),
+                      annIndex.getVectors(),
+                      annIndex.size() * annIndex.getVarCount() *
+                      sizeof(float));
+    writer.addSection(BUNDLE_GALLERY_LABELS, annIndex.getLabels(),
+                      annIndex.size() * sizeof(int));
+
+    GraphHeader graph;
+    vector<int> flat;
+    graph.m = annIndex.getM();
+    graph.efConstruction = annIndex.getEfConstruction();
+    annIndex.exportGraph(graph.entryPoint, graph.maxLevel, flat);
+    writer.addSection(BUNDLE_GRAPH, &graph, sizeof(graph),
+                      flat.data(), flat.size() * sizeof(int));
+  } else {
+    sendMessage("one vs rest models are only saved as xml");
+    return false;
+  }
+
+  if (!writer.write(bundlePath)) {
+    sendMessage(string("cannot write model bundle ") +
+                bundlePath);
+    return false;
+  }
+  return true;
+}
+
+bool FaceClassifier::loadBundle(const string bundlePath,
+                                map<int, string>& names) {
+  ModelBundleReader reader;
+  if (!reader.open(bundlePath)) {
+    sendMessage("Error: Not a valid model bundle");
+    return false;
+  }
+
+  size_t size = 0;
+  const char* section = reader.section(BUNDLE_METADATA, size);
+  if (section == nullptr || size < sizeof(BundleMetadata)) {
+    sendMessage("Error: model bundle has no metadata");
+    return false;
+  }
+  BundleMetadata metadata;
+  memcpy(&metadata, section, sizeof(metadata));
+
+  // every section is checked before anything of the current model is
+  // touched, a bad bundle leaves it as it was
+  map<int, string> bundleNames;
+  section = reader.section(BUNDLE_NAMES, size);
+  bool loaded = section == nullptr ||
+      decodeNames(section, size, bundleNames);
+
+  SVMEvaluator bundleEvaluator;
+  Mat gallery, labels;
+  HNSWIndex bundleIndex;
+  const HistogramDistance distance =
+      static_cast<HistogramDistance>(metadata.distance);
+  if (loaded && metadata.backend == SVM_BACKEND) {
+    // evaluated in place from the mapped file
+    section = reader.section(BUNDLE_SVM, size);
+    loaded = bundleEvaluator.attach(section, size);
+  } else if (loaded && (metadata.backend == NEAREST_NEIGHBOR_BACKEND ||
+                        metadata.backend == ANN_BACKEND)) {
+    GalleryHeader header;
+    size_t labelSize = 0;
+    section = reader.section(BUNDLE_GALLERY, size);
+    const char* labelSection =
+        reader.section(BUNDLE_GALLERY_LABELS, labelSize);
+    loaded = section != nullptr && size >= sizeof(header);
+    if (loaded) {
+      memcpy(&header, section, sizeof(header));
+      loaded = header.rows >= 0 && header.cols >= 0 &&
+          size - sizeof(header) >= sizeof(float) *
+          static_cast<size_t>(header.rows) * header.cols &&
+          labelSize >= sizeof(int) * static_cast<size_t>(header.rows);
+    }
+
+    if (loaded && metadata.backend == NEAREST_NEIGHBOR_BACKEND) {
+      // the gallery points into the mapped file, no copy
+      gallery = Mat(header.rows, header.cols, CV_32FC1,
+                    const_cast<char*>(section + sizeof(header)));
+      labels = Mat(header.rows, 1, CV_32SC1,
+                   const_cast<char*>(labelSection));
+    } else if (loaded) {
+      GraphHeader graph;
+      size_t graphSize = 0;
+      const char* graphSection = reader.section(BUNDLE_GRAPH, graphSize);
+      loaded = graphSection != nullptr && graphSize >= sizeof(graph);
+      if (loaded) {
+        memcpy(&graph, graphSection, sizeof(graph));
+        loaded = graph.m > 1;
+      }
+      if (loaded) {
+        bundleIndex = HNSWIndex(distance, graph.m, graph.efConstruction);
+        loaded = bundleIndex.importGraph(
+            header.rows ? header.cols : 0,
+            reinterpret_cast<const float*>(section + sizeof(header)),
+            reinterpret_cast<const int*>(labelSection), header.rows,
+            graph.entryPoint, graph.maxLevel,
+            reinterpret_cast<const int*>(graphSection + sizeof(graph)),
+            (graphSize - sizeof(graph)) / sizeof(int));
+      }
+    }
+  } else {
+    loaded = false;
+  }
+
+  // optional sections, but one that is present has to be whole
+  FeatureSelection bundleSelection;
+  section = reader.section(BUNDLE_SELECTION, size);
+  if (loaded && section != nullptr) {
+    SelectionHeader header;
+    loaded = size >= sizeof(header);
+    if (loaded) {
+      memcpy(&header, section, sizeof(header));
+      loaded = header.count > 0 && size - sizeof(header) >=
+          static_cast<size_t>(header.count) * sizeof(int32_t);
+    }
+    if (loaded) {
+      vector<int> columns(header.count);
+      memcpy(columns.data(), section + sizeof(header),
+             header.count * sizeof(int32_t));
+      loaded = bundleSelection.attach(header.inputLength, columns);
+    }
+  }
+  Projection bundleProjection;
+  section = reader.section(BUNDLE_PROJECTION, size);
+  if (loaded && section != nullptr) {
+    // mean and basis are used in place from the mapped file
+    ProjectionHeader header;
+    loaded = size >= sizeof(header);
+    if (loaded) {
+      memcpy(&header, section, sizeof(header));
+      loaded = header.inputLength > 0 && header.outputLength > 0 &&
+          size - sizeof(header) >= sizeof(float) *
+          static_cast<size_t>(header.inputLength) *
+          (static_cast<size_t>(header.outputLength) + 1);
+    }
+    if (loaded) {
+      char* rows = const_cast<char*>(section + sizeof(header));
+      Mat mean(1, header.inputLength, CV_32FC1, rows);
+      Mat basis(header.inputLength, header.outputLength, CV_32FC1,
+                rows + header.inputLength * sizeof(float));
+      loaded = bundleProjection.attach(
+          static_cast<ProjectionType>(header.type), mean, basis);
+    }
+  }
+  BundleCalibration calibration;
+  section = reader.section(BUNDLE_CALIBRATION, size);
+  const bool bundleCalibrated = section != nullptr;
+  if (loaded && bundleCalibrated) {
+    loaded = size >= sizeof(calibration);
+    if (loaded) {
+      memcpy(&calibration, section, sizeof(calibration));
+    }
+  }
+
+  if (!loaded) {
+    sendMessage("Error: model bundle is incomplete");
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(modelMutex);
+  // nothing may keep pointing into the previous mapping
+  evaluator.swap(bundleEvaluator);
+  nearestNeighbor.clear();
+  if (metadata.backend == NEAREST_NEIGHBOR_BACKEND) {
+    nearestNeighbor.setDistance(distance);
+    nearestNeighbor.attach(gallery, labels);
+  } else if (metadata.backend == ANN_BACKEND) {
+    annIndex = std::move(bundleIndex);
+  }
+  selection = bundleSelection;
+  projection = bundleProjection;
+  if (metadata.backend == SVM_BACKEND) {
+    this->setupSVM();
+  }
+  backend = static_cast<FaceClassifierBackend>(metadata.backend);
+  featureType = static_cast<FeatureType>(metadata.featureType);
+  imageSize = Size(metadata.imageWidth, metadata.imageHeight);
+  rejection = (metadata.flags & BUNDLE_FLAG_REJECTION) != 0;
+  rejectionThreshold = metadata.rejectionThreshold;
+  calibrated = bundleCalibrated;
+  if (calibrated) {
+    plattA = calibration.plattA;
+    plattB = calibration.plattB;
+  }
+  names.swap(bundleNames);
+  this->names = names;
+  // keeps the mapping alive as long as the model points into it
+  mappedModel = reader.getFile();
+  return true;
+}
+
+void FaceClassifier::setRejectionThreshold(float threshold) {
+  this->rejection = true;
+  this->rejectionThreshold = threshold;
+}
+
+void FaceClassifier::disableRejection() {
+  this->rejection = false;
+}
+
+bool FaceClassifier::hasRejection() {
+  return this->rejection;
+}
+
+float FaceClassifier::getRejectionThreshold() {
+  return this->rejectionThreshold;
+}
+
+bool FaceClassifier::calibrateRejection(const Mat& impostorData,
+                                        double falseAcceptRate) {
+  if (!this->isLoaded() || !testingData.data) {
+    sendMessage("no held out data to calibrate the rejection threshold");
+    return false;
+  }
+
+  // best score of correctly recognized held out samples
+  // and of faces that belong to nobody
+  vector<float> genuine, impostor;
+  vector<pair<float, int> > scores;
+  for (int i = 0 ; i < testingData.rows ; i ++) {
+    Mat sample = testingData.row(i);
+    this->decisionScores(sample, 1, scores);
+    if (!scores.empty() && scores[0].second == testingLabel.ptr<int>(i)[0]) {
+      genuine.push_back(scores[0].first);
+    }
+  }
+  Mat impostors;
+  this->transform(impostorData, impostors);
+  for (int i = 0 ; i < impostors.rows ; i ++) {
+    Mat sample = impostors.row(i);
+    this->decisionScores(sample, 1, scores);
+    if (!scores.empty()) {
+      impostor.push_back(scores[0].first);
+    }
+  }
+  if (genuine.empty()) {
+    sendMessage("no correctly recognized held out sample to calibrate with");
+    return false;
+  }
+  std::sort(genuine.begin(), genuine.end());
+  std::sort(impostor.begin(), impostor.end());
+
+  float threshold = 0;
+  if (!impostor.empty()) {
+    // lowest threshold that keeps false accepts within the target
+    const size_t accepted = static_cast<size_t>(
+        falseAcceptRate * impostor.size());
+    threshold = accepted >= impostor.size() ? genuine[0] :
+        std::nextafter(impostor[impostor.size() - accepted - 1], FLT_MAX);
+  } else {
+    // no impostors, give up a fixed share of the known faces
+    threshold = genuine[static_cast<size_t>(
+        DEFAULT_FALSE_REJECT_RATE * (genuine.size() - 1))];
+  }
+  this->setRejectionThreshold(threshold);
+
+  const size_t falseRejects = std::lower_bound(
+      genuine.begin(), genuine.end(), threshold) - genuine.begin();
+  const size_t falseAccepts = impostor.end() - std::lower_bound(
+      impostor.begin(), impostor.end(), threshold);
+  sendMessage(string("rejection threshold: ") +
+              toString(threshold) +
+              string(" | false reject: ") +
+              toString(static_cast<double>(falseRejects) /
+                              genuine.size()) +
+              string(" | false accept: ") +
+              (impostor.empty() ? string("n/a") :
+               toString(static_cast<double>(falseAccepts) /
+                               impostor.size())));
+  return true;
+}
+
+// platt scaling, newton method with backtracking line search
+// (Lin, Lin and Weng, a note on platt's probabilistic outputs)
+static bool fitSigmoid(const vector<float>& scores,
+                       const vector<bool>& positive,
+                       double& A, double& B) {
+  double prior1 = 0, prior0 = 0;
+  for (size_t i = 0 ; i < positive.size() ; i ++) {
+    if (positive[i]) prior1 ++; else prior0 ++;
+  }
+  if (prior1 == 0 || prior0 == 0) {
+    return false;
+  }
+
+  const double hiTarget = (prior1 + 1) / (prior1 + 2);
+  const double loTarget = 1 / (prior0 + 2);
+  vector<double> t(scores.size());
+  for (size_t i = 0 ; i < scores.size() ; i ++) {
+    t[i] = positive[i] ? hiTarget : loTarget;
+  }
+
+  A = 0;
+  B = log((prior0 + 1) / (prior1 + 1));
+  double fval = 0;
+  for (size_t i = 0 ; i < scores.size() ; i ++) {
+    const double f = scores[i] * A + B;
+    fval += f >= 0 ? t[i] * f + log(1 + exp(-f)) :
+        (t[i] - 1) * f + log(1 + exp(f));
+  }
+
+  for (int iteration = 0 ; iteration < PLATT_MAX_ITERATION ; iteration ++) {
+    double h11 = PLATT_SIGMA, h22 = PLATT_SIGMA, h21 = 0, g1 = 0, g2 = 0;
+    for (size_t i = 0 ; i < scores.size() ; i ++) {
+      const double f = scores[i] * A + B;
+      double p, q;
+      if (f >= 0) {
+        p = exp(-f) / (1 + exp(-f));
+        q = 1 / (1 + exp(-f));
+      } else {
+        p = 1 / (1 + exp(f));
+        q = exp(f) / (1 + exp(f));
+      }
+      const double d2 = p * q;
+      h11 += scores[i] * scores[i] * d2;
+      h22 += d2;
+      h21 += scores[i] * d2;
+      const double d1 = t[i] - p;
+      g1 += scores[i] * d1;
+      g2 += d1;
+    }
+    if (fabs(g1) < PLATT_EPSILON && fabs(g2) < PLATT_EPSILON) {
+      break;
+    }
+
+    const double det = h11 * h22 - h21 * h21;
+    const double dA = -(h22 * g1 - h21 * g2) / det;
+    const double dB = -(-h21 * g1 + h11 * g2) / det;
+    const double gd = g1 * dA + g2 * dB;
+    double step = 1;
+    while (step >= PLATT_MIN_STEP) {
+      const double newA = A + step * dA;
+      const double newB = B + step * dB;
+      double newf = 0;
+      for (size_t i = 0 ; i < scores.size() ; i ++) {
+        const double f = scores[i] * newA + newB;
+        newf += f >= 0 ? t[i] * f + log(1 + exp(-f)) :
+            (t[i] - 1) * f + log(1 + exp(f));
+      }
+      if (newf < fval + 0.0001 * step * gd) {
+        A = newA;
+        B = newB;
+        fval = newf;
+        break;
+      }
+      step /= 2;
+    }
+    if (step < PLATT_MIN_STEP) {
+      break;
+    }
+  }
+  return true;
+}
+
+bool FaceClassifier::calibrateConfidence(int k) {
+  if (!this->isLoaded() || !testingData.data) {
+    sendMessage("no held out data to calibrate the confidence");
+    return false;
+  }
+
+  // every top k candidate of a held out sample is one observation,
+  // positive when it is the true identity
+  vector<float> observed;
+  vector<bool> positive;
+  vector<pair<float, int> > scores;
+  for (int i = 0 ; i < testingData.rows ; i ++) {
+    Mat sample = testingData.row(i);
+    this->decisionScores(sample, k, scores);
+    for (size_t c = 0 ; c < scores.size() ; c ++) {
+      observed.push_back(scores[c].first);
+      positive.push_back(scores[c].second == testingLabel.ptr<int>(i)[0]);
+    }
+  }
+
+  double A = 0, B = 0;
+  if (!fitSigmoid(observed, positive, A, B)) {
+    sendMessage("held out data too uniform to calibrate the confidence");
+    return false;
+  }
+  this->calibrated = true;
+  this->plattA = A;
+  this->plattB = B;
+  sendMessage(string("confidence calibrated | A = ") +
+              toString(A) + string(" | B = ") +
+              toString(B));
+  return true;
+}
+
+bool FaceClassifier::hasConfidenceCalibration() {
+  return this->calibrated;
+}
+
+float FaceClassifier::confidence(float score) const {
+  const double f = plattA * score + plattB;
+  return f >= 0 ? exp(-f) / (1 + exp(-f)) : 1 / (1 + exp(f));
+}
+
 double FaceClassifier::testAccuracy() {
-  if (this->svm->isTrained()) {
+  if (backend != SVM_BACKEND && this->isLoaded()) {
+    size_t correct = 0;
+    for (int i = 0 ; i < testingData.rows ; i ++) {
+      Mat sample = testingData.row(i);
+      if (this->predictSample(sample) == testingLabel.ptr<int>(i)[0])
+        correct ++;
+    }
+    return static_cast<double>(correct) / testingLabel.rows;
+  } else if (backend == SVM_BACKEND && this->svm->isTrained()) {
     size_t correct = 0;
     Mat testResult;
     this->svm->predict(testingData, testResult);
@@ -1001,12 +2345,59 @@ double FaceClassifier::testAccuracy() {
   }
 }
 
+double FaceClassifier::predictionLatency(int maxSamples) {
+  const vector<int>& index = split.getTestIndex();
+  const int count = std::min(maxSamples, static_cast<int>(index.size()));
+  if (!this->isLoaded() || count <= 0) {
+    return 0;
+  }
+  // the full path a live frame takes after feature extraction
+  const int64_t begin = cv::getTickCount();
+  for (int i = 0 ; i < count ; i ++) {
+    Mat sample = samples.row(index[i]);
+    this->predict(sample);
+  }
+  return (cv::getTickCount() - begin) * 1000.0 /
+      cv::getTickFrequency() / count;
+}
+
 bool FaceClassifier::isLoaded() {
-  return svm->isTrained();
+  if (backend == NEAREST_NEIGHBOR_BACKEND) {
+    return nearestNeighbor.isTrained();
+  } else if (backend == ANN_BACKEND) {
+    return annIndex.isTrained();
+  } else if (backend == ONE_VS_REST_BACKEND) {
+    return oneVsRest.isTrained();
+  }
+  return evaluator.isReady() || svm->isTrained();
 }
 
 void FaceClassifier::determineFeatureType() {
-  switch (this->svm->getVarCount()) {
+  if (selection.isEnabled()) {
+    this->featureType = HAAR;
+    return;
+  }
+  const int haarLength = std::max(0,
+      imageSize.width - static_cast<int>(process::HAAR_BOX_SIZE)) *
+      std::max(0, imageSize.height - static_cast<int>(process::HAAR_BOX_SIZE));
+  int knownLength = haarLength;
+  switch (this->featureType) {
+    case LBP:
+      knownLength = process::LBP_FEATURE_LENGTH;
+      break;
+    case LTP:
+      knownLength = process::LTP_FEATURE_LENGTH;
+      break;
+    case CSLTP:
+      knownLength = process::CSLTP_FEATURE_LENGTH;
+      break;
+    default:
+      break;
+  }
+  if (knownLength == this->getFeatureLength()) {
+    return;
+  }
+  switch (this->getFeatureLength()) {
     case process::LBP_FEATURE_LENGTH:
       this->featureType = LBP;
       break;
@@ -1022,10 +2413,39 @@ void FaceClassifier::determineFeatureType() {
   }
 }
 
+void FaceClassifier::setFeatureType(FeatureType type) {
+  this->featureType = type;
+}
+
 FeatureType FaceClassifier::getFeatureType() {
   return this->featureType;
 }
 
+FaceClassifier::FaceClassifierBackend FaceClassifier::getBackend() {
+  return this->backend;
+}
+
+int FaceClassifier::getVarCount() {
+  if (backend == NEAREST_NEIGHBOR_BACKEND) {
+    return nearestNeighbor.getVarCount();
+  } else if (backend == ANN_BACKEND) {
+    return annIndex.getVarCount();
+  } else if (backend == ONE_VS_REST_BACKEND) {
+    return oneVsRest.getVarCount();
+  } else if (evaluator.isReady()) {
+    return evaluator.getVarCount();
+  }
+  return this->svm->getVarCount();
+}
+
+int FaceClassifier::getFeatureLength() {
+  if (selection.isEnabled()) {
+    return selection.getInputLength();
+  }
+  return projection.isEnabled() ?
+      projection.getInputLength() : this->getVarCount();
+}
+
 } // classifier namespace
 
 // undefine constants
@@ -1040,5 +2460,29 @@ FeatureType FaceClassifier::getFeatureType() {
 
 #undef LTP_THRESHOLD
 #undef MAX_ITERATION
+#undef EARLY_STOP_PATIENCE
+#undef WILSON_Z
+#undef MAX_BUDGET_STRIDE
+#undef MEMORY_SHRINK_RATIO
+
+#undef IMAGE_WIDTH_KEY
+#undef IMAGE_HEIGHT_KEY
+#undef FEATURE_TYPE_KEY
+#undef BACKEND_KEY
+#undef REJECTION_THRESHOLD_KEY
+#undef PLATT_A_KEY
+#undef PLATT_B_KEY
+
+#undef PROJECTION_TYPE_KEY
+#undef PROJECTION_INPUT_KEY
+#undef PROJECTION_OUTPUT_KEY
+#undef PROJECTION_MEAN_KEY
+#undef PROJECTION_BASIS_KEY
+#undef SELECTION_INPUT_KEY
+#undef SELECTION_KEY
+#undef PLATT_MAX_ITERATION
+#undef PLATT_MIN_STEP
+#undef PLATT_SIGMA
+#undef PLATT_EPSILON
 
 #undef MIN
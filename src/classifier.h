@@ -1,24 +1,33 @@
 #ifndef CLASSIFIER_H
 #define CLASSIFIER_H
 
-#include <QtCore>
-#include <QObject>
-#include <QFile>
-#include <QXmlStreamWriter>
-#include <QRegExp>
-#include <QTextStream>
-
 #include <opencv2/core.hpp>
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/ml.hpp>
 
 #include <limits.h>
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
 #include <map>
+#include <mutex>
+#include <random>
+#include <set>
 #include <vector>
 
 #include "process.h"
 #include "common.h"
+#include "messenger.h"
+#include "nearestneighbor.h"
+#include "hnswindex.h"
+#include "onevsrest.h"
+#include "svmevaluator.h"
+#include "modelbundle.h"
+#include "datasplit.h"
+#include "projection.h"
+#include "featureselection.h"
+#include "trainingcheckpoint.h"
 
 using std::string;
 using std::map;
@@ -35,6 +44,13 @@ extern const double DEFAULT_TRAINING_STEP;
 extern const double DEFAULT_GAMMA;
 extern const double TEST_ACCURACY_REQUIREMENT;
 extern const double MIN_GAMMA;
+extern const int UNKNOWN_LABEL;
+extern const double DEFAULT_FALSE_ACCEPT_RATE;
+extern const double DEFAULT_FALSE_REJECT_RATE;
+extern const int DEFAULT_TOP_K;
+extern const unsigned int DEFAULT_SPLIT_SEED;
+extern const long DEFAULT_SESSION_GAP;
+extern const int DEFAULT_LATENCY_SAMPLES;
 
 // supported feature type
 typedef enum {
@@ -84,26 +100,64 @@ typedef struct LoadingParams {
   double percentForTraining;
   FeatureType featureType;
   Size imageSize;
+  // train the background images as a class of their own,
+  // otherwise unknown faces are left to the rejection threshold
+  bool includeBackground = true;
+  // held out images are whole capture sessions picked per class
+  // by a seeded shuffle, sessions are split at idle gaps (seconds)
+  unsigned int seed = DEFAULT_SPLIT_SEED;
+  long sessionGap = DEFAULT_SESSION_GAP;
 } LoadingParams;
 
-class TrainingDataLoader : public QObject {
-  Q_OBJECT
+// one recognition candidate
+typedef struct RecognitionResult {
+  int label;
+  string name;
+  float score;        // backend decision score, higher is better
+  float confidence;   // probability of being this person
+} RecognitionResult;
+
+// limits of one training run, 0 means unlimited
+typedef struct TrainingBudget {
+  double seconds = 0;       // wall clock for the parameter search
+  int threads = 0;          // opencv worker threads while training
+  size_t memoryBytes = 0;   // working set of a single svm fit
+} TrainingBudget;
+
+// compute the feature row of an image already resized
+// to the training size
+void computeFeature(Mat& image, FeatureType type, Mat& feature);
+const char* featureName(FeatureType type);
+
+class TrainingDataLoader : public Messenger {
  public:
   TrainingDataLoader(const LoadingParams params);
   virtual ~TrainingDataLoader() {}
   void load(Mat& trainingData, Mat& trainingLabel,
        map<int, string>& names);
+  void load(Mat& trainingData, Mat& trainingLabel,
+       map<int, string>& names, DataSplit& split);
+  // one feature matrix per type, rows in the same order
+  void load(const vector<FeatureType>& types, vector<Mat>& data,
+            Mat& trainingLabel, map<int, string>& names, DataSplit& split);
+  // mean milliseconds per image of the last load
+  double getExtractionTime(FeatureType type) const;
+  void loadPerson(const string name, Mat& data);
   static void brief(const Mat& mat, string& str);
 
- signals:
-  void sendMessage(QString message);
-
  private:
+  void splitImages(const string name, const string path,
+                   vector<string>& training, vector<string>& testing);
+
   string directory;
   string bgDir, posDir, negDir;
   double percent;
   FeatureType featureType;
   Size imageSize;
+  bool includeBackground;
+  unsigned int seed;
+  long sessionGap;
+  map<FeatureType, double> extractionTime;
 };
 
 // old function for loading training data
@@ -116,8 +170,7 @@ void loadTrainingData(LoadingParams params,
 
 struct FaceClassifierParams;
 
-class FaceClassifier : public QObject {
-  Q_OBJECT
+class FaceClassifier : public Messenger {
  public:
   // constants
   enum FaceClassifierType {
@@ -169,6 +222,21 @@ class FaceClassifier : public QObject {
     // K(x_i, x_j) = \tanh(\gamma x_i^T x_j + coef0).
   };
 
+  enum FaceClassifierBackend {
+    SVM_BACKEND,
+    // cv::ml::SVM trained with the gamma search
+    NEAREST_NEIGHBOR_BACKEND,
+    // nearest neighbor over the enrolled histograms.
+    // no parameter search, enrollment is instant.
+    ANN_BACKEND,
+    // approximate nearest neighbor (hnsw graph) for
+    // galleries with thousands of identities.
+    // supports incremental insert.
+    ONE_VS_REST_BACKEND
+    // one rbf svm per identity. enrolling a person
+    // only trains that person's component.
+  };
+
 
   FaceClassifier();
   explicit FaceClassifier(struct FaceClassifierParams param);
@@ -176,34 +244,109 @@ class FaceClassifier : public QObject {
                  Mat& data, Mat& label);
   virtual ~FaceClassifier() {}
   void setImageSize(Size newSize);
+  Size getImageSize();
   void saveModel(const string modelPath,
                  const string extraInfoPath);
   void train();
   void train(Mat& data, Mat& label);
   int predict(Mat& sample);
   int predictImageSample(Mat& imageSample);
+  int recognize(Mat& imageSample, int k,
+                vector<RecognitionResult>& results);
+  // all faces of a frame at once, returns how many were recognized
+  int recognize(vector<Mat>& imageSamples, int k,
+                vector<vector<RecognitionResult> >& results,
+                vector<int>& labels);
+  void setNames(const map<int, string>& names);
   bool load(const string modelPath,
             const string extraPath);
+  bool saveBundle(const string bundlePath,
+                  const map<int, string>& names);
+  bool loadBundle(const string bundlePath,
+                  map<int, string>& names);
   double testAccuracy();
+  // mean milliseconds of predict() on raw testing features
+  double predictionLatency(int maxSamples = DEFAULT_LATENCY_SAMPLES);
   bool isLoaded();
+  // keeps the known type while the feature length fits it, guesses
+  // from the length otherwise. the length alone is ambiguous, haar
+  // at 15 pixels is as long as csltp
   void determineFeatureType();
+  void setFeatureType(FeatureType type);
   FeatureType getFeatureType();
-
- signals:
-  void sendMessage(QString message);
+  FaceClassifierBackend getBackend();
+  int getVarCount();        // length the backend works on
+  int getFeatureLength();   // length before the projection
+  void searchIdentities(Mat& sample, int k,
+                        vector<pair<float, int> >& identities);
+  void decisionScores(Mat& sample, int k,
+                      vector<pair<float, int> >& scores);
+  void setRejectionThreshold(float threshold);
+  void disableRejection();
+  bool hasRejection();
+  float getRejectionThreshold();
+  bool calibrateRejection(const Mat& impostorData,
+                          double falseAcceptRate =
+                              DEFAULT_FALSE_ACCEPT_RATE);
+  bool calibrateConfidence(int k = DEFAULT_TOP_K);
+  bool hasConfidenceCalibration();
+  void setSplit(const DataSplit& newSplit);
+  // the gamma search saves its progress there and resumes from it
+  void setCheckpoint(TrainingCheckpoint* checkpoint);
+  // the search returns the best model it found within the budget
+  void setBudget(const TrainingBudget& budget);
+  bool supportsEnrollment();
+  bool enroll(Mat& data, int label);
 
  protected:
   void setupSVM();
   void setupTrainingData(Mat& data, Mat& label);
+  void trainNearestNeighbor();
+  void trainANN();
+  void trainOneVsRest();
+  int predictSample(Mat& sample);
+  bool computeSample(Mat& imageSample, Mat& sample);
+  bool extractFeature(Mat& imageSample, Mat& sample);
+  void rankClasses(const vector<int>& votes, const vector<double>& margins,
+                   vector<pair<float, int> >& scores) const;
+  int rankedResults(const vector<pair<float, int> >& scores,
+                    vector<RecognitionResult>& results);
+  float confidence(float score) const;
+  void updateEvaluator();
+  void fitSelection();
+  void fitProjection();
+  void fitMemoryBudget();
+  void transform(const Mat& features, Mat& transformed) const;
 
  private:
   Ptr<SVM> svm;
+  SVMEvaluator evaluator;   // what the svm backend predicts with
+  std::shared_ptr<MappedFile> mappedModel;
+  NearestNeighborClassifier nearestNeighbor;
+  HNSWIndex annIndex;
+  OneVsRestSVM oneVsRest;
+  std::mutex modelMutex;    // guards galleries during enrollment
+  FaceClassifierBackend backend;
+  bool rejection;
+  float rejectionThreshold;
+  bool calibrated;          // platt scaling of the decision scores
+  float plattA, plattB;
+  FeatureSelection selection;   // haar positions kept, applied first
+  int selectionCount;
+  Projection projection;        // applied after the selection
+  ProjectionType projectionType;
+  int projectionComponents;
+  TrainingCheckpoint* checkpoint;   // not owned
+  TrainingBudget budget;
+  map<int, string> names;
   FaceClassifierType type;
   FaceClassifierKernelType kernelType;
   FeatureType featureType;
   double gamma, c, nu, degree, coef0, p;
   double trainingStep, testPercent;
-  Mat trainingData, testingData;
+  Mat samples, sampleLabels;   // everything the loader produced
+  DataSplit split;
+  Mat trainingData, testingData;  // row views or gathers of samples
   Mat trainingLabel, testingLabel;
   Size imageSize;
 };
@@ -218,6 +361,12 @@ typedef struct FaceClassifierParams {
   double trainingStep;
   FaceClassifier::FaceClassifierType type;
   FaceClassifier::FaceClassifierKernelType kernelType;
+  FaceClassifier::FaceClassifierBackend backend;
+  HistogramDistance distance;
+  ProjectionType projection;
+  int projectionComponents;
+  int haarSelection;          // haar positions to keep, 0 keeps all
+  FeatureType featureType;    // what the rows were extracted with
   Size imageSize;
   double testingPercent;
 
@@ -230,6 +379,12 @@ typedef struct FaceClassifierParams {
     p = 0;
     type = FaceClassifier::C_SVC;
     kernelType = FaceClassifier::LINEAR;
+    backend = FaceClassifier::SVM_BACKEND;
+    distance = CHI_SQUARE;
+    projection = NO_PROJECTION;
+    projectionComponents = DEFAULT_PROJECTION_COMPONENTS;
+    haarSelection = DEFAULT_HAAR_SELECTION;
+    featureType = LBP;
     trainingStep = DEFAULT_TRAINING_STEP;
     testingPercent = DEFAULT_TEST_PERCENT;
   }
@@ -246,6 +401,12 @@ typedef struct FaceClassifierParams {
     p = 0;
     type = FaceClassifier::C_SVC;
     kernelType = FaceClassifier::RBF;
+    backend = FaceClassifier::SVM_BACKEND;
+    distance = CHI_SQUARE;
+    projection = NO_PROJECTION;
+    projectionComponents = DEFAULT_PROJECTION_COMPONENTS;
+    haarSelection = DEFAULT_HAAR_SELECTION;
+    featureType = LBP;
     imageSize = size;
     trainingStep = _trainingStep;
     if (_testingPercent < 1.0 && _testingPercent > 0) {
@@ -0,0 +1,754 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include <signal.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "classifier.h"
+#include "facedetector.h"
+#include "facetracker.h"
+#include "framesource.h"
+#include "modelhandle.h"
+#include "modelloadtask.h"
+#include "streamservice.h"
+#include "trainingtask.h"
+
+// same layout the gui reads and writes
+#define FACE_IMAGE_ROOT_DIR "faces"
+#define FACE_MODEL_BASE_DIR "svmmodel"
+#define FACE_MODEL_BASE_NAME "facemodel"
+#define FACE_EXTRA_INFO_BASENAME "extra"
+#define FACE_MODEL_EXTENSION ".xml"
+#define FACE_BUNDLE_EXTENSION ".frm"
+#define NAME_MAP "names.xml"
+#define PERCENT 0.76
+#define BENCH_SOURCE "synthetic:640x480:300"
+#define SOURCE_WIDTH 640
+#define SOURCE_HEIGHT 480
+
+using classifier::FaceClassifier;
+using classifier::FeatureType;
+using classifier::RecognitionResult;
+using cv::Mat;
+using cv::Size;
+
+typedef struct Paths {
+  QString images, models, names;
+  QString model() const {
+    return models + QDir::separator() + FACE_MODEL_BASE_NAME +
+        FACE_MODEL_EXTENSION;
+  }
+  QString extra() const {
+    return models + QDir::separator() + FACE_EXTRA_INFO_BASENAME +
+        FACE_MODEL_EXTENSION;
+  }
+  QString bundle() const {
+    return models + QDir::separator() + FACE_MODEL_BASE_NAME +
+        FACE_BUNDLE_EXTENSION;
+  }
+} Paths;
+
+// one json object per line on stdout, logs go to stderr
+static void print(const QJsonObject& object) {
+  const QByteArray line = QJsonDocument(object).toJson(
+      QJsonDocument::Compact);
+  fprintf(stdout, "%s\n", line.constData());
+  fflush(stdout);
+}
+
+static void printLog(const QString& message) {
+  fprintf(stderr, "%s\n", message.toLocal8Bit().constData());
+}
+
+static int fail(const QString& message) {
+  QJsonObject error;
+  error["error"] = message;
+  print(error);
+  return 1;
+}
+
+static double elapsedMs(int64_t start) {
+  return (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+}
+
+// names.xml in the format MainWindow::writeMap() uses
+static QMap<int, QString> readNames(const QString& path) {
+  QMap<int, QString> names;
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return names;
+  }
+  QXmlStreamReader in(&file);
+  QString key, value;
+  while (!in.atEnd()) {
+    in.readNext();
+    if (in.isStartElement() && in.name() == QString("key")) {
+      key = in.readElementText();
+    } else if (in.isStartElement() && in.name() == QString("value")) {
+      value = in.readElementText();
+    } else if (in.isEndElement() && in.name() == QString("entry")) {
+      names.insert(key.toInt(), value);
+    }
+  }
+  return names;
+}
+
+static void writeNames(const QString& path,
+                       const QMap<int, QString>& names) {
+  QFile file(path);
+  if (!file.open(QIODevice::WriteOnly)) {
+    return;
+  }
+  QXmlStreamWriter out(&file);
+  out.setAutoFormatting(true);
+  out.setAutoFormattingIndent(2);
+  out.writeStartDocument();
+  out.writeStartElement("list");
+  QMapIterator<int, QString> it(names);
+  while (it.hasNext()) {
+    it.next();
+    out.writeStartElement("entry");
+    out.writeTextElement("key", QString::number(it.key()));
+    out.writeTextElement("value", it.value());
+    out.writeEndElement();
+  }
+  out.writeEndElement();
+  out.writeEndDocument();
+}
+
+static std::shared_ptr<FaceClassifier> loadModel(const Paths& paths,
+                                                 bool quiet) {
+  QMap<int, QString> names = readNames(paths.names);
+  ModelLoadTask task(paths.model(), paths.extra(), paths.bundle(),
+                     true, true, names);
+  if (!quiet) {
+    QObject::connect(&task, &ModelLoadTask::sendMessage, printLog);
+  }
+  // synchronously, there is no gui thread to keep responsive
+  task.run();
+  std::shared_ptr<FaceClassifier> model = task.getClassifier();
+  if (model) {
+    if (!task.getBundleNames().isEmpty()) {
+      names = task.getBundleNames();
+    }
+    std::map<int, std::string> converted;
+    for (auto it = names.begin() ; it != names.end() ; it ++) {
+      converted[it.key()] = it.value().toStdString();
+    }
+    model->setNames(converted);
+  }
+  return model;
+}
+
+static bool parseFeature(const QString& name, FeatureType& type,
+                         bool& automatic) {
+  automatic = false;
+  const QString lower = name.toLower();
+  if (lower == "lbp") {
+    type = classifier::LBP;
+  } else if (lower == "ltp") {
+    type = classifier::LTP;
+  } else if (lower == "csltp") {
+    type = classifier::CSLTP;
+  } else if (lower == "haar") {
+    type = classifier::HAAR;
+  } else if (lower == "auto") {
+    type = classifier::LBP;
+    automatic = true;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static bool parseBackend(const QString& name,
+                         FaceClassifier::FaceClassifierBackend& backend) {
+  const QString lower = name.toLower();
+  if (lower == "svm") {
+    backend = FaceClassifier::SVM_BACKEND;
+  } else if (lower == "nn") {
+    backend = FaceClassifier::NEAREST_NEIGHBOR_BACKEND;
+  } else if (lower == "ann") {
+    backend = FaceClassifier::ANN_BACKEND;
+  } else if (lower == "ovr") {
+    backend = FaceClassifier::ONE_VS_REST_BACKEND;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static QJsonObject resultObject(const RecognitionResult& result) {
+  QJsonObject object;
+  object["label"] = result.label;
+  object["name"] = QString(result.name.c_str());
+  object["score"] = result.score;
+  object["confidence"] = result.confidence;
+  return object;
+}
+
+/****** train ******/
+static int train(const QCommandLineParser& parser, const Paths& paths) {
+  FeatureType featureType = classifier::LBP;
+  bool automatic = false;
+  if (!parseFeature(parser.value("feature"), featureType, automatic)) {
+    return fail("unknown feature " + parser.value("feature"));
+  }
+  FaceClassifier::FaceClassifierBackend backend =
+      FaceClassifier::SVM_BACKEND;
+  if (!parseBackend(parser.value("backend"), backend)) {
+    return fail("unknown backend " + parser.value("backend"));
+  }
+
+  const int64_t start = cv::getTickCount();
+  TrainingTask task(paths.images, FACE_MODEL_BASE_NAME,
+                    FACE_MODEL_EXTENSION, paths.models,
+                    FACE_EXTRA_INFO_BASENAME,
+                    parser.value("percent").toDouble(),
+                    parser.value("size").toDouble(),
+                    parser.value("step").toDouble(),
+                    parser.value("gamma").toDouble(),
+                    featureType, backend);
+  task.setBackgroundClass(!parser.isSet("no-background"));
+  task.setAutoFeature(automatic);
+  task.setProjection(parser.isSet("projection") ?
+                     classifier::PCA_LDA_PROJECTION :
+                     classifier::NO_PROJECTION);
+  classifier::TrainingBudget budget;
+  budget.seconds = parser.value("budget").toDouble();
+  task.setBudget(budget);
+
+  QString modelPath, extraPath;
+  QMap<int, QString> names;
+  QObject::connect(&task, &TrainingTask::sendMessage, printLog);
+  QObject::connect(&task, &TrainingTask::complete,
+                   [&](QString model, QString extra,
+                       QMap<int, QString> trained) {
+                     modelPath = model;
+                     extraPath = extra;
+                     names = trained;
+                   });
+  task.run();
+  if (modelPath.isEmpty()) {
+    return fail("training failed");
+  }
+
+  // published where the gui and the other commands look
+  QFile::remove(paths.model());
+  QFile::copy(modelPath, paths.model());
+  QFile::remove(paths.extra());
+  QFile::copy(extraPath, paths.extra());
+  QFile::remove(paths.bundle());
+  writeNames(paths.names, names);
+  std::shared_ptr<FaceClassifier> model = loadModel(paths, true);
+
+  QJsonObject object;
+  object["command"] = "train";
+  object["model"] = paths.model();
+  object["classes"] = names.size();
+  object["loaded"] = model != nullptr;
+  if (model) {
+    object["feature"] = classifier::featureName(model->getFeatureType());
+  }
+  object["seconds"] = elapsedMs(start) / 1000.0;
+  print(object);
+  return model ? 0 : 1;
+}
+/*----- end of train -----*/
+
+/****** predict ******/
+static int predict(const QCommandLineParser& parser, const Paths& paths,
+                   int threads) {
+  QStringList images = parser.positionalArguments();
+  images.removeFirst();
+  if (images.isEmpty()) {
+    return fail("predict needs images");
+  }
+  std::shared_ptr<FaceClassifier> model = loadModel(paths, false);
+  if (!model) {
+    return fail("no model in " + paths.models);
+  }
+  const int k = std::max(1, parser.value("top").toInt());
+
+  // images are split into one contiguous batch per thread
+  const int count = images.size();
+  vector<vector<vector<RecognitionResult> > > results(threads);
+  vector<vector<int> > labels(threads);
+  vector<vector<bool> > readable(threads);
+  vector<std::thread> workers;
+  const int64_t start = cv::getTickCount();
+  for (int t = 0 ; t < threads ; t ++) {
+    workers.push_back(std::thread([&, t]() {
+      const int begin = count * t / threads;
+      const int end = count * (t + 1) / threads;
+      vector<Mat> batch;
+      for (int i = begin ; i < end ; i ++) {
+        Mat image = cv::imread(images[i].toStdString(),
+                               cv::IMREAD_GRAYSCALE);
+        readable[t].push_back(!image.empty());
+        if (!image.empty()) {
+          batch.push_back(image);
+        }
+      }
+      vector<vector<RecognitionResult> > batchResults;
+      vector<int> batchLabels;
+      model->recognize(batch, k, batchResults, batchLabels);
+      // back to one entry per image, unreadable ones included
+      results[t].resize(end - begin);
+      labels[t].assign(end - begin, INT_MAX);
+      for (int i = 0, j = 0 ; i < end - begin ; i ++) {
+        if (readable[t][i]) {
+          results[t][i].swap(batchResults[j]);
+          labels[t][i] = batchLabels[j ++];
+        }
+      }
+    }));
+  }
+  for (size_t t = 0 ; t < workers.size() ; t ++) {
+    workers[t].join();
+  }
+  const double ms = elapsedMs(start);
+
+  for (int t = 0 ; t < threads ; t ++) {
+    const int begin = count * t / threads;
+    for (size_t i = 0 ; i < labels[t].size() ; i ++) {
+      QJsonObject object;
+      object["image"] = images[begin + static_cast<int>(i)];
+      if (!readable[t][i]) {
+        object["error"] = "cannot read image";
+      } else if (labels[t][i] == INT_MAX) {
+        object["error"] = "cannot recognize image";
+      } else {
+        object["label"] = labels[t][i];
+        object["unknown"] = labels[t][i] == classifier::UNKNOWN_LABEL;
+        QJsonArray candidates;
+        for (size_t j = 0 ; j < results[t][i].size() ; j ++) {
+          candidates.append(resultObject(results[t][i][j]));
+        }
+        object["results"] = candidates;
+      }
+      print(object);
+    }
+  }
+  QJsonObject summary;
+  summary["command"] = "predict";
+  summary["images"] = count;
+  summary["threads"] = threads;
+  summary["ms"] = ms;
+  print(summary);
+  return 0;
+}
+/*----- end of predict -----*/
+
+/****** eval ******/
+static int eval(const QCommandLineParser& parser, const Paths& paths,
+                int threads) {
+  std::shared_ptr<FaceClassifier> model = loadModel(paths, false);
+  if (!model) {
+    return fail("no model in " + paths.models);
+  }
+
+  // the held out images of the split the model was trained with
+  classifier::LoadingParams params(paths.images.toStdString(),
+                                   parser.value("percent").toDouble(),
+                                   model->getFeatureType(),
+                                   model->getImageSize());
+  params.includeBackground = !parser.isSet("no-background");
+  classifier::TrainingDataLoader loader(params);
+  loader.setMessageCallback([](const string& message) {
+    printLog(QString::fromStdString(message));
+  });
+  vector<Mat> data;
+  Mat labels;
+  map<int, string> names;
+  classifier::DataSplit split;
+  loader.load(vector<FeatureType>(1, model->getFeatureType()), data,
+              labels, names, split);
+  const vector<int>& test = split.getTestIndex();
+  if (data.empty() || test.empty()) {
+    return fail("no testing images in " + paths.images);
+  }
+
+  const int count = static_cast<int>(test.size());
+  vector<int> predicted(count, INT_MAX);
+  vector<std::thread> workers;
+  const int64_t start = cv::getTickCount();
+  for (int t = 0 ; t < threads ; t ++) {
+    workers.push_back(std::thread([&, t]() {
+      for (int i = count * t / threads ; i < count * (t + 1) / threads ;
+           i ++) {
+        Mat sample = data[0].row(test[i]);
+        predicted[i] = model->predict(sample);
+      }
+    }));
+  }
+  for (size_t t = 0 ; t < workers.size() ; t ++) {
+    workers[t].join();
+  }
+  const double ms = elapsedMs(start);
+
+  // label -> (correct, total)
+  std::map<int, std::pair<int, int> > perClass;
+  int correct = 0, unknown = 0;
+  for (int i = 0 ; i < count ; i ++) {
+    const int truth = labels.at<int>(test[i], 0);
+    perClass[truth].second ++;
+    if (predicted[i] == truth) {
+      perClass[truth].first ++;
+      correct ++;
+    } else if (predicted[i] == classifier::UNKNOWN_LABEL) {
+      unknown ++;
+    }
+  }
+  QJsonArray classes;
+  for (auto it = perClass.begin() ; it != perClass.end() ; it ++) {
+    QJsonObject object;
+    object["label"] = it->first;
+    object["name"] = QString(names[it->first].c_str());
+    object["samples"] = it->second.second;
+    object["accuracy"] = static_cast<double>(it->second.first) /
+        it->second.second;
+    classes.append(object);
+  }
+  QJsonObject object;
+  object["command"] = "eval";
+  object["feature"] = classifier::featureName(model->getFeatureType());
+  object["samples"] = count;
+  object["accuracy"] = static_cast<double>(correct) / count;
+  object["unknown"] = unknown;
+  object["msPerSample"] = ms * threads / count;
+  object["classes"] = classes;
+  print(object);
+  return 0;
+}
+/*----- end of eval -----*/
+
+/****** bench ******/
+static int bench(const QCommandLineParser& parser, const Paths& paths) {
+  const QString spec = parser.isSet("source") ?
+      parser.value("source") : QString(BENCH_SOURCE);
+  std::unique_ptr<FrameSource> source(
+      FrameSource::create(spec.toStdString(), SOURCE_WIDTH, SOURCE_HEIGHT));
+  if (!source || !source->open()) {
+    return fail("cannot open frame source " + spec);
+  }
+  FaceDetector detector;
+  if (!detector.load(parser.value("cascade").toStdString())) {
+    return fail("cannot load " + parser.value("cascade"));
+  }
+  FaceTracker tracker(&detector);
+  const bool tracking = !parser.isSet("no-track");
+  // recognition is measured only when there is a model
+  std::shared_ptr<FaceClassifier> model = loadModel(paths, true);
+  const int limit = parser.value("frames").toInt();
+
+  Mat frame, gray;
+  double timestamp = 0;
+  vector<FaceTrack> tracks;
+  vector<Mat> samples;
+  vector<vector<RecognitionResult> > results;
+  vector<int> labels;
+  uint64_t frames = 0, faces = 0;
+  double readMs = 0, detectMs = 0, recognizeMs = 0;
+  const int64_t start = cv::getTickCount();
+  while (limit <= 0 || frames < static_cast<uint64_t>(limit)) {
+    int64_t tick = cv::getTickCount();
+    if (!source->read(frame, timestamp)) {
+      break;
+    }
+    readMs += elapsedMs(tick);
+
+    tick = cv::getTickCount();
+    cv::cvtColor(frame, gray, CV_BGR2GRAY);
+    if (tracking) {
+      tracker.update(gray, tracks);
+    } else {
+      vector<cv::Rect> boxes;
+      detector.detect(gray, boxes);
+      tracks.clear();
+      for (size_t i = 0 ; i < boxes.size() ; i ++) {
+        FaceTrack track = {static_cast<int>(i), boxes[i], 1, 0};
+        tracks.push_back(track);
+      }
+    }
+    detectMs += elapsedMs(tick);
+
+    if (model && !tracks.empty()) {
+      tick = cv::getTickCount();
+      samples.resize(tracks.size());
+      for (size_t i = 0 ; i < tracks.size() ; i ++) {
+        cv::resize(gray(tracks[i].box), samples[i], model->getImageSize(),
+                   0, 0, cv::INTER_LINEAR);
+      }
+      model->recognize(samples, 1, results, labels);
+      recognizeMs += elapsedMs(tick);
+    }
+    faces += tracks.size();
+    frames ++;
+  }
+  const double totalMs = elapsedMs(start);
+  source->close();
+  if (frames == 0) {
+    return fail("no frames from " + spec);
+  }
+
+  QJsonObject object;
+  object["command"] = "bench";
+  object["source"] = QString(source->describe().c_str());
+  object["frames"] = static_cast<double>(frames);
+  object["faces"] = static_cast<double>(faces);
+  object["tracking"] = tracking;
+  object["detections"] = static_cast<double>(
+      tracking ? tracker.getDetectionCount() : frames);
+  object["recognition"] = model != nullptr;
+  object["fps"] = frames * 1000.0 / totalMs;
+  object["readMs"] = readMs / frames;
+  object["detectMs"] = detectMs / frames;
+  object["recognizeMs"] = recognizeMs / frames;
+  print(object);
+  return 0;
+}
+/*----- end of bench -----*/
+
+/****** serve ******/
+static volatile sig_atomic_t interrupted = 0;
+
+static void interrupt(int) {
+  interrupted = 1;
+}
+
+static QJsonObject statsObject(const StreamStats& stats) {
+  QJsonObject object;
+  object["stream"] = stats.stream;
+  object["source"] = QString(stats.source.c_str());
+  object["captured"] = static_cast<double>(stats.captured);
+  object["dropped"] = static_cast<double>(stats.dropped);
+  object["processed"] = static_cast<double>(stats.processed);
+  object["recognized"] = static_cast<double>(stats.recognized);
+  object["skipped"] = static_cast<double>(stats.skipped);
+  object["fps"] = stats.fps;
+  object["detectMs"] = stats.detectMs;
+  object["latencyMs"] = stats.latencyMs;
+  object["finished"] = stats.finished;
+  return object;
+}
+
+static void printStats(StreamService& service) {
+  vector<StreamStats> stats;
+  service.getStats(stats);
+  QJsonArray streams;
+  for (size_t i = 0 ; i < stats.size() ; i ++) {
+    streams.append(statsObject(stats[i]));
+  }
+  QJsonObject object;
+  object["command"] = "serve";
+  object["stats"] = streams;
+  print(object);
+}
+
+static int serve(const QCommandLineParser& parser, const Paths& paths) {
+  std::shared_ptr<FaceClassifier> model = loadModel(paths, false);
+  if (!model) {
+    return fail("no model in " + paths.models);
+  }
+  ModelHandle handle;
+  handle.swap(model);
+
+  ServiceParams params;
+  params.detectThreads = parser.value("detect-threads").toInt();
+  params.recognizeThreads = parser.value("recognize-threads").toInt();
+  params.maxBatch = parser.value("batch").toInt();
+  params.tracking = !parser.isSet("no-track");
+  params.paced = !parser.isSet("unpaced");
+  params.detectorModel = parser.value("cascade").toStdString();
+  StreamService service(&handle, params);
+  service.setMessageCallback([](const std::string& m) {
+    printLog(QString::fromStdString(m));
+  });
+
+  QStringList specs = parser.values("source");
+  if (specs.isEmpty()) {
+    specs.append(BENCH_SOURCE);
+  }
+  for (int i = 0 ; i < specs.size() ; i ++) {
+    FrameSource* source = FrameSource::create(
+        specs[i].toStdString(), SOURCE_WIDTH, SOURCE_HEIGHT);
+    if (source == nullptr || service.addStream(source) < 0) {
+      return fail("cannot open frame source " + specs[i]);
+    }
+  }
+
+  // a track is reported when its best label changes
+  std::mutex printMutex;
+  std::map<int, std::map<int, int> > published;
+  service.setResultCallback([&](const StreamResult& result) {
+    std::lock_guard<std::mutex> lock(printMutex);
+    std::map<int, int>& tracks = published[result.stream];
+    std::map<int, int> current;
+    for (size_t i = 0 ; i < result.tracks.size() ; i ++) {
+      const int trackId = result.tracks[i].id;
+      const int label = result.labels[i];
+      auto last = tracks.find(trackId);
+      current[trackId] = last != tracks.end() ? last->second : INT_MAX;
+      if (label == INT_MAX || label == current[trackId]) {
+        continue;
+      }
+      current[trackId] = label;
+      RecognitionResult best = result.results[i];
+      if (label == classifier::UNKNOWN_LABEL) {
+        best.label = label;
+        best.name.clear();
+      }
+      QJsonObject object = resultObject(best);
+      object["command"] = "serve";
+      object["stream"] = result.stream;
+      object["track"] = trackId;
+      object["frame"] = static_cast<double>(result.frame);
+      object["latencyMs"] = result.latencyMs;
+      print(object);
+    }
+    // tracks that left the frame are forgotten
+    tracks.swap(current);
+  });
+
+  signal(SIGINT, interrupt);
+  signal(SIGTERM, interrupt);
+  if (!service.start()) {
+    return fail("cannot start the service");
+  }
+  const double interval = parser.value("stats").toDouble() * 1000.0;
+  const double duration = parser.value("duration").toDouble() * 1000.0;
+  const int64_t start = cv::getTickCount();
+  int64_t lastStats = start;
+  while (!interrupted && !service.isFinished() &&
+         (duration <= 0 || elapsedMs(start) < duration)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (interval > 0 && elapsedMs(lastStats) >= interval) {
+      lastStats = cv::getTickCount();
+      printStats(service);
+    }
+  }
+  service.stop();
+  printStats(service);
+  return 0;
+}
+/*----- end of serve -----*/
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("FaceRecognitionCli");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Headless face recognition. Results are printed as one json "
+      "object per line.");
+  parser.addHelpOption();
+  parser.addPositionalArgument("command",
+                               "train, predict, eval, bench or serve.");
+  parser.addPositionalArgument("images", "Face images to predict.",
+                               "[images...]");
+  parser.addOptions({
+    {"images", "Face image directory.", "dir", FACE_IMAGE_ROOT_DIR},
+    {"models", "Model directory.", "dir", FACE_MODEL_BASE_DIR},
+    {"names", "Label to name map.", "file", NAME_MAP},
+    {"feature", "lbp, ltp, csltp, haar or auto.", "type", "lbp"},
+    {"backend", "svm, nn, ann or ovr.", "backend", "svm"},
+    {"size", "Training image size.", "pixels",
+     QString::number(classifier::DEFAULT_IMAGE_SIZE)},
+    {"step", "Gamma search step.", "step",
+     QString::number(classifier::DEFAULT_TRAINING_STEP)},
+    {"gamma", "Starting gamma.", "gamma",
+     QString::number(classifier::DEFAULT_GAMMA)},
+    {"percent", "Fraction of the images used for training.", "ratio",
+     QString::number(PERCENT)},
+    {"budget", "Training time budget, 0 for none.", "seconds", "0"},
+    {"no-background", "Calibrate a rejection threshold instead of "
+     "training the background class."},
+    {"projection", "Reduce the features with PCA + LDA."},
+    {"top", "Candidates per prediction.", "k",
+     QString::number(classifier::DEFAULT_TOP_K)},
+    {"threads", "Worker threads, 0 for every core.", "n", "0"},
+    {"source", "Frame source of bench, repeat it to serve several "
+     "streams.", "spec"},
+    {"frames", "Frames to bench, 0 until the source ends.", "n", "0"},
+    {"cascade", "Face detection cascade.", "file",
+     DEFAULT_DETECTION_MODEL},
+    {"no-track", "Detect faces on every frame."},
+    {"detect-threads", "Detect and track workers of serve.", "n",
+     QString::number(DEFAULT_DETECT_THREADS)},
+    {"recognize-threads", "Recognition threads of serve.", "n",
+     QString::number(DEFAULT_RECOGNIZE_THREADS)},
+    {"batch", "Faces per recognition batch of serve.", "n",
+     QString::number(DEFAULT_SERVICE_BATCH)},
+    {"stats", "Stream statistics interval of serve, 0 for none.",
+     "seconds", "5"},
+    {"duration", "Seconds to serve, 0 until the sources end.", "seconds",
+     "0"},
+    {"unpaced", "Read recorded sources as fast as they are processed."},
+  });
+  parser.process(app);
+
+  const QStringList arguments = parser.positionalArguments();
+  if (arguments.isEmpty()) {
+    parser.showHelp(1);
+  }
+  Paths paths;
+  paths.images = parser.value("images");
+  paths.models = parser.value("models");
+  paths.names = parser.value("names");
+
+  int threads = parser.value("threads").toInt();
+  if (threads <= 0) {
+    threads = std::max(1, cv::getNumberOfCPUs());
+  }
+  cv::setNumThreads(threads);
+
+  const QString command = arguments.first();
+  if (command == "train") {
+    return train(parser, paths);
+  } else if (command == "predict") {
+    // the batches run side by side, opencv would only oversubscribe
+    cv::setNumThreads(1);
+    return predict(parser, paths, threads);
+  } else if (command == "eval") {
+    cv::setNumThreads(1);
+    return eval(parser, paths, threads);
+  } else if (command == "bench") {
+    return bench(parser, paths);
+  } else if (command == "serve") {
+    // the service sizes its own pools
+    cv::setNumThreads(1);
+    return serve(parser, paths);
+  }
+  return fail("unknown command " + command);
+}
+
+#undef FACE_IMAGE_ROOT_DIR
+#undef FACE_MODEL_BASE_DIR
+#undef FACE_MODEL_BASE_NAME
+#undef FACE_EXTRA_INFO_BASENAME
+#undef FACE_MODEL_EXTENSION
+#undef FACE_BUNDLE_EXTENSION
+#undef NAME_MAP
+#undef PERCENT
+#undef BENCH_SOURCE
+#undef SOURCE_WIDTH
+#undef SOURCE_HEIGHT
@@ -1,5 +1,8 @@
 #include "common.h"
 
+static const char* const BASE64_ALPHABET =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
 // constants
 const char* const DEFAULT_BG_DIR = "bg";
 const char* const DEFAULT_POS_DIR = "/pos";
@@ -166,3 +169,55 @@ bool deleteFile(const string filePath) {
 #endif
   return true;
 }
+
+bool replaceFile(const string source, const string target) {
+#if defined(__WIN32)
+  remove(target.c_str());
+#endif
+  return rename(source.c_str(), target.c_str()) == 0;
+}
+
+long getModifiedTime(const string filePath) {
+  struct stat info;
+  if (stat(filePath.c_str(), &info) == -1) {
+    return -1;
+  }
+  return static_cast<long>(info.st_mtime);
+}
+
+string encodeBase64(const char* data, size_t length) {
+  string text;
+  text.reserve((length + 2) / 3 * 4);
+  for (size_t i = 0 ; i < length ; i += 3) {
+    const size_t left = length - i;
+    uint32_t group = static_cast<uint8>(data[i]) << 16;
+    if (left > 1) group |= static_cast<uint8>(data[i + 1]) << 8;
+    if (left > 2) group |= static_cast<uint8>(data[i + 2]);
+    text += BASE64_ALPHABET[(group >> 18) & 63];
+    text += BASE64_ALPHABET[(group >> 12) & 63];
+    text += left > 1 ? BASE64_ALPHABET[(group >> 6) & 63] : '=';
+    text += left > 2 ? BASE64_ALPHABET[group & 63] : '=';
+  }
+  return text;
+}
+
+string decodeBase64(const string& text) {
+  string data;
+  data.reserve(text.size() / 4 * 3);
+  uint32_t group = 0;
+  int bits = 0;
+  for (size_t i = 0 ; i < text.size() ; i ++) {
+    // padding and line breaks are skipped like any other stray byte
+    const char* found = strchr(BASE64_ALPHABET, text[i]);
+    if (text[i] == '\0' || found == NULL) {
+      continue;
+    }
+    group = (group << 6) | static_cast<uint32_t>(found - BASE64_ALPHABET);
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      data += static_cast<char>((group >> bits) & 0xff);
+    }
+  }
+  return data;
+}
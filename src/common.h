@@ -6,6 +6,7 @@
 #include <iostream>
 #include <vector>
 #include <fstream>
+#include <sstream>
 #include <cstdio>
 #include <cstring>
 #include <cmath>
@@ -21,6 +22,7 @@ using std::ios;
 #include <sys/stat.h>
 #elif defined(__WIN32)
 #include <dirent.h>
+#include <sys/stat.h>
 #include <windows.h>
 #endif
 
@@ -42,6 +44,7 @@ extern const char* const DEFAULT_POS_DIR;
 extern const char* const DEFAULT_NEG_DIR;
 extern const char* const DEFAULT_MODEL_OUTPUT;
 
+vector<string> scanDir(const string path, const vector<string> exclusion);
 void scanDir(const string path, vector<string>& files,
              const vector<string> exclusion);
 
@@ -49,5 +52,21 @@ bool fileExists(const string filePath);
 uint32_t getLineCount(const string filePath);
 bool createDirectory(const string name);
 bool deleteFile(const string filePath);
+// rename over the target, the old file stays until the new one is whole
+bool replaceFile(const string source, const string target);
+// seconds since epoch, -1 if the file cannot be read
+long getModifiedTime(const string filePath);
+
+// text of a number for messages, formatted like printf %g
+template <typename T>
+string toString(T value) {
+  std::ostringstream stream;
+  stream << value;
+  return stream.str();
+}
+
+// binary blobs inside text files
+string encodeBase64(const char* data, size_t length);
+string decodeBase64(const string& text);
 
 #endif /* end of include guard: COMMON_H */
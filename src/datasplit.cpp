@@ -0,0 +1,190 @@
+#include "datasplit.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <random>
+
+using std::map;
+
+namespace classifier {
+
+/****** DataSplit ******/
+DataSplit::DataSplit() {}
+
+DataSplit::DataSplit(const vector<int>& trainIndex,
+                     const vector<int>& testIndex)
+    : trainIndex(trainIndex), testIndex(testIndex) {}
+
+DataSplit DataSplit::ordered(int trainCount, int testCount) {
+  vector<int> train(trainCount), test(testCount);
+  for (int i = 0 ; i < trainCount ; i ++) {
+    train[i] = i;
+  }
+  for (int i = 0 ; i < testCount ; i ++) {
+    test[i] = trainCount + i;
+  }
+  return DataSplit(train, test);
+}
+
+DataSplit DataSplit::stratified(const Mat& labels, double testPercent,
+                                unsigned int seed) {
+  // rows of every class, in the order they appear
+  map<int, vector<int> > classes;
+  for (int i = 0 ; i < labels.rows ; i ++) {
+    classes[labels.ptr<int>(i)[0]].push_back(i);
+  }
+
+  std::mt19937 generator(seed);
+  vector<int> train, test;
+  for (map<int, vector<int> >::iterator it = classes.begin() ;
+       it != classes.end() ; it ++) {
+    vector<int>& rows = it->second;
+    std::shuffle(rows.begin(), rows.end(), generator);
+    // every class keeps at least one training row
+    size_t testCount = static_cast<size_t>(rows.size() * testPercent + 0.5);
+    testCount = std::min(testCount, rows.size() - 1);
+    test.insert(test.end(), rows.begin(), rows.begin() + testCount);
+    train.insert(train.end(), rows.begin() + testCount, rows.end());
+  }
+  // ascending order keeps the memory access sequential
+  std::sort(train.begin(), train.end());
+  std::sort(test.begin(), test.end());
+  return DataSplit(train, test);
+}
+
+void DataSplit::holdOutSessions(const vector<long>& captureTimes,
+                                long sessionGap, double testPercent,
+                                unsigned int seed,
+                                vector<int>& train, vector<int>& test) {
+  train.clear();
+  test.clear();
+  const int count = static_cast<int>(captureTimes.size());
+  if (count == 0) {
+    return;
+  }
+
+  // frames in capture order, the index breaks ties
+  vector<int> order(count);
+  for (int i = 0 ; i < count ; i ++) {
+    order[i] = i;
+  }
+  auto byTime = [&captureTimes](int a, int b) {
+    return captureTimes[a] < captureTimes[b] ||
+        (captureTimes[a] == captureTimes[b] && a < b);
+  };
+  std::sort(order.begin(), order.end(), byTime);
+
+  // cut the timeline wherever the camera was idle long enough
+  vector<vector<int> > sessions(1);
+  sessions.back().push_back(order[0]);
+  for (int i = 1 ; i < count ; i ++) {
+    if (captureTimes[order[i]] - captureTimes[order[i - 1]] > sessionGap) {
+      sessions.push_back(vector<int>());
+    }
+    sessions.back().push_back(order[i]);
+  }
+
+  const size_t testCount =
+      static_cast<size_t>(count * testPercent + 0.5);
+  if (sessions.size() < 2) {
+    // a single sitting, hold out its latest frames so only one
+    // boundary pair of neighbours straddles the split
+    const size_t held = std::min(testCount, static_cast<size_t>(count - 1));
+    train.assign(order.begin(), order.end() - held);
+    test.assign(order.end() - held, order.end());
+    return;
+  }
+
+  std::mt19937 generator(seed);
+  std::shuffle(sessions.begin(), sessions.end(), generator);
+  vector<bool> held(sessions.size(), false);
+  size_t heldCount = 0, heldSessions = 0;
+  for (size_t i = 0 ; i < sessions.size() ; i ++) {
+    // at least one session always stays for training
+    if (heldSessions + 1 < sessions.size() &&
+        heldCount + sessions[i].size() <= testCount) {
+      held[i] = true;
+      heldCount += sessions[i].size();
+      heldSessions ++;
+    }
+  }
+  if (heldSessions == 0 && testCount > 0) {
+    // every session is larger than the budget, take the smallest
+    size_t smallest = 0;
+    for (size_t i = 1 ; i < sessions.size() ; i ++) {
+      if (sessions[i].size() < sessions[smallest].size()) {
+        smallest = i;
+      }
+    }
+    held[smallest] = true;
+  }
+
+  for (size_t i = 0 ; i < sessions.size() ; i ++) {
+    vector<int>& target = held[i] ? test : train;
+    target.insert(target.end(), sessions[i].begin(), sessions[i].end());
+  }
+  std::sort(train.begin(), train.end(), byTime);
+  std::sort(test.begin(), test.end(), byTime);
+}
+
+vector<int> DataSplit::subsample(const Mat& labels,
+                                 const vector<int>& index,
+                                 double ratio, unsigned int seed) {
+  map<int, vector<int> > classes;
+  for (size_t i = 0 ; i < index.size() ; i ++) {
+    classes[labels.ptr<int>(index[i])[0]].push_back(index[i]);
+  }
+
+  std::mt19937 generator(seed);
+  vector<int> kept;
+  for (map<int, vector<int> >::iterator it = classes.begin() ;
+       it != classes.end() ; it ++) {
+    vector<int>& rows = it->second;
+    std::shuffle(rows.begin(), rows.end(), generator);
+    const size_t count = std::max(static_cast<size_t>(1),
+        std::min(rows.size(), static_cast<size_t>(rows.size() * ratio)));
+    kept.insert(kept.end(), rows.begin(), rows.begin() + count);
+  }
+  std::sort(kept.begin(), kept.end());
+  return kept;
+}
+
+const vector<int>& DataSplit::getTrainIndex() const {
+  return trainIndex;
+}
+
+const vector<int>& DataSplit::getTestIndex() const {
+  return testIndex;
+}
+
+bool DataSplit::isEmpty() const {
+  return trainIndex.empty() && testIndex.empty();
+}
+
+void DataSplit::select(const Mat& data, const vector<int>& index,
+                       Mat& selected) {
+  if (index.empty()) {
+    selected = Mat(0, data.cols, data.type());
+    return;
+  }
+
+  bool contiguous = true;
+  for (size_t i = 1 ; i < index.size() && contiguous ; i ++) {
+    contiguous = index[i] == index[i - 1] + 1;
+  }
+  if (contiguous) {
+    selected = data.rowRange(index.front(), index.back() + 1);
+    return;
+  }
+
+  // fresh buffer, selected may still be a view into data
+  selected = Mat(static_cast<int>(index.size()), data.cols, data.type());
+  const size_t rowSize = data.cols * data.elemSize();
+  for (size_t i = 0 ; i < index.size() ; i ++) {
+    memcpy(selected.ptr(static_cast<int>(i)), data.ptr(index[i]), rowSize);
+  }
+}
+/*----- end of DataSplit -----*/
+
+} /* classifier */
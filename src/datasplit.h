@@ -0,0 +1,57 @@
+#ifndef DATASPLIT_H
+#define DATASPLIT_H
+
+#include <opencv2/core.hpp>
+
+#include <vector>
+
+using std::vector;
+using cv::Mat;
+
+namespace classifier {
+
+// train/test partition of a sample matrix, kept as row indices
+// the feature memory is never touched to change a split.
+// contiguous index ranges resolve to row views, anything else is
+// gathered only when a caller really needs a dense matrix.
+class DataSplit {
+ public:
+  DataSplit();
+  DataSplit(const vector<int>& trainIndex, const vector<int>& testIndex);
+
+  // the first trainCount rows train, the following testCount test
+  static DataSplit ordered(int trainCount, int testCount);
+  // testPercent of every class held out, chosen by a seeded shuffle
+  static DataSplit stratified(const Mat& labels, double testPercent,
+                              unsigned int seed);
+
+  // holds out whole capture sessions of one class
+  // frames closer than sessionGap seconds belong to the same session,
+  // so near duplicates never land on both sides of the split.
+  // train/test receive positions into captureTimes in time order.
+  static void holdOutSessions(const vector<long>& captureTimes,
+                              long sessionGap, double testPercent,
+                              unsigned int seed,
+                              vector<int>& train, vector<int>& test);
+
+  // keeps ratio of every class in index (at least one row each),
+  // picked by a seeded shuffle and returned in ascending order
+  static vector<int> subsample(const Mat& labels, const vector<int>& index,
+                               double ratio, unsigned int seed);
+
+  const vector<int>& getTrainIndex() const;
+  const vector<int>& getTestIndex() const;
+  bool isEmpty() const;
+
+  // rows of data in index order, a view when the rows are contiguous
+  static void select(const Mat& data, const vector<int>& index,
+                     Mat& selected);
+
+ private:
+  vector<int> trainIndex;
+  vector<int> testIndex;
+};
+
+} /* classifier */
+
+#endif /* end of include guard: DATASPLIT_H */
@@ -0,0 +1,109 @@
+#include "facedetector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+// constants
+#if defined(__unix__)
+const char* const DEFAULT_DETECTION_MODEL =
+    "/usr/local/share/OpenCV/haarcascades/haarcascade_frontalface_alt2.xml";
+#elif defined(__WIN32)
+const char* const DEFAULT_DETECTION_MODEL =
+    "./haarcascade_frontalface_alt2.xml";
+#endif
+
+using cv::cvtColor;
+using cv::equalizeHist;
+using cv::resize;
+
+static bool largerArea(const Rect& a, const Rect& b) {
+  return a.area() > b.area();
+}
+
+static Size scaleSize(const Size& size, double scale) {
+  if (size.width <= 0 || size.height <= 0) {
+    return Size();
+  }
+  return Size(cvRound(size.width * scale), cvRound(size.height * scale));
+}
+
+/****** FaceDetector ******/
+FaceDetector::FaceDetector() {}
+
+bool FaceDetector::load(const string modelPath) {
+  if (!cascade.load(modelPath)) {
+#ifdef DEBUG
+    fprintf(stderr, "cannot load face detection model %s\n",
+            modelPath.c_str());
+#endif
+    return false;
+  }
+  return true;
+}
+
+bool FaceDetector::isLoaded() const {
+  return !cascade.empty();
+}
+
+void FaceDetector::setParams(const DetectionParams& params) {
+  this->params = params;
+  if (this->params.downscale <= 0 || this->params.downscale > 1) {
+    this->params.downscale = 1;
+  }
+}
+
+const DetectionParams& FaceDetector::getParams() const {
+  return params;
+}
+
+void FaceDetector::detect(const Mat& frame, vector<Rect>& faces) {
+  faces.clear();
+  if (!frame.data || cascade.empty()) {
+    return;
+  }
+
+  if (frame.channels() == 3) {
+    cvtColor(frame, gray, CV_BGR2GRAY);
+  } else if (frame.channels() == 4) {
+    cvtColor(frame, gray, CV_BGRA2GRAY);
+  } else {
+    gray = frame;
+  }
+
+  const double scale = params.downscale;
+  const Mat* image = &gray;
+  if (scale < 1) {
+    resize(gray, small, Size(), scale, scale, cv::INTER_AREA);
+    image = &small;
+  }
+  if (params.equalize) {
+    // only the copy the cascade sees, callers keep the raw gray
+    equalizeHist(*image, small);
+    image = &small;
+  }
+
+  cascade.detectMultiScale(*image, faces,
+                           params.scaleFactor, params.minNeighbors, 0,
+                           scaleSize(params.minSize, scale),
+                           scaleSize(params.maxSize, scale));
+
+  // back to frame coordinates, clipped to the frame
+  const Rect bounds(0, 0, frame.cols, frame.rows);
+  for (size_t i = 0 ; i < faces.size() ; i ++) {
+    Rect& face = faces[i];
+    face = Rect(cvFloor(face.x / scale), cvFloor(face.y / scale),
+                cvRound(face.width / scale), cvRound(face.height / scale));
+    face &= bounds;
+  }
+  faces.erase(std::remove_if(faces.begin(), faces.end(),
+                             [](const Rect& face) {
+                               return face.area() <= 0;
+                             }), faces.end());
+  std::sort(faces.begin(), faces.end(), largerArea);
+}
+
+const Mat& FaceDetector::getGray() const {
+  return gray;
+}
+/*----- end of FaceDetector -----*/
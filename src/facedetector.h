@@ -0,0 +1,61 @@
+#ifndef FACEDETECTOR_H
+#define FACEDETECTOR_H
+
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/objdetect.hpp>
+
+#define DEFAULT_DETECTION_SCALE 0.5
+#define DEFAULT_SCALE_FACTOR 1.1
+#define DEFAULT_MIN_NEIGHBORS 3
+#define DEFAULT_MIN_FACE 60
+
+using std::string;
+using std::vector;
+using cv::Mat;
+using cv::Rect;
+using cv::Size;
+using cv::CascadeClassifier;
+
+// constants
+extern const char* const DEFAULT_DETECTION_MODEL;
+
+// cascade settings, sizes are in full frame pixels
+typedef struct DetectionParams {
+  double downscale = DEFAULT_DETECTION_SCALE;   // detection / frame size
+  double scaleFactor = DEFAULT_SCALE_FACTOR;    // pyramid step
+  int minNeighbors = DEFAULT_MIN_NEIGHBORS;
+  Size minSize = Size(DEFAULT_MIN_FACE, DEFAULT_MIN_FACE);
+  Size maxSize = Size();                        // empty for no limit
+  bool equalize = true;                         // histogram equalization
+} DetectionParams;
+
+// face detection front end. the frame is converted to gray once
+// and the cascade runs on a downscaled copy, the pyramid then has
+// fewer and smaller levels to scan. faces come back in frame
+// coordinates, largest first.
+class FaceDetector {
+ public:
+  FaceDetector();
+  bool load(const string modelPath);
+  bool isLoaded() const;
+  void setParams(const DetectionParams& params);
+  const DetectionParams& getParams() const;
+  void detect(const Mat& frame, vector<Rect>& faces);
+  // full resolution gray copy of the last frame
+  const Mat& getGray() const;
+
+ private:
+  CascadeClassifier cascade;
+  DetectionParams params;
+  Mat gray, small;   // reused between frames
+};
+
+#undef DEFAULT_DETECTION_SCALE
+#undef DEFAULT_SCALE_FACTOR
+#undef DEFAULT_MIN_NEIGHBORS
+#undef DEFAULT_MIN_FACE
+
+#endif /* end of include guard: FACEDETECTOR_H */
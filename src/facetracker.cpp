@@ -0,0 +1,161 @@
+#include "facetracker.h"
+
+#include <algorithm>
+
+// template width in pixels, the search costs the same for any face size
+#define TEMPLATE_WIDTH 24
+// the search window extends the last box by this much on each side
+#define SEARCH_MARGIN 0.5
+// below this correlation the face counts as lost
+#define MATCH_THRESHOLD 0.6
+// a detection continues a track when they overlap at least this much
+#define MIN_OVERLAP 0.3
+
+using cv::cvtColor;
+using cv::resize;
+using cv::matchTemplate;
+using cv::minMaxLoc;
+using cv::Point;
+
+static double overlap(const Rect& a, const Rect& b) {
+  const double intersection = (a & b).area();
+  const double united = a.area() + b.area() - intersection;
+  return united > 0 ? intersection / united : 0;
+}
+
+/****** FaceTracker ******/
+FaceTracker::FaceTracker(FaceDetector* detector, int interval)
+    : detector(detector), interval(std::max(1, interval)),
+      sinceDetection(0), nextId(0), frames(0), detections(0) {}
+
+void FaceTracker::setInterval(int interval) {
+  this->interval = std::max(1, interval);
+}
+
+void FaceTracker::reset() {
+  states.clear();
+  sinceDetection = 0;
+}
+
+void FaceTracker::update(const Mat& frame, vector<FaceTrack>& tracks) {
+  tracks.clear();
+  if (!frame.data) {
+    return;
+  }
+  frames ++;
+
+  bool lost = states.empty();
+  if (!lost && sinceDetection < interval) {
+    if (frame.channels() == 3) {
+      cvtColor(frame, gray, CV_BGR2GRAY);
+    } else {
+      gray = frame;
+    }
+    for (size_t i = 0 ; i < states.size() && !lost ; i ++) {
+      lost = !follow(states[i]);
+    }
+  }
+  if (lost || sinceDetection >= interval) {
+    this->detect(frame);
+  } else {
+    sinceDetection ++;
+  }
+
+  for (size_t i = 0 ; i < states.size() ; i ++) {
+    tracks.push_back(states[i].track);
+  }
+  std::sort(tracks.begin(), tracks.end(),
+            [](const FaceTrack& a, const FaceTrack& b) {
+              return a.box.area() > b.box.area();
+            });
+}
+
+void FaceTracker::detect(const Mat& frame) {
+  vector<Rect> faces;
+  detector->detect(frame, faces);
+  gray = detector->getGray();
+  detections ++;
+  sinceDetection = 1;
+
+  // greedy match, the largest faces pick their track first
+  vector<TrackState> matched;
+  vector<bool> taken(states.size(), false);
+  for (size_t i = 0 ; i < faces.size() ; i ++) {
+    int best = -1;
+    double bestOverlap = MIN_OVERLAP;
+    for (size_t j = 0 ; j < states.size() ; j ++) {
+      const double o = overlap(faces[i], states[j].track.box);
+      if (!taken[j] && o >= bestOverlap) {
+        best = static_cast<int>(j);
+        bestOverlap = o;
+      }
+    }
+
+    TrackState state;
+    if (best >= 0) {
+      taken[best] = true;
+      state = states[best];
+    } else {
+      state.track.id = nextId ++;
+      state.track.age = 0;
+    }
+    this->capture(state, faces[i]);
+    matched.push_back(state);
+  }
+  states.swap(matched);
+}
+
+bool FaceTracker::follow(TrackState& state) {
+  const Rect bounds(0, 0, gray.cols, gray.rows);
+  const Rect& box = state.track.box;
+  const int dx = cvRound(box.width * SEARCH_MARGIN);
+  const int dy = cvRound(box.height * SEARCH_MARGIN);
+  const Rect window = Rect(box.x - dx, box.y - dy,
+                           box.width + 2 * dx, box.height + 2 * dy) & bounds;
+
+  const cv::Size size(cvRound(window.width * state.scale),
+                      cvRound(window.height * state.scale));
+  if (size.width < state.templ.cols || size.height < state.templ.rows) {
+    return false;
+  }
+  resize(gray(window), patch, size, 0, 0, cv::INTER_AREA);
+  matchTemplate(patch, state.templ, response, cv::TM_CCOEFF_NORMED);
+
+  double score = 0;
+  Point location;
+  minMaxLoc(response, nullptr, &score, nullptr, &location);
+  if (score < MATCH_THRESHOLD) {
+    return false;
+  }
+  state.track.box = Rect(window.x + cvRound(location.x / state.scale),
+                         window.y + cvRound(location.y / state.scale),
+                         box.width, box.height) & bounds;
+  state.track.score = static_cast<float>(score);
+  state.track.age ++;
+  return state.track.box.area() > 0;
+}
+
+void FaceTracker::capture(TrackState& state, const Rect& box) {
+  state.track.box = box;
+  state.track.score = 1;
+  state.track.age ++;
+  state.scale = static_cast<double>(TEMPLATE_WIDTH) / box.width;
+  const cv::Size size(TEMPLATE_WIDTH,
+                      std::max(1, cvRound(box.height * state.scale)));
+  // the template owns its pixels, gray is reused next frame
+  resize(gray(box), state.templ, size, 0, 0, cv::INTER_AREA);
+}
+
+uint64_t FaceTracker::getFrameCount() const {
+  return frames;
+}
+
+uint64_t FaceTracker::getDetectionCount() const {
+  return detections;
+}
+/*----- end of FaceTracker -----*/
+
+#undef TEMPLATE_WIDTH
+#undef SEARCH_MARGIN
+#undef MATCH_THRESHOLD
+#undef MIN_OVERLAP
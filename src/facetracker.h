@@ -0,0 +1,63 @@
+#ifndef FACETRACKER_H
+#define FACETRACKER_H
+
+#include <stdint.h>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "facedetector.h"
+
+#define DEFAULT_TRACK_INTERVAL 10
+
+using std::vector;
+using cv::Mat;
+using cv::Rect;
+
+// a face followed across frames
+typedef struct FaceTrack {
+  int id;          // stable while the face stays tracked
+  Rect box;        // frame coordinates
+  float score;     // ncc of the last match, 1 right after detection
+  int age;         // frames since the track started
+} FaceTrack;
+
+// runs the detector every few frames, or as soon as a face is lost,
+// and follows the faces in between with a normalized cross
+// correlation search of a small template around the last box.
+// detections are matched to the tracks by overlap so ids survive
+// redetection. tracks come out largest first.
+class FaceTracker {
+ public:
+  explicit FaceTracker(FaceDetector* detector,
+                       int interval = DEFAULT_TRACK_INTERVAL);
+  void setInterval(int interval);
+  void reset();
+  void update(const Mat& frame, vector<FaceTrack>& tracks);
+
+  uint64_t getFrameCount() const;
+  uint64_t getDetectionCount() const;
+
+ private:
+  typedef struct TrackState {
+    FaceTrack track;
+    Mat templ;       // gray, TEMPLATE_WIDTH wide
+    double scale;    // template pixels per frame pixel
+  } TrackState;
+
+  void detect(const Mat& frame);
+  bool follow(TrackState& state);
+  void capture(TrackState& state, const Rect& box);
+
+  FaceDetector* detector;   // not owned
+  int interval;
+  int sinceDetection;
+  int nextId;
+  uint64_t frames, detections;
+  vector<TrackState> states;
+  Mat gray, patch, response;
+};
+
+#undef DEFAULT_TRACK_INTERVAL
+
+#endif /* end of include guard: FACETRACKER_H */
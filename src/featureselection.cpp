@@ -0,0 +1,135 @@
+#include "featureselection.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+
+using std::map;
+using std::pair;
+
+namespace classifier {
+// constants
+const int DEFAULT_HAAR_SELECTION = 1024;
+
+/****** FeatureSelection ******/
+FeatureSelection::FeatureSelection() : inputLength(0) {}
+
+bool FeatureSelection::fit(const Mat& data, const Mat& labels,
+                           int count, int levels) {
+  this->clear();
+  if (count <= 0 || count >= data.cols || levels <= 1 ||
+      data.type() != CV_32FC1 || labels.rows != data.rows) {
+    return false;
+  }
+
+  // labels as dense class indices
+  map<int, int> classIndex;
+  vector<int> classOf(data.rows);
+  for (int i = 0 ; i < labels.rows ; i ++) {
+    const int label = labels.ptr<int>(i)[0];
+    if (classIndex.find(label) == classIndex.end()) {
+      const int index = static_cast<int>(classIndex.size());
+      classIndex[label] = index;
+    }
+    classOf[i] = classIndex[label];
+  }
+  const int classCount = static_cast<int>(classIndex.size());
+  if (classCount < 2) {
+    return false;
+  }
+  vector<double> classCounts(classCount, 0);
+  for (int i = 0 ; i < data.rows ; i ++) {
+    classCounts[classOf[i]] ++;
+  }
+
+  // I(code; label) per column from the joint histogram
+  const double n = data.rows;
+  vector<pair<double, int> > ranking(data.cols);
+  vector<double> joint(levels * classCount), marginal(levels);
+  for (int j = 0 ; j < data.cols ; j ++) {
+    std::fill(joint.begin(), joint.end(), 0);
+    std::fill(marginal.begin(), marginal.end(), 0);
+    for (int i = 0 ; i < data.rows ; i ++) {
+      int code = static_cast<int>(data.ptr<float>(i)[j]);
+      code = std::min(std::max(code, 0), levels - 1);
+      joint[code * classCount + classOf[i]] ++;
+      marginal[code] ++;
+    }
+    double information = 0;
+    for (int v = 0 ; v < levels ; v ++) {
+      for (int c = 0 ; c < classCount ; c ++) {
+        const double both = joint[v * classCount + c];
+        if (both > 0) {
+          information += both / n *
+              log(both * n / (marginal[v] * classCounts[c]));
+        }
+      }
+    }
+    ranking[j] = pair<double, int>(-information, j);
+  }
+
+  std::partial_sort(ranking.begin(), ranking.begin() + count,
+                    ranking.end());
+  columns.resize(count);
+  for (int i = 0 ; i < count ; i ++) {
+    columns[i] = ranking[i].second;
+  }
+  // ascending keeps the sparse extractor walking the image in order
+  std::sort(columns.begin(), columns.end());
+  inputLength = data.cols;
+  return true;
+}
+
+bool FeatureSelection::attach(int inputLength,
+                              const vector<int>& columns) {
+  this->clear();
+  for (size_t i = 0 ; i < columns.size() ; i ++) {
+    if (columns[i] < 0 || columns[i] >= inputLength) {
+      return false;
+    }
+  }
+  this->inputLength = inputLength;
+  this->columns = columns;
+  return true;
+}
+
+void FeatureSelection::clear() {
+  inputLength = 0;
+  columns.clear();
+}
+
+void FeatureSelection::apply(const Mat& samples, Mat& selected) const {
+  if (!isEnabled()) {
+    selected = samples;
+    return;
+  }
+  selected = Mat(samples.rows, static_cast<int>(columns.size()),
+                 CV_32FC1);
+  for (int i = 0 ; i < samples.rows ; i ++) {
+    const float* source = samples.ptr<float>(i);
+    float* target = selected.ptr<float>(i);
+    for (size_t j = 0 ; j < columns.size() ; j ++) {
+      target[j] = source[columns[j]];
+    }
+  }
+}
+
+bool FeatureSelection::isEnabled() const {
+  return !columns.empty();
+}
+
+int FeatureSelection::getInputLength() const {
+  return inputLength;
+}
+
+int FeatureSelection::getOutputLength() const {
+  return static_cast<int>(columns.size());
+}
+
+const vector<int>& FeatureSelection::getColumns() const {
+  return columns;
+}
+/*----- end of FeatureSelection -----*/
+
+} /* classifier */
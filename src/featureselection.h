@@ -0,0 +1,40 @@
+#ifndef FEATURESELECTION_H
+#define FEATURESELECTION_H
+
+#include <opencv2/core.hpp>
+
+#include <vector>
+
+using std::vector;
+using cv::Mat;
+
+namespace classifier {
+
+// constants
+extern const int DEFAULT_HAAR_SELECTION;
+
+// keeps the columns of a discrete descriptor that tell the
+// identities apart best, ranked by mutual information with the label.
+// a sparse extractor can then compute the kept columns only.
+class FeatureSelection {
+ public:
+  FeatureSelection();
+  // values are codes in [0, levels), count columns are kept
+  bool fit(const Mat& data, const Mat& labels, int count, int levels);
+  bool attach(int inputLength, const vector<int>& columns);
+  void clear();
+  void apply(const Mat& samples, Mat& selected) const;
+
+  bool isEnabled() const;
+  int getInputLength() const;
+  int getOutputLength() const;
+  const vector<int>& getColumns() const;
+
+ private:
+  int inputLength;
+  vector<int> columns;   // ascending
+};
+
+} /* classifier */
+
+#endif /* end of include guard: FEATURESELECTION_H */
@@ -0,0 +1,170 @@
+#include "framegrabber.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+// set on the shared index while it holds a frame nobody took
+#define FRESH 4
+#define SLOT_MASK 3
+// back off when the device returns nothing, and the longest sleep
+// while pacing so stop() stays responsive
+#define RETRY_INTERVAL_MS 10
+// weight of the newest frame in the mean latency
+#define LATENCY_SMOOTHING 0.1
+
+/****** FrameGrabber ******/
+FrameGrabber::FrameGrabber()
+    : paced(true), running(false), finished(false),
+      shared(1), back(0), front(2),
+      captured(0), dropped(0), latency(0), meanLatency(0) {
+  for (int i = 0 ; i < 3 ; i ++) {
+    slots[i].tick = 0;
+    slots[i].timestamp = 0;
+  }
+}
+
+FrameGrabber::~FrameGrabber() {
+  this->stop();
+}
+
+bool FrameGrabber::start(int device, int width, int height) {
+  if (this->isRunning()) {
+    return true;
+  }
+  // read() fills a frame of the right size in place
+  for (int i = 0 ; i < 3 ; i ++) {
+    slots[i].frame.create(height, width, CV_8UC3);
+  }
+  return this->start(new CameraSource(device, width, height));
+}
+
+bool FrameGrabber::start(FrameSource* source, bool paced) {
+  if (this->isRunning()) {
+    delete source;
+    return true;
+  }
+  // joins a worker left over from a finished source
+  this->stop();
+  this->source.reset(source);
+  if (!source || !source->open()) {
+#ifdef DEBUG
+    fprintf(stderr, "cannot open %s\n",
+            source ? source->describe().c_str() : "frame source");
+#endif
+    this->source.reset();
+    return false;
+  }
+  // live sources come at their own pace anyway
+  this->paced = paced && !source->isLive();
+  shared = 1;
+  back = 0;
+  front = 2;
+  finished = false;
+  running = true;
+  worker = std::thread(&FrameGrabber::run, this);
+  return true;
+}
+
+void FrameGrabber::stop() {
+  running = false;
+  if (worker.joinable()) {
+    worker.join();
+  }
+  if (source) {
+    source->close();
+    source.reset();
+  }
+}
+
+bool FrameGrabber::isRunning() const {
+  return running && !finished;
+}
+
+bool FrameGrabber::isFinished() const {
+  return finished;
+}
+
+void FrameGrabber::run() {
+  const bool live = source->isLive();
+  int64_t startTick = 0;
+  double startTimestamp = 0;
+  bool first = true;
+  while (running) {
+    FrameSlot& slot = slots[back];
+    if (!source->read(slot.frame, slot.timestamp) || slot.frame.empty()) {
+      if (!live) {
+        // end of file, nothing will come anymore
+        finished = true;
+        break;
+      }
+      std::this_thread::sleep_for(
+          std::chrono::milliseconds(RETRY_INTERVAL_MS));
+      continue;
+    }
+    if (first) {
+      startTick = cv::getTickCount();
+      startTimestamp = slot.timestamp;
+      first = false;
+    }
+    // replay at the recorded speed, stop still gets through
+    while (paced && running) {
+      const double due = slot.timestamp - startTimestamp -
+          (cv::getTickCount() - startTick) * 1000.0 /
+          cv::getTickFrequency();
+      if (due <= 0) {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(
+          std::min<double>(due, RETRY_INTERVAL_MS)));
+    }
+    slot.tick = cv::getTickCount();
+    captured ++;
+
+    // publish the slot and take back whatever was in the middle
+    const int previous = shared.exchange(back | FRESH,
+                                         std::memory_order_acq_rel);
+    if (previous & FRESH) {
+      dropped ++;
+    }
+    back = previous & SLOT_MASK;
+  }
+}
+
+bool FrameGrabber::latest(Mat& frame) {
+  if (!(shared.load(std::memory_order_acquire) & FRESH)) {
+    return false;
+  }
+  const int previous = shared.exchange(front, std::memory_order_acq_rel);
+  front = previous & SLOT_MASK;
+  frame = slots[front].frame;
+
+  const double age = (cv::getTickCount() - slots[front].tick) * 1000.0 /
+      cv::getTickFrequency();
+  latency = age;
+  meanLatency = meanLatency == 0 ? age :
+      (1 - LATENCY_SMOOTHING) * meanLatency + LATENCY_SMOOTHING * age;
+  return true;
+}
+
+uint64_t FrameGrabber::getCapturedFrames() const {
+  return captured;
+}
+
+uint64_t FrameGrabber::getDroppedFrames() const {
+  return dropped;
+}
+
+double FrameGrabber::getLatency() const {
+  return latency;
+}
+
+double FrameGrabber::getMeanLatency() const {
+  return meanLatency;
+}
+/*----- end of FrameGrabber -----*/
+
+#undef FRESH
+#undef SLOT_MASK
+#undef RETRY_INTERVAL_MS
+#undef LATENCY_SMOOTHING
@@ -0,0 +1,67 @@
+#ifndef FRAMEGRABBER_H
+#define FRAMEGRABBER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <opencv2/core.hpp>
+
+#include "framesource.h"
+
+using cv::Mat;
+
+// reads a frame source on its own thread into three
+// frames. the producer and the consumer each own one slot and
+// swap the third one through a single atomic index, so neither
+// side ever waits on the other and the consumer always gets the
+// newest frame. frames the consumer never picked up are counted
+// as dropped. one consumer thread only. recorded and generated
+// sources are paced by their timestamps, or read as fast as the
+// consumer can take them with pacing off.
+class FrameGrabber {
+ public:
+  FrameGrabber();
+  ~FrameGrabber();
+  bool start(int device, int width, int height);
+  // takes ownership of source, also when it cannot be opened
+  bool start(FrameSource* source, bool paced = true);
+  void stop();
+  bool isRunning() const;
+  // a finite source ran out of frames
+  bool isFinished() const;
+  // newest frame since the last call, false if nothing new.
+  // the frame shares the slot buffer and stays valid until the
+  // next call to latest()
+  bool latest(Mat& frame);
+
+  uint64_t getCapturedFrames() const;
+  uint64_t getDroppedFrames() const;
+  // ms from capture to latest(), of the last frame and averaged
+  double getLatency() const;
+  double getMeanLatency() const;
+
+ private:
+  FrameGrabber(const FrameGrabber&);
+  FrameGrabber& operator=(const FrameGrabber&);
+  void run();
+
+  typedef struct FrameSlot {
+    Mat frame;
+    int64_t tick;    // cv::getTickCount() right after the read
+    double timestamp;  // as given by the source
+  } FrameSlot;
+
+  std::unique_ptr<FrameSource> source;
+  bool paced;
+  std::thread worker;
+  std::atomic<bool> running, finished;
+  FrameSlot slots[3];
+  std::atomic<int> shared;    // slot in the middle, plus FRESH flag
+  int back;                   // written by the capture thread
+  int front;                  // read by the consumer
+  std::atomic<uint64_t> captured, dropped;
+  std::atomic<double> latency, meanLatency;
+};
+
+#endif /* end of include guard: FRAMEGRABBER_H */
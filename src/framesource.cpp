@@ -0,0 +1,322 @@
+#include "framesource.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <map>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "common.h"
+
+#define SOURCE_FPS 30
+#define FRAME_NAME_FORMAT "frame%06llu.png"
+// disc radius relative to the shorter frame side
+#define DISC_RATIO 0.15
+// frames for one loop of the disc around the frame
+#define DISC_PERIOD 120.0
+
+// constants
+const char* const TIMESTAMP_FILE = "timestamps.txt";
+
+static double elapsedMs(int64_t start) {
+  return (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+}
+
+static bool isNumber(const string& s) {
+  return !s.empty() &&
+      std::all_of(s.begin(), s.end(),
+                  [](char c) { return std::isdigit(c) != 0; });
+}
+
+static bool isImageFile(const string& name) {
+  const size_t dot = name.rfind('.');
+  if (dot == string::npos) {
+    return false;
+  }
+  string extension = name.substr(dot + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](char c) { return std::tolower(c); });
+  return extension == "png" || extension == "jpg" ||
+      extension == "jpeg" || extension == "bmp" || extension == "pgm";
+}
+
+static bool isDirectory(const string& path) {
+  struct stat info;
+  return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+/****** FrameSource ******/
+bool FrameSource::isLive() const {
+  return false;
+}
+
+FrameSource* FrameSource::create(const string& spec,
+                                 int width, int height) {
+  const size_t colon = spec.find(':');
+  const string kind = colon == string::npos ? "" : spec.substr(0, colon);
+  const string value = colon == string::npos ? spec :
+      spec.substr(colon + 1);
+
+  if (kind == "camera" || (kind.empty() && isNumber(value))) {
+    return isNumber(value) ?
+        new CameraSource(atoi(value.c_str()), width, height) : nullptr;
+  }
+  if (kind == "video") {
+    return new VideoFileSource(value);
+  }
+  if (kind == "images") {
+    return new ImageSequenceSource(value);
+  }
+  if (kind == "synthetic") {
+    int w = 0, h = 0;
+    unsigned long long frames = 0;
+    if (sscanf(value.c_str(), "%dx%d:%llu", &w, &h, &frames) < 2 ||
+        w <= 0 || h <= 0) {
+      return nullptr;
+    }
+    return new SyntheticSource(w, h, frames);
+  }
+  // a bare path, possibly with a drive letter
+  if (isDirectory(spec)) {
+    return new ImageSequenceSource(spec);
+  }
+  return fileExists(spec) ? new VideoFileSource(spec) : nullptr;
+}
+/*----- end of FrameSource -----*/
+
+/****** CameraSource ******/
+CameraSource::CameraSource(int device, int width, int height)
+    : device(device), width(width), height(height), start(0) {}
+
+bool CameraSource::open() {
+  capture.open(device);
+  if (!capture.isOpened()) {
+#ifdef DEBUG
+    fprintf(stderr, "cannot open camera %d\n", device);
+#endif
+    return false;
+  }
+  capture.set(cv::CAP_PROP_FRAME_WIDTH, width);
+  capture.set(cv::CAP_PROP_FRAME_HEIGHT, height);
+  start = cv::getTickCount();
+  return true;
+}
+
+bool CameraSource::read(Mat& frame, double& timestamp) {
+  if (!capture.read(frame) || frame.empty()) {
+    return false;
+  }
+  timestamp = elapsedMs(start);
+  return true;
+}
+
+void CameraSource::close() {
+  capture.release();
+}
+
+bool CameraSource::isLive() const {
+  return true;
+}
+
+string CameraSource::describe() const {
+  return "camera " + std::to_string(device);
+}
+/*----- end of CameraSource -----*/
+
+/****** VideoFileSource ******/
+VideoFileSource::VideoFileSource(const string& path)
+    : path(path), fps(SOURCE_FPS), index(0) {}
+
+bool VideoFileSource::open() {
+  capture.open(path);
+  if (!capture.isOpened()) {
+#ifdef DEBUG
+    fprintf(stderr, "cannot open video %s\n", path.c_str());
+#endif
+    return false;
+  }
+  const double rate = capture.get(cv::CAP_PROP_FPS);
+  fps = rate > 0 ? rate : SOURCE_FPS;
+  index = 0;
+  return true;
+}
+
+bool VideoFileSource::read(Mat& frame, double& timestamp) {
+  if (!capture.read(frame) || frame.empty()) {
+    return false;
+  }
+  // frame count rather than CAP_PROP_POS_MSEC, not every backend
+  // reports the latter
+  timestamp = index * 1000.0 / fps;
+  index ++;
+  return true;
+}
+
+void VideoFileSource::close() {
+  capture.release();
+}
+
+string VideoFileSource::describe() const {
+  return "video " + path;
+}
+/*----- end of VideoFileSource -----*/
+
+/****** ImageSequenceSource ******/
+ImageSequenceSource::ImageSequenceSource(const string& directory,
+                                         double fps)
+    : directory(directory), fps(fps > 0 ? fps : SOURCE_FPS), index(0) {}
+
+bool ImageSequenceSource::open() {
+  files.clear();
+  timestamps.clear();
+  index = 0;
+  const vector<string> exclusion = {".", ".."};
+  const vector<string> entries = scanDir(directory, exclusion);
+  for (size_t i = 0 ; i < entries.size() ; i ++) {
+    if (isImageFile(entries[i])) {
+      files.push_back(entries[i]);
+    }
+  }
+  // readdir has no order
+  std::sort(files.begin(), files.end());
+
+  // recorded timing, one "file ms" line per frame
+  std::ifstream input(directory + SEPARATOR + TIMESTAMP_FILE);
+  string name;
+  double ms = 0;
+  std::map<string, double> recorded;
+  while (input >> name >> ms) {
+    recorded[name] = ms;
+  }
+  for (size_t i = 0 ; i < files.size() ; i ++) {
+    const auto it = recorded.find(files[i]);
+    timestamps.push_back(it != recorded.end() ? it->second :
+                         i * 1000.0 / fps);
+  }
+  return !files.empty();
+}
+
+bool ImageSequenceSource::read(Mat& frame, double& timestamp) {
+  while (index < files.size()) {
+    const size_t current = index ++;
+    frame = cv::imread(directory + SEPARATOR + files[current],
+                       cv::IMREAD_COLOR);
+    if (!frame.empty()) {
+      timestamp = timestamps[current];
+      return true;
+    }
+#ifdef DEBUG
+    fprintf(stderr, "cannot read %s\n", files[current].c_str());
+#endif
+  }
+  return false;
+}
+
+string ImageSequenceSource::describe() const {
+  return "images " + directory;
+}
+/*----- end of ImageSequenceSource -----*/
+
+/****** SyntheticSource ******/
+SyntheticSource::SyntheticSource(int width, int height, uint64_t frames,
+                                 uint64_t seed, double fps)
+    : width(width), height(height), frames(frames), seed(seed),
+      fps(fps > 0 ? fps : SOURCE_FPS), index(0) {}
+
+bool SyntheticSource::open() {
+  if (width <= 0 || height <= 0) {
+    return false;
+  }
+  cv::RNG rng(seed);
+  background.create(height, width, CV_8UC3);
+  rng.fill(background, cv::RNG::UNIFORM, cv::Scalar::all(0),
+           cv::Scalar::all(128));
+  index = 0;
+  return true;
+}
+
+bool SyntheticSource::read(Mat& frame, double& timestamp) {
+  if (frames > 0 && index >= frames) {
+    return false;
+  }
+  background.copyTo(frame);
+  const int radius = std::max(1, cvRound(std::min(width, height) *
+                                         DISC_RATIO));
+  const double angle = 2 * CV_PI * index / DISC_PERIOD;
+  const cv::Point center(
+      cvRound(width / 2 + (width / 2 - radius) * cos(angle)),
+      cvRound(height / 2 + (height / 2 - radius) * sin(angle)));
+  cv::circle(frame, center, radius, cv::Scalar::all(220), -1);
+  timestamp = index * 1000.0 / fps;
+  index ++;
+  return true;
+}
+
+string SyntheticSource::describe() const {
+  return "synthetic " + std::to_string(width) + "x" +
+      std::to_string(height);
+}
+/*----- end of SyntheticSource -----*/
+
+/****** RecordingSource ******/
+RecordingSource::RecordingSource(FrameSource* source,
+                                 const string& directory)
+    : source(source), directory(directory), index(0) {}
+
+bool RecordingSource::open() {
+  if (!source || !source->open()) {
+    return false;
+  }
+  if (!isDirectory(directory)) {
+    createDirectory(directory);
+  }
+  timestamps.open(directory + SEPARATOR + TIMESTAMP_FILE);
+  if (!timestamps.is_open()) {
+#ifdef DEBUG
+    fprintf(stderr, "cannot record into %s\n", directory.c_str());
+#endif
+    source->close();
+    return false;
+  }
+  // microsecond steps at any length, the default 6 digits round to
+  // 10 ms after a quarter of an hour
+  timestamps << std::fixed << std::setprecision(3);
+  index = 0;
+  return true;
+}
+
+bool RecordingSource::read(Mat& frame, double& timestamp) {
+  if (!source->read(frame, timestamp)) {
+    return false;
+  }
+  char name[32];
+  snprintf(name, sizeof(name), FRAME_NAME_FORMAT,
+           static_cast<unsigned long long>(index ++));
+  // png, the replay has to see exactly the pixels the pipeline saw
+  if (cv::imwrite(directory + SEPARATOR + name, frame)) {
+    timestamps << name << " " << timestamp << "\n";
+  }
+  return true;
+}
+
+void RecordingSource::close() {
+  timestamps.close();
+  source->close();
+}
+
+bool RecordingSource::isLive() const {
+  return source->isLive();
+}
+
+string RecordingSource::describe() const {
+  return source->describe() + " recorded to " + directory;
+}
+/*----- end of RecordingSource -----*/
+
+#undef SOURCE_FPS
+#undef FRAME_NAME_FORMAT
+#undef DISC_RATIO
+#undef DISC_PERIOD
@@ -0,0 +1,145 @@
+#ifndef FRAMESOURCE_H
+#define FRAMESOURCE_H
+
+#include <stdint.h>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+#define DEFAULT_SOURCE_FPS 30
+#define DEFAULT_SYNTHETIC_SEED 42
+
+using std::string;
+using std::vector;
+using cv::Mat;
+
+// constants
+extern const char* const TIMESTAMP_FILE;
+
+// where frames come from. read() hands out the next BGR frame with
+// its time in ms since the first one, so a recorded or generated
+// sequence can be replayed at its own pace or as fast as possible.
+// sources are used from one thread at a time.
+class FrameSource {
+ public:
+  virtual ~FrameSource() {}
+  virtual bool open() = 0;
+  // false once the source has nothing more to give
+  virtual bool read(Mat& frame, double& timestamp) = 0;
+  virtual void close() {}
+  // live sources run on their own clock and must not be paced
+  virtual bool isLive() const;
+  virtual string describe() const = 0;
+
+  // camera:<device>, video:<file>, images:<directory>,
+  // synthetic:<width>x<height>[:<frames>], or a bare device number,
+  // directory or video file. nullptr if the spec makes no sense
+  static FrameSource* create(const string& spec,
+                             int width, int height);
+};
+
+/****** CameraSource ******/
+class CameraSource : public FrameSource {
+ public:
+  CameraSource(int device, int width, int height);
+  virtual bool open();
+  virtual bool read(Mat& frame, double& timestamp);
+  virtual void close();
+  virtual bool isLive() const;
+  virtual string describe() const;
+
+ private:
+  int device, width, height;
+  cv::VideoCapture capture;
+  int64_t start;
+};
+/*----- end of CameraSource -----*/
+
+/****** VideoFileSource ******/
+class VideoFileSource : public FrameSource {
+ public:
+  explicit VideoFileSource(const string& path);
+  virtual bool open();
+  virtual bool read(Mat& frame, double& timestamp);
+  virtual void close();
+  virtual string describe() const;
+
+ private:
+  string path;
+  cv::VideoCapture capture;
+  double fps;
+  uint64_t index;
+};
+/*----- end of VideoFileSource -----*/
+
+/****** ImageSequenceSource ******/
+// every image of a directory in name order. a timestamps file as
+// written by RecordingSource restores the recorded timing, without
+// one the frames are fps apart
+class ImageSequenceSource : public FrameSource {
+ public:
+  explicit ImageSequenceSource(const string& directory,
+                               double fps = DEFAULT_SOURCE_FPS);
+  virtual bool open();
+  virtual bool read(Mat& frame, double& timestamp);
+  virtual string describe() const;
+
+ private:
+  string directory;
+  double fps;
+  vector<string> files;
+  vector<double> timestamps;
+  size_t index;
+};
+/*----- end of ImageSequenceSource -----*/
+
+/****** SyntheticSource ******/
+// a fixed noise background with a bright disc moving over it, the
+// same seed always gives the same frames. frames 0 runs forever
+class SyntheticSource : public FrameSource {
+ public:
+  SyntheticSource(int width, int height, uint64_t frames = 0,
+                  uint64_t seed = DEFAULT_SYNTHETIC_SEED,
+                  double fps = DEFAULT_SOURCE_FPS);
+  virtual bool open();
+  virtual bool read(Mat& frame, double& timestamp);
+  virtual string describe() const;
+
+ private:
+  int width, height;
+  uint64_t frames, seed;
+  double fps;
+  Mat background;
+  uint64_t index;
+};
+/*----- end of SyntheticSource -----*/
+
+/****** RecordingSource ******/
+// passes the frames of another source through and writes each one
+// losslessly into a directory together with its timestamp. the
+// directory replays through ImageSequenceSource
+class RecordingSource : public FrameSource {
+ public:
+  // takes ownership of source
+  RecordingSource(FrameSource* source, const string& directory);
+  virtual bool open();
+  virtual bool read(Mat& frame, double& timestamp);
+  virtual void close();
+  virtual bool isLive() const;
+  virtual string describe() const;
+
+ private:
+  std::unique_ptr<FrameSource> source;
+  string directory;
+  std::ofstream timestamps;
+  uint64_t index;
+};
+/*----- end of RecordingSource -----*/
+
+#undef DEFAULT_SOURCE_FPS
+#undef DEFAULT_SYNTHETIC_SEED
+
+#endif /* end of include guard: FRAMESOURCE_H */
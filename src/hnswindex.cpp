@@ -0,0 +1,489 @@
+#include "hnswindex.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <queue>
+
+#define HNSW_SEED 42
+
+#define DISTANCE_KEY "distance"
+#define M_KEY "m"
+#define EF_CONSTRUCTION_KEY "efConstruction"
+#define ENTRY_KEY "entryPoint"
+#define MAX_LEVEL_KEY "maxLevel"
+#define DATA_KEY "data"
+#define LABELS_KEY "labels"
+#define LINKS_KEY "links"
+
+using std::map;
+using std::priority_queue;
+using std::greater;
+using cv::FileStorage;
+
+namespace classifier {
+// constants
+const int DEFAULT_HNSW_M = 16;
+const int DEFAULT_HNSW_EF_CONSTRUCTION = 100;
+const int DEFAULT_HNSW_EF = 50;
+
+/****** HNSWIndex ******/
+HNSWIndex::HNSWIndex() {
+  this->distance = CHI_SQUARE;
+  this->m = DEFAULT_HNSW_M;
+  this->efConstruction = DEFAULT_HNSW_EF_CONSTRUCTION;
+  this->clear();
+}
+
+HNSWIndex::HNSWIndex(HistogramDistance distance, int m,
+                     int efConstruction) {
+  this->distance = distance;
+  this->m = m > 1 ? m : 2;
+  this->efConstruction = efConstruction > this->m ?
+      efConstruction : this->m;
+  this->clear();
+}
+
+void HNSWIndex::clear() {
+  this->mMax0 = 2 * m;
+  this->ef = DEFAULT_HNSW_EF;
+  this->levelMultiplier = 1.0 / log(static_cast<double>(m));
+  this->dimension = 0;
+  this->entryPoint = -1;
+  this->maxLevel = -1;
+  this->data.clear();
+  this->labels.clear();
+  this->links.clear();
+  this->generator.seed(HNSW_SEED);
+}
+
+void HNSWIndex::setEf(int ef) {
+  this->ef = ef > 0 ? ef : 1;
+}
+
+const float* HNSWIndex::vectorAt(int id) const {
+  return &data[static_cast<size_t>(id) * dimension];
+}
+
+float HNSWIndex::distanceTo(const float* query, int id) const {
+  return histogramDistance(distance, query, vectorAt(id), dimension);
+}
+
+int HNSWIndex::randomLevel() {
+  std::uniform_real_distribution<double> uniform(DBL_MIN, 1.0);
+  return static_cast<int>(-log(uniform(generator)) * levelMultiplier);
+}
+
+int HNSWIndex::greedyClosest(const float* query, int entry,
+                             int fromLevel, int toLevel) const {
+  int current = entry;
+  float currentDistance = distanceTo(query, current);
+  for (int level = fromLevel ; level > toLevel ; level --) {
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      const vector<int>& neighbors = links[current][level];
+      for (size_t i = 0 ; i < neighbors.size() ; i ++) {
+        const float d = distanceTo(query, neighbors[i]);
+        if (d < currentDistance) {
+          currentDistance = d;
+          current = neighbors[i];
+          changed = true;
+        }
+      }
+    }
+  }
+  return current;
+}
+
+void HNSWIndex::searchLayer(const float* query, int entry, int ef,
+                            int level,
+                            vector<Candidate>& result) const {
+  // candidates: closest first, found: furthest first
+  priority_queue<Candidate, vector<Candidate>, greater<Candidate> > candidates;
+  priority_queue<Candidate> found;
+  vector<bool> visited(labels.size(), false);
+
+  const float entryDistance = distanceTo(query, entry);
+  candidates.push(Candidate(entryDistance, entry));
+  found.push(Candidate(entryDistance, entry));
+  visited[entry] = true;
+
+  while (!candidates.empty()) {
+    const Candidate closest = candidates.top();
+    if (closest.first > found.top().first &&
+        static_cast<int>(found.size()) >= ef) {
+      break;
+    }
+    candidates.pop();
+
+    const vector<int>& neighbors = links[closest.second][level];
+    for (size_t i = 0 ; i < neighbors.size() ; i ++) {
+      const int id = neighbors[i];
+      if (visited[id]) continue;
+      visited[id] = true;
+
+      const float d = distanceTo(query, id);
+      if (static_cast<int>(found.size()) < ef || d < found.top().first) {
+        candidates.push(Candidate(d, id));
+        found.push(Candidate(d, id));
+        if (static_cast<int>(found.size()) > ef) {
+          found.pop();
+        }
+      }
+    }
+  }
+
+  result.clear();
+  result.reserve(found.size());
+  while (!found.empty()) {
+    result.push_back(found.top());
+    found.pop();
+  }
+  std::reverse(result.begin(), result.end());
+}
+
+void HNSWIndex::selectNeighbors(vector<Candidate>& candidates,
+                                size_t maxCount) const {
+  // heuristic from the hnsw paper: keep a candidate only if it is
+  // closer to the query than to every neighbor already selected
+  std::sort(candidates.begin(), candidates.end());
+  vector<Candidate> selected;
+  for (size_t i = 0 ; i < candidates.size() &&
+       selected.size() < maxCount ; i ++) {
+    bool keep = true;
+    for (size_t j = 0 ; j < selected.size() ; j ++) {
+      if (distanceTo(vectorAt(candidates[i].second),
+                     selected[j].second) < candidates[i].first) {
+        keep = false;
+        break;
+      }
+    }
+    if (keep) {
+      selected.push_back(candidates[i]);
+    }
+  }
+  // fill up with the closest pruned ones to keep the graph connected
+  for (size_t i = 0 ; i < candidates.size() &&
+       selected.size() < maxCount ; i ++) {
+    if (std::find(selected.begin(), selected.end(), candidates[i]) ==
+        selected.end()) {
+      selected.push_back(candidates[i]);
+    }
+  }
+  candidates.swap(selected);
+}
+
+void HNSWIndex::connect(int id, int level,
+                        const vector<Candidate>& neighbors) {
+  const size_t maxCount = level == 0 ? mMax0 : m;
+  for (size_t i = 0 ; i < neighbors.size() ; i ++) {
+    const int other = neighbors[i].second;
+    links[id][level].push_back(other);
+
+    vector<int>& backLinks = links[other][level];
+    backLinks.push_back(id);
+    if (backLinks.size() > maxCount) {
+      // shrink the neighbor list of the other node
+      vector<Candidate> shrink;
+      const float* base = vectorAt(other);
+      for (size_t j = 0 ; j < backLinks.size() ; j ++) {
+        shrink.push_back(Candidate(distanceTo(base, backLinks[j]),
+                                   backLinks[j]));
+      }
+      selectNeighbors(shrink, maxCount);
+      backLinks.clear();
+      for (size_t j = 0 ; j < shrink.size() ; j ++) {
+        backLinks.push_back(shrink[j].second);
+      }
+    }
+  }
+}
+
+int HNSWIndex::insert(const Mat& sample, int label) {
+  if (dimension == 0) {
+    dimension = sample.cols;
+  } else if (sample.cols != dimension) {
+#ifdef DEBUG
+    fprintf(stderr, "inconsistant feature length\n");
+#endif
+    return -1;
+  }
+
+  Mat normalized;
+  NearestNeighborClassifier::normalize(sample.row(0), normalized);
+  const int id = static_cast<int>(labels.size());
+  data.insert(data.end(), normalized.ptr<float>(0),
+              normalized.ptr<float>(0) + dimension);
+  labels.push_back(label);
+
+  const int level = randomLevel();
+  links.push_back(vector<vector<int> >(level + 1));
+
+  if (entryPoint < 0) {
+    entryPoint = id;
+    maxLevel = level;
+    return id;
+  }
+
+  const float* query = vectorAt(id);
+  int entry = greedyClosest(query, entryPoint, maxLevel, level);
+  vector<Candidate> neighbors;
+  for (int l = std::min(level, maxLevel) ; l >= 0 ; l --) {
+    searchLayer(query, entry, efConstruction, l, neighbors);
+    entry = neighbors.front().second;
+    selectNeighbors(neighbors, m);
+    connect(id, l, neighbors);
+  }
+
+  if (level > maxLevel) {
+    maxLevel = level;
+    entryPoint = id;
+  }
+  return id;
+}
+
+void HNSWIndex::insert(const Mat& samples, const Mat& labels) {
+  for (int i = 0 ; i < samples.rows ; i ++) {
+    insert(samples.row(i), labels.ptr<int>(i)[0]);
+  }
+}
+
+void HNSWIndex::search(const Mat& sample, int k,
+                       vector<pair<float, int> >& neighbors) const {
+  neighbors.clear();
+  if (!isTrained() || sample.cols != dimension) {
+    return;
+  }
+
+  Mat query;
+  NearestNeighborClassifier::normalize(sample.row(0), query);
+  const float* q = query.ptr<float>(0);
+  const int entry = greedyClosest(q, entryPoint, maxLevel, 0);
+  searchLayer(q, entry, std::max(ef, k), 0, neighbors);
+  if (static_cast<int>(neighbors.size()) > k) {
+    neighbors.resize(k);
+  }
+}
+
+void HNSWIndex::searchIdentities(const Mat& sample, int k,
+                                 vector<pair<float, int> >& identities) const {
+  // over fetch neighbors since one identity has many samples
+  vector<Candidate> neighbors;
+  search(sample, std::max(ef, 4 * k), neighbors);
+
+  map<int, float> best;
+  for (size_t i = 0 ; i < neighbors.size() ; i ++) {
+    const int label = labels[neighbors[i].second];
+    if (best.find(label) == best.end() ||
+        neighbors[i].first < best[label]) {
+      best[label] = neighbors[i].first;
+    }
+  }
+
+  identities.clear();
+  for (map<int, float>::iterator it = best.begin() ;
+       it != best.end() ; it ++) {
+    identities.push_back(pair<float, int>(it->second, it->first));
+  }
+  std::sort(identities.begin(), identities.end());
+  if (static_cast<int>(identities.size()) > k) {
+    identities.resize(k);
+  }
+}
+
+int HNSWIndex::predict(const Mat& sample, float* minDistance) const {
+  vector<pair<float, int> > identities;
+  searchIdentities(sample, 1, identities);
+  if (identities.empty()) {
+    return INT_MAX;
+  }
+  if (minDistance != nullptr) {
+    *minDistance = identities[0].first;
+  }
+  return identities[0].second;
+}
+
+bool HNSWIndex::isTrained() const {
+  return entryPoint >= 0;
+}
+
+int HNSWIndex::getVarCount() const {
+  return dimension;
+}
+
+int HNSWIndex::getLabel(int id) const {
+  return labels[id];
+}
+
+size_t HNSWIndex::size() const {
+  return labels.size();
+}
+
+HistogramDistance HNSWIndex::getDistance() const {
+  return distance;
+}
+
+int HNSWIndex::getM() const {
+  return m;
+}
+
+int HNSWIndex::getEfConstruction() const {
+  return efConstruction;
+}
+
+const float* HNSWIndex::getVectors() const {
+  return data.empty() ? nullptr : &data[0];
+}
+
+const int* HNSWIndex::getLabels() const {
+  return labels.empty() ? nullptr : &labels[0];
+}
+
+void HNSWIndex::exportGraph(int& entry, int& levels,
+                            vector<int>& flat) const {
+  // flatten links as: levels, (count, ids...) per level, per node
+  entry = entryPoint;
+  levels = maxLevel;
+  flat.clear();
+  for (size_t i = 0 ; i < links.size() ; i ++) {
+    flat.push_back(links[i].size());
+    for (size_t l = 0 ; l < links[i].size() ; l ++) {
+      flat.push_back(links[i][l].size());
+      flat.insert(flat.end(), links[i][l].begin(), links[i][l].end());
+    }
+  }
+}
+
+bool HNSWIndex::importGraph(int dimension, const float* vectors,
+                            const int* vectorLabels, size_t count,
+                            int entry, int levels,
+                            const int* flat, size_t flatSize) {
+  clear();
+  if (count == 0 || dimension <= 0 || entry < 0 ||
+      entry >= static_cast<int>(count) || levels < 0) {
+    return false;
+  }
+  this->dimension = dimension;
+  this->entryPoint = entry;
+  this->maxLevel = levels;
+  data.assign(vectors, vectors + count * dimension);
+  labels.assign(vectorLabels, vectorLabels + count);
+
+  // every node has one to levels + 1 layers, the entry point all of
+  // them, and a link at layer l leads to a node that has layer l too
+  size_t pos = 0;
+  links.resize(count);
+  for (size_t i = 0 ; i < count ; i ++) {
+    const int layers = pos < flatSize ? flat[pos ++] : 0;
+    if (layers <= 0 || layers - 1 > levels) {
+      clear();
+      return false;
+    }
+    links[i].resize(layers);
+    for (size_t l = 0 ; l < links[i].size() ; l ++) {
+      const int linkCount = pos < flatSize ? flat[pos ++] : -1;
+      if (linkCount < 0 ||
+          static_cast<size_t>(linkCount) > flatSize - pos) {
+        clear();
+        return false;
+      }
+      links[i][l].assign(flat + pos, flat + pos + linkCount);
+      pos += linkCount;
+    }
+  }
+  if (links[entry].size() != static_cast<size_t>(levels) + 1) {
+    clear();
+    return false;
+  }
+  for (size_t i = 0 ; i < count ; i ++) {
+    for (size_t l = 0 ; l < links[i].size() ; l ++) {
+      for (size_t j = 0 ; j < links[i][l].size() ; j ++) {
+        const int neighbor = links[i][l][j];
+        if (neighbor < 0 || neighbor >= static_cast<int>(count) ||
+            links[neighbor].size() <= l) {
+          clear();
+          return false;
+        }
+      }
+    }
+  }
+  return isTrained();
+}
+
+bool HNSWIndex::save(const string path) const {
+  FileStorage fs(path, FileStorage::WRITE);
+  if (!fs.isOpened()) {
+    return false;
+  }
+
+  int entry = -1, levels = -1;
+  vector<int> flat;
+  exportGraph(entry, levels, flat);
+
+  fs << DISTANCE_KEY << static_cast<int>(distance);
+  fs << M_KEY << m;
+  fs << EF_CONSTRUCTION_KEY << efConstruction;
+  fs << ENTRY_KEY << entry;
+  fs << MAX_LEVEL_KEY << levels;
+  fs << DATA_KEY << Mat(static_cast<int>(labels.size()), dimension,
+                        CV_32FC1, const_cast<float*>(getVectors()));
+  fs << LABELS_KEY << labels;
+  fs << LINKS_KEY << flat;
+  return true;
+}
+
+bool HNSWIndex::load(const string path) {
+  FileStorage fs(path, FileStorage::READ);
+  if (!fs.isOpened()) {
+    return false;
+  }
+
+  int type = CHI_SQUARE, entry = -1, levels = -1;
+  int neighbors = 0, construction = 0;
+  Mat vectors;
+  vector<int> vectorLabels, flat;
+  fs[DISTANCE_KEY] >> type;
+  fs[M_KEY] >> neighbors;
+  fs[EF_CONSTRUCTION_KEY] >> construction;
+  fs[ENTRY_KEY] >> entry;
+  fs[MAX_LEVEL_KEY] >> levels;
+  fs[DATA_KEY] >> vectors;
+  fs[LABELS_KEY] >> vectorLabels;
+  fs[LINKS_KEY] >> flat;
+
+  // the level multiplier is 1 / log(m)
+  if (neighbors <= 1) {
+    clear();
+    return false;
+  }
+  distance = static_cast<HistogramDistance>(type);
+  m = neighbors;
+  efConstruction = std::max(construction, m);
+  if (vectorLabels.empty() || flat.empty() ||
+      vectors.type() != CV_32FC1 || !vectors.isContinuous() ||
+      vectors.rows != static_cast<int>(vectorLabels.size())) {
+    clear();
+    return false;
+  }
+  return importGraph(vectors.cols, vectors.ptr<float>(0),
+                     &vectorLabels[0], vectorLabels.size(),
+                     entry, levels, &flat[0], flat.size());
+}
+/*----- end of HNSWIndex -----*/
+
+} /* classifier */
+
+#undef HNSW_SEED
+
+#undef DISTANCE_KEY
+#undef M_KEY
+#undef EF_CONSTRUCTION_KEY
+#undef ENTRY_KEY
+#undef MAX_LEVEL_KEY
+#undef DATA_KEY
+#undef LABELS_KEY
+#undef LINKS_KEY
@@ -0,0 +1,88 @@
+#ifndef HNSWINDEX_H
+#define HNSWINDEX_H
+
+#include <opencv2/core.hpp>
+
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "nearestneighbor.h"
+
+using std::string;
+using std::vector;
+using std::pair;
+using cv::Mat;
+
+namespace classifier {
+
+// constants
+extern const int DEFAULT_HNSW_M;
+extern const int DEFAULT_HNSW_EF_CONSTRUCTION;
+extern const int DEFAULT_HNSW_EF;
+
+// hierarchical navigable small world graph over face descriptors
+// vectors are l1 normalized on insert (same as the nearest neighbor
+// gallery) and compared with a histogram distance.
+// insert and search must not run concurrently on the same index.
+class HNSWIndex {
+ public:
+  HNSWIndex();
+  HNSWIndex(HistogramDistance distance, int m, int efConstruction);
+  void clear();
+  void setEf(int ef);
+  int insert(const Mat& sample, int label);
+  void insert(const Mat& samples, const Mat& labels);
+  void search(const Mat& sample, int k,
+              vector<pair<float, int> >& neighbors) const;
+  void searchIdentities(const Mat& sample, int k,
+                        vector<pair<float, int> >& identities) const;
+  int predict(const Mat& sample, float* minDistance = nullptr) const;
+  bool isTrained() const;
+  int getVarCount() const;
+  int getLabel(int id) const;
+  size_t size() const;
+  bool save(const string path) const;
+  bool load(const string path);
+
+  // raw access for the binary model bundle
+  HistogramDistance getDistance() const;
+  int getM() const;
+  int getEfConstruction() const;
+  const float* getVectors() const;
+  const int* getLabels() const;
+  void exportGraph(int& entry, int& levels, vector<int>& flat) const;
+  bool importGraph(int dimension, const float* vectors,
+                   const int* vectorLabels, size_t count,
+                   int entry, int levels,
+                   const int* flat, size_t flatSize);
+
+ private:
+  typedef pair<float, int> Candidate;
+
+  const float* vectorAt(int id) const;
+  float distanceTo(const float* query, int id) const;
+  int randomLevel();
+  int greedyClosest(const float* query, int entry,
+                    int fromLevel, int toLevel) const;
+  void searchLayer(const float* query, int entry, int ef, int level,
+                   vector<Candidate>& result) const;
+  void selectNeighbors(vector<Candidate>& candidates,
+                       size_t maxCount) const;
+  void connect(int id, int level, const vector<Candidate>& neighbors);
+
+  HistogramDistance distance;
+  int m, mMax0, efConstruction, ef;
+  double levelMultiplier;
+  int dimension;
+  int entryPoint, maxLevel;
+  vector<float> data;                   // contiguous, dimension per node
+  vector<int> labels;
+  vector<vector<vector<int> > > links;  // links[node][level]
+  std::mt19937 generator;
+};
+
+} /* classifier */
+
+#endif /* end of include guard: HNSWINDEX_H */
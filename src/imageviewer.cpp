@@ -2,35 +2,51 @@
 
 void ImageViewer::setImage(QImage img) {
   image = img;
-  repaint();
+  if (image.size() != imageSize) {
+    layout();
+  }
+  // coalesced with any paint still pending, never paints right away
+  update();
 }
 
-void ImageViewer::paintEvent(QPaintEvent *) {
-  QPainter painter(this);
+void ImageViewer::resizeEvent(QResizeEvent *) {
+  layout();
+}
+
+void ImageViewer::layout() {
+  imageSize = image.size();
+  if (image.isNull()) {
+    target = QRect();
+    return;
+  }
+  const int windowWidth = this->width();
+  const int windowHeight = this->height();
+  const double windowRatio = static_cast<double>(windowWidth) /
+      static_cast<double>(windowHeight);
+  const int imageWidth = image.width();
+  const int imageHeight = image.height();
+  const double imageRatio = static_cast<double>(imageWidth) /
+      static_cast<double>(imageHeight);
+  if (windowRatio > imageRatio) {
+    const int imageNewHeight = windowHeight;
+    const int imageNewWidth = static_cast<int>(imageRatio *
+                                               imageNewHeight);
+    target = QRect((windowWidth - imageNewWidth) / 2, 0,
+                   imageNewWidth, imageNewHeight);
+  } else {
+    const int imageNewWidth = windowWidth;
+    const int imageNewHeight = static_cast<int>(imageNewWidth /
+                                                imageRatio);
+    target = QRect(0, (windowHeight - imageNewHeight) / 2,
+                   imageNewWidth, imageNewHeight);
+  }
+}
 
-  if (!this->image.isNull()) {
-    const int windowWidth = this->width();
-    const int windowHeight = this->height();
-    const double windowRatio = static_cast<double>(windowWidth) /
-        static_cast<double>(windowHeight);
-    const int imageWidth = image.width();
-    const int imageHeight = image.height();
-    const double imageRatio = static_cast<double>(imageWidth) /
-        static_cast<double>(imageHeight);
-    if (windowRatio > imageRatio) {
-      const int imageNewHeight = windowHeight;
-      const int imageNewWidth = static_cast<int>(imageRatio *
-                                                 imageNewHeight);
-      QImage scaled = image.scaled(imageNewWidth, imageNewHeight);
-      QPoint start = QPoint((windowWidth - imageNewWidth) / 2, 0);
-      painter.drawImage(start, scaled);
-    } else {
-      const int imageNewWidth = windowWidth;
-      const int imageNewHeight = static_cast<int>(imageNewWidth /
-                                                  imageRatio);
-      QImage scaled = image.scaled(imageNewWidth, imageNewHeight);
-      QPoint start = QPoint(0, (windowHeight - imageNewHeight) / 2);
-      painter.drawImage(start, scaled);
-    }
+void ImageViewer::paintEvent(QPaintEvent *) {
+  if (this->image.isNull() || target.isEmpty()) {
+    return;
   }
+  QPainter painter(this);
+  // scaled straight into the backing store, no intermediate image
+  painter.drawImage(target, image);
 }
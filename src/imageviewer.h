@@ -4,16 +4,28 @@
 #include <QWidget>
 #include <QPaintEvent>
 #include <QPainter>
+#include <QResizeEvent>
 
+// shows an image scaled to fit, keeping its aspect ratio. setImage only
+// schedules a paint, several frames arriving before the next paint
+// collapse into one, and the image is shared with the caller, not
+// copied. scaling happens while drawing into the backing store, the
+// target rectangle is only recomputed when the widget or image size
+// changes.
 class ImageViewer : public QWidget {
   Q_OBJECT
  public:
   explicit ImageViewer(QWidget *parent = 0) : QWidget(parent) {}
   void setImage(QImage image);
   virtual void paintEvent(QPaintEvent *);
+  virtual void resizeEvent(QResizeEvent *);
 
  private:
+  void layout();
+
   QImage image;
+  QRect target;      // where the image goes, in widget coordinates
+  QSize imageSize;   // the size target was computed for
 };
 
 #endif // IMAGEVIEWER_H
@@ -1,9 +1,30 @@
 #include "mainwindow.h"
 #include <QApplication>
+#include <QCommandLineParser>
 
 int main(int argc, char *argv[]) {
   QApplication a(argc, argv);
+
+  QCommandLineParser parser;
+  parser.addHelpOption();
+  QCommandLineOption sourceOption(
+      "source",
+      "Frame source: camera:<n>, video:<file>, images:<dir>, "
+      "synthetic:<w>x<h>[:<frames>].",
+      "spec");
+  QCommandLineOption recordOption(
+      "record", "Record the frames with timestamps into <dir>.", "dir");
+  parser.addOption(sourceOption);
+  parser.addOption(recordOption);
+  parser.process(a);
+
   MainWindow w;
+  if (parser.isSet(sourceOption) || parser.isSet(recordOption)) {
+    // recording alone records the default camera
+    const QString spec = parser.isSet(sourceOption) ?
+        parser.value(sourceOption) : QString("camera:0");
+    w.openSource(spec, parser.value(recordOption));
+  }
   w.setWindowState(Qt::WindowMaximized);
   w.show();
 
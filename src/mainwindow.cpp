@@ -8,8 +8,7 @@ MainWindow::MainWindow(QWidget *parent) :
             ui(new Ui::MainWindow),
             timer(new QTimer()),
             mainDisplay(new ImageViewer()),
-            faceDisplay(new ImageViewer()),
-            faceClassifier(new FaceClassifier()) {
+            faceDisplay(new ImageViewer()) {
   // main ui setup
   ui->setupUi(this);
 
@@ -49,12 +48,19 @@ MainWindow::MainWindow(QWidget *parent) :
           this, SLOT(exportModel(bool)));
   connect(ui->actionTrain, SIGNAL(triggered()),
           this, SLOT(train()));
+  connect(ui->actionEnroll, SIGNAL(triggered(bool)),
+          this, SLOT(enrollPerson(bool)));
   connect(ui->actionExit, SIGNAL(triggered(bool)),
           this, SLOT(exit(bool)));
+  connect(ui->actionContinuous, SIGNAL(toggled(bool)),
+          this, SLOT(continuousRecognition(bool)));
 
+  // empty classifier until a model is loaded
+  std::shared_ptr<FaceClassifier> empty =
+      ModelHandle::wrap(new FaceClassifier());
   // face classifier message capture
-  connect(faceClassifier, SIGNAL(sendMessage(QString)),
-          this, SLOT(setLog(QString)));
+  empty->setMessageCallback(logCallback());
+  model.swap(empty);
 
   // load peoples name
   loadNameList();
@@ -68,6 +74,8 @@ MainWindow::MainWindow(QWidget *parent) :
 MainWindow::~MainWindow() {
   if (timer != nullptr)
     delete timer;
+  if (recognitionWorker != nullptr)
+    delete recognitionWorker;
   if (ui != nullptr)
     delete ui;
   if (mainDisplay != nullptr)
@@ -76,21 +84,40 @@ MainWindow::~MainWindow() {
     delete faceDisplay;
   if (trainingTask)
     delete trainingTask;
-  if (faceClassifier != nullptr)
-    delete faceClassifier;
+  if (loadTask != nullptr) {
+    loadTask->wait();
+    delete loadTask;
+  }
+  if (pendingLoadTask != nullptr)
+    delete pendingLoadTask;
 }
 
 void MainWindow::setImage() {
-  // display main image
-  QImage image = camera.getCurrentFrame();
-  mainDisplay->setImage(image);
+  if (!camera.grab()) {
+    // no new frame, the displays still show the last one
+    return;
+  }
+  // display conversions only for what is actually on screen
+  const bool shown = this->isVisible() && !this->isMinimized();
+  if (shown && mainDisplay->isVisible()) {
+    mainDisplay->setImage(camera.getCurrentFrame());
+  }
 
   // if the picture is not taken constantly shot the face
-  if (!pictureTaken) {
-    QImage face = camera.getCurrentFace();
-    if (!face.isNull()) {
-      faceDisplay->setImage(face);
-      camera.getCurrentFaceMat(this->face);
+  if (!pictureTaken && !camera.getTracks().empty()) {
+    if (shown && faceDisplay->isVisible()) {
+      faceDisplay->setImage(camera.getCurrentFace());
+    }
+    // the crop a picture takes, same size frame to frame so the copy
+    // goes into the old buffer
+    camera.getCurrentFaceMat(this->face);
+    std::shared_ptr<FaceClassifier> faceClassifier = model.get();
+    if (recognitionWorker != nullptr && faceClassifier->isLoaded()) {
+      // every face in view, the worker picks which ones to predict.
+      // gray crops at the training size, the classifier takes them as is
+      recognitionWorker->submit(
+          camera.getTracks(),
+          camera.getFaceSamples(faceClassifier->getImageSize()));
     }
   }
 }
@@ -158,7 +185,23 @@ void MainWindow::train() {
                                     LOADING_PERCENT,
                                     imageSize, trainingStep,
                                     gamma,
-                                    featureType);
+                                    featureType,
+                                    selectedBackend());
+    trainingTask->setBackgroundClass(ui->actionBackgroundClass->isChecked());
+    trainingTask->setAutoFeature(ui->rbAUTO->isChecked());
+    trainingTask->setProjection(ui->actionProjection->isChecked() ?
+                                classifier::PCA_LDA_PROJECTION :
+                                classifier::NO_PROJECTION);
+    // optional wall clock limit, empty means search until done
+    if (ui->timeBudget->text().length() > 0) {
+      classifier::TrainingBudget budget;
+      budget.seconds = ui->timeBudget->text().toDouble(&success);
+      if (!success || budget.seconds <= 0) {
+        ui->timeBudget->clear();
+        budget.seconds = 0;
+      }
+      trainingTask->setBudget(budget);
+    }
     connect(trainingTask, SIGNAL(sendMessage(QString)),
             this, SLOT(setLog(QString)));
     connect(trainingTask,
@@ -185,6 +228,10 @@ void MainWindow::trainingComplete(QString modelPath,
             SLOT(trainingComplete(QString, QMap<int, QString>)));
     delete trainingTask;
     trainingTask = nullptr;
+    if (modelPath.isEmpty()) {
+      setLog("training failed");
+      return;
+    }
     setLog("training complete");
     setLog("new model written: " + modelPath);
 
@@ -206,11 +253,19 @@ void MainWindow::trainingComplete(QString modelPath,
     QFile::copy(extraPath, extraTarget);
     setLog("new model copied");
 
-    // load the new model
-    loadClassifier(modelTarget, extraTarget);
+    // the old bundle no longer matches the model
+    QString bundleTarget = QString(MODEL_BASE_DIR) +
+        QDir::separator() + QString(MODEL_BASE_NAME) +
+        QString(BUNDLE_EXTENSION);
+    if (QFile::exists(bundleTarget)) {
+      QFile::remove(bundleTarget);
+    }
 
-    // output new name map
+    // load the new model in the background
     this->names = names;
+    loadClassifier(modelTarget, extraTarget, false);
+
+    // output new name map
     QMapIterator<int, QString> it(names);
     while (it.hasNext()) {
       it.next();
@@ -224,53 +279,199 @@ void MainWindow::trainingComplete(QString modelPath,
   }
 }
 
+void MainWindow::enrollPerson(bool) {
+  if (trainingTask != nullptr) {
+    setLog("training already started!!");
+    return;
+  }
+  std::shared_ptr<FaceClassifier> faceClassifier = model.get();
+  if (!faceClassifier->isLoaded() || !faceClassifier->supportsEnrollment()) {
+    setLog("current model cannot enroll incrementally, train instead");
+    return;
+  }
+
+  QString person = ui->selectComboBox->currentText();
+  if (person == QString(SELECT)) {
+    setLog("warning!! Need to select the target user");
+    return;
+  }
+
+  // keep the label of a known person, otherwise take the next free one
+  int label = names.isEmpty() ? 0 : names.lastKey() + 1;
+  QMapIterator<int, QString> it(names);
+  while (it.hasNext()) {
+    it.next();
+    if (it.value() == person) {
+      label = it.key();
+      break;
+    }
+  }
+
+  QString modelTarget = QString(MODEL_BASE_DIR) +
+      QDir::separator() + QString(MODEL_BASE_NAME) +
+      QString(MODEL_EXTENSION);
+  QString extraTarget = QString(MODEL_BASE_DIR) +
+      QDir::separator() + QString(EXTRA_INFO_BASENAME) +
+      QString(MODEL_EXTENSION);
+
+  trainingTask = new TrainingTask(FACE_IMAGE_DIR,
+                                  MODEL_BASE_NAME,
+                                  MODEL_EXTENSION,
+                                  MODEL_BASE_DIR,
+                                  EXTRA_INFO_BASENAME);
+  trainingTask->setEnrollment(faceClassifier, person, label,
+                              modelTarget, extraTarget);
+  connect(trainingTask, SIGNAL(sendMessage(QString)),
+          this, SLOT(setLog(QString)));
+  connect(trainingTask, SIGNAL(enrolled(QString, int)),
+          this, SLOT(enrollmentComplete(QString, int)));
+  setLog("enrolling " + person + " as " + QString::number(label));
+  trainingTask->start();
+}
+
+void MainWindow::enrollmentComplete(QString person, int label) {
+  std::shared_ptr<FaceClassifier> enrolled;
+  if (trainingTask != nullptr) {
+    trainingTask->wait();
+    enrolled = trainingTask->getEnrolledClassifier();
+    delete trainingTask;
+    trainingTask = nullptr;
+  }
+
+  if (label == INT_MAX || !enrolled) {
+    setLog("enrollment of " + person + " failed");
+    return;
+  }
+  names.insert(label, person);
+  this->writeMap();
+  // publish, recognition still running keeps the previous snapshot
+  enrolled->setMessageCallback(logCallback());
+  enrolled->setNames(nameMap());
+  model.swap(enrolled);
+  this->writeBundle();
+  setLog(person + " enrolled: " + QString::number(label));
+}
+
+bool MainWindow::openSource(const QString spec, const QString recordDir) {
+  if (!camera.open(spec.toStdString(), recordDir.toStdString())) {
+    setLog("cannot open frame source " + spec);
+    return false;
+  }
+  setLog("reading frames from " + spec +
+         (recordDir.isEmpty() ? QString() : ", recording to " + recordDir));
+  return true;
+}
+
+classifier::MessageCallback MainWindow::logCallback() {
+  // enrollment and recognition report from worker threads,
+  // the log widget is only touched on the gui thread
+  return [this](const std::string& message) {
+    QMetaObject::invokeMethod(this, "setLog", Qt::AutoConnection,
+                              Q_ARG(QString,
+                                    QString::fromStdString(message)));
+  };
+}
+
 void MainWindow::setLog(QString log) {
   ui->logText->append(log);
 }
 
 void MainWindow::takePicture() {
+  if (this->face.empty()) {
+    setLog("no face in view yet");
+    return;
+  }
+  // the last face seen, also when none is in view right now
   pictureTaken = true;
-  if (faceClassifier != nullptr) {
-    if (!faceClassifier->isLoaded()) {
-      QString modelPath = QString(MODEL_BASE_DIR) +
-          QDir::separator() + QString(MODEL_BASE_NAME) +
-          QString(MODEL_EXTENSION);
-      QString extraPath = QString(MODEL_BASE_DIR) +
-          QDir::separator() + QString(EXTRA_INFO_BASENAME) +
-          QString(MODEL_EXTENSION);
-      this->loadClassifier(modelPath, extraPath);
-      setLog("loading face classifier " + modelPath + "...");
-    }
+  if (!model.get()->isLoaded()) {
+    // recognize once the model is ready, the ui keeps running
+    recognitionPending = true;
+    loadDefaultClassifier();
+    return;
+  }
+  recognize();
+}
 
-    double imageSize = IMAGE_SIZE;
-    bool success = true;
-    // training image size
-    if (ui->imageSizeEdit->text().length() == 0) {
-      ui->imageSizeEdit->setText(QString::number(imageSize));
-    } else {
-      imageSize = ui->imageSizeEdit->text().toDouble(&success);
-      if (!success) {
-        ui->imageSizeEdit->setText(QString::number(imageSize));
-        imageSize = IMAGE_SIZE;
-      }
+void MainWindow::loadDefaultClassifier() {
+  if (loadTask == nullptr) {
+    QString modelPath = QString(MODEL_BASE_DIR) +
+        QDir::separator() + QString(MODEL_BASE_NAME) +
+        QString(MODEL_EXTENSION);
+    QString extraPath = QString(MODEL_BASE_DIR) +
+        QDir::separator() + QString(EXTRA_INFO_BASENAME) +
+        QString(MODEL_EXTENSION);
+    this->loadClassifier(modelPath, extraPath);
+    setLog("loading face classifier " + modelPath + "...");
+  }
+}
+
+void MainWindow::continuousRecognition(bool enable) {
+  if (enable && recognitionWorker == nullptr) {
+    if (!model.get()->isLoaded()) {
+      // the worker picks the model up as soon as it is published
+      loadDefaultClassifier();
     }
+    recognitionWorker = new RecognitionWorker(&model);
+    connect(recognitionWorker,
+            SIGNAL(identified(int, int, QString, float)),
+            this, SLOT(identified(int, int, QString, float)));
+    recognitionWorker->start();
+    setLog("continuous recognition started");
+  } else if (!enable && recognitionWorker != nullptr) {
+    delete recognitionWorker;
+    recognitionWorker = nullptr;
+    setLog("continuous recognition stopped");
+  }
+}
+
+void MainWindow::identified(int trackId, int label, QString name,
+                            float confidence) {
+  setLog("face " + QString::number(trackId) + " identified: " +
+         name + " (" + QString::number(label) + ")");
+  // the label follows the main face, the others are only logged
+  if (camera.getTracks().empty() ||
+      camera.getTracks()[0].id != trackId) {
+    return;
+  }
+  if (label == classifier::UNKNOWN_LABEL || name.isEmpty() ||
+      name == QString(BG_IMAGE_DIR)) {
+    ui->whoLabel->setText("We don't recognize you!!!");
+  } else {
+    ui->whoLabel->setText("Hello " + name + " (" +
+                          QString::number(qRound(confidence * 100)) +
+                          "%)");
+  }
+}
 
-    faceClassifier->setImageSize(Size(imageSize, imageSize));
-    int result = faceClassifier->predictImageSample(this->face);
+void MainWindow::recognize() {
+  recognitionPending = false;
+  // snapshot, a model swapped in meanwhile does not affect this one
+  std::shared_ptr<FaceClassifier> faceClassifier = model.get();
+  if (faceClassifier->isLoaded()) {
+    // the model works at the size it was trained with, the image size
+    // edit only feeds training. the snapshot is shared with the
+    // recognition worker and must not be changed here
+    vector<classifier::RecognitionResult> results;
+    int result = faceClassifier->recognize(this->face, TOP_K, results);
 
     setLog("result: " + QString::number(result));
+    for (size_t i = 0 ; i < results.size() ; i ++) {
+      setLog(QString::number(i + 1) + ". " +
+             QString(results[i].name.c_str()) + " (" +
+             QString::number(results[i].label) + ") | score: " +
+             QString::number(results[i].score) + " | confidence: " +
+             QString::number(results[i].confidence));
+    }
 
-    QMapIterator<int, QString> it(names);
-    while (it.hasNext()) {
-      it.next();
-      if (it.key() == result) {
-        if (it.value() == QString(BG_IMAGE_DIR)) {
-          ui->whoLabel->setText("We don't recognize you!!!");
-        } else {
-          ui->whoLabel->setText("Are you " + it.value());
-        }
-        break;
-      }
+    if (result == classifier::UNKNOWN_LABEL || results.empty() ||
+        results[0].name == string(BG_IMAGE_DIR)) {
+      ui->whoLabel->setText("We don't recognize you!!!");
+    } else if (!results[0].name.empty()) {
+      ui->whoLabel->setText("Are you " +
+                            QString(results[0].name.c_str()) + " (" +
+                            QString::number(
+                                qRound(results[0].confidence * 100)) +
+                            "%)");
     }
   }
 }
@@ -444,10 +645,67 @@ void MainWindow::loadNameMap() {
 }
 
 void MainWindow::loadClassifier(const QString modelPath,
-                                const QString extraPath) {
-    this->faceClassifier->load(modelPath.toStdString(),
-                               extraPath.toStdString());
-    setLog("model loaded");
+                                const QString extraPath,
+                                bool readBundle) {
+  // prefer the binary bundle, it is mapped instead of parsed
+  QString bundlePath = QString(MODEL_BASE_DIR) +
+      QDir::separator() + QString(MODEL_BASE_NAME) +
+      QString(BUNDLE_EXTENSION);
+  startModelLoad(new ModelLoadTask(modelPath, extraPath, bundlePath,
+                                   readBundle, true, names));
+}
+
+void MainWindow::startModelLoad(ModelLoadTask* task) {
+  connect(task, SIGNAL(sendMessage(QString)),
+          this, SLOT(setLog(QString)));
+  connect(task, SIGNAL(loaded(bool)),
+          this, SLOT(modelLoaded(bool)));
+  if (loadTask != nullptr) {
+    // one load at a time, the latest request wins
+    if (pendingLoadTask != nullptr)
+      delete pendingLoadTask;
+    pendingLoadTask = task;
+    return;
+  }
+  loadTask = task;
+  loadTask->start();
+}
+
+void MainWindow::modelLoaded(bool success) {
+  if (loadTask == nullptr) {
+    return;
+  }
+  loadTask->wait();
+  std::shared_ptr<FaceClassifier> loaded = loadTask->getClassifier();
+  QMap<int, QString> bundleNames = loadTask->getBundleNames();
+  delete loadTask;
+  loadTask = nullptr;
+
+  if (success) {
+    // publish, recognition still running keeps its own snapshot
+    loaded->setMessageCallback(logCallback());
+    if (!bundleNames.isEmpty()) {
+      names = bundleNames;
+    }
+    loaded->setNames(nameMap());
+    model.swap(loaded);
+    showModelInfo(loaded);
+  } else {
+    recognitionPending = false;
+    setLog("model not loaded");
+  }
+
+  if (pendingLoadTask != nullptr) {
+    loadTask = pendingLoadTask;
+    pendingLoadTask = nullptr;
+    loadTask->start();
+  } else if (success && recognitionPending) {
+    recognize();
+  }
+}
+
+void MainWindow::showModelInfo(
+    std::shared_ptr<FaceClassifier> faceClassifier) {
     // set current feature
     FeatureType featureType = faceClassifier->getFeatureType();
     switch (featureType) {
@@ -468,6 +726,40 @@ void MainWindow::loadClassifier(const QString modelPath,
         ui->statusBar->showMessage("current feature: HAAR");
         break;
     }
+    if (faceClassifier->getBackend() ==
+        FaceClassifier::NEAREST_NEIGHBOR_BACKEND) {
+      setLog("model uses nearest neighbor backend");
+    } else if (faceClassifier->getBackend() ==
+               FaceClassifier::ANN_BACKEND) {
+      setLog("model uses ann backend");
+    } else if (faceClassifier->getBackend() ==
+               FaceClassifier::ONE_VS_REST_BACKEND) {
+      setLog("model uses one vs rest backend");
+    }
+}
+
+void MainWindow::writeBundle() {
+  std::shared_ptr<FaceClassifier> faceClassifier = model.get();
+  if (!faceClassifier->isLoaded() ||
+      faceClassifier->getBackend() == FaceClassifier::ONE_VS_REST_BACKEND) {
+    return;
+  }
+  QString bundlePath = QString(MODEL_BASE_DIR) +
+      QDir::separator() + QString(MODEL_BASE_NAME) +
+      QString(BUNDLE_EXTENSION);
+  if (faceClassifier->saveBundle(bundlePath.toStdString(), nameMap())) {
+    setLog("model bundle written: " + bundlePath);
+  }
+}
+
+std::map<int, std::string> MainWindow::nameMap() {
+  std::map<int, std::string> converted;
+  QMapIterator<int, QString> it(names);
+  while (it.hasNext()) {
+    it.next();
+    converted[it.key()] = it.value().toStdString();
+  }
+  return converted;
 }
 
 void MainWindow::addNewPerson() {
@@ -524,17 +816,16 @@ void MainWindow::importModel(bool) {
       QFileDialog::getOpenFileName(this,
                                    tr("Open model"),
                                    QDir::home().dirName(),
-                                   tr("XML files (*.xml)"));
-  if (modelName.length() > 0) {
+                                   tr("Model files (*.xml *.frm)"));
+  if (modelName.endsWith(QString(BUNDLE_EXTENSION))) {
+    startModelLoad(new ModelLoadTask(QString(), QString(), modelName,
+                                     true, false));
+  } else if (modelName.length() > 0) {
     QString extraInfo = QString(MODEL_BASE_DIR) +
         QDir::separator() + QString(EXTRA_INFO_BASENAME) +
         QString(MODEL_EXTENSION);
-    if (this->faceClassifier->load(modelName.toStdString(),
-                                   extraInfo.toStdString())) {
-      setLog("model loaded");
-    } else {
-      setLog("model not loaded");
-    }
+    startModelLoad(new ModelLoadTask(modelName, extraInfo, QString(),
+                                     false, false));
   }
 }
 
@@ -556,6 +847,17 @@ void MainWindow::exportModel(bool) {
   }
 }
 
+FaceClassifier::FaceClassifierBackend MainWindow::selectedBackend() {
+  if (ui->actionOneVsRest->isChecked()) {
+    return FaceClassifier::ONE_VS_REST_BACKEND;
+  } else if (ui->actionANN->isChecked()) {
+    return FaceClassifier::ANN_BACKEND;
+  } else if (ui->actionNearestNeighbor->isChecked()) {
+    return FaceClassifier::NEAREST_NEIGHBOR_BACKEND;
+  }
+  return FaceClassifier::SVM_BACKEND;
+}
+
 void MainWindow::exit(bool) {
   QApplication::quit();
 }
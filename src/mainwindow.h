@@ -18,11 +18,15 @@
 #include "opencvcamera.h"
 #include "imageviewer.h"
 #include "trainingtask.h"
+#include "modelhandle.h"
+#include "modelloadtask.h"
+#include "recognitionworker.h"
 #include "classifier.h"
 
 #define FACE_IMAGE_ROOT_DIR "faces"
 #define FACE_MODEL_BASE_NAME "facemodel"
 #define FACE_MODEL_EXTENSION ".xml"
+#define FACE_BUNDLE_EXTENSION ".frm"
 #define FACE_MODEL_BASE_DIR "svmmodel"
 #define FACE_EXTRA_INFO_BASENAME "extra"
 #define IMAGE_OUTPUT_EXTENSION ".jpg"
@@ -55,9 +59,22 @@ class MainWindow : public QMainWindow {
   void writeMap();
   void readMap();
   void loadClassifier(const QString modelPath,
-                      const QString extraPath);
+                      const QString extraPath,
+                      bool readBundle = true);
+  void startModelLoad(ModelLoadTask* task);
+  void showModelInfo(std::shared_ptr<FaceClassifier> faceClassifier);
+  void recognize();
+  void loadDefaultClassifier();
+  void writeBundle();
+  std::map<int, std::string> nameMap();
   void loadNameList();
   void loadNameMap();
+  FaceClassifier::FaceClassifierBackend selectedBackend();
+  // feeds the display from a frame source spec instead of the
+  // camera, recording into recordDir when it is not empty
+  bool openSource(const QString spec, const QString recordDir);
+  // core messages into the log, from any thread
+  classifier::MessageCallback logCallback();
 
  public slots:
   void setImage();
@@ -72,9 +89,14 @@ class MainWindow : public QMainWindow {
   void addNewPerson();
   void adjustTrainingStep(int value);
   void addNewPersonWithPrompt(bool);
+  void enrollPerson(bool);
+  void enrollmentComplete(QString person, int label);
+  void modelLoaded(bool success);
   void importModel(bool);
   void exportModel(bool);
   void exit(bool);
+  void continuousRecognition(bool enable);
+  void identified(int trackId, int label, QString name, float confidence);
 
  private:
   Ui::MainWindow *ui = nullptr;
@@ -83,13 +105,18 @@ class MainWindow : public QMainWindow {
   ImageViewer* mainDisplay = nullptr;
   ImageViewer* faceDisplay = nullptr;
   TrainingTask* trainingTask = nullptr;
-  FaceClassifier* faceClassifier = nullptr;
+  ModelLoadTask* loadTask = nullptr;
+  ModelLoadTask* pendingLoadTask = nullptr;
+  RecognitionWorker* recognitionWorker = nullptr;
+  ModelHandle model;
+  bool recognitionPending = false;
   QMap<int, QString> names;
   Mat face;
   bool pictureTaken = false;
   const char* FACE_IMAGE_DIR = FACE_IMAGE_ROOT_DIR;
   const char* MODEL_BASE_NAME = FACE_MODEL_BASE_NAME;
   const char* MODEL_EXTENSION = FACE_MODEL_EXTENSION;
+  const char* BUNDLE_EXTENSION = FACE_BUNDLE_EXTENSION;
   const char* MODEL_BASE_DIR = FACE_MODEL_BASE_DIR;
   const char* EXTRA_INFO_BASENAME = FACE_EXTRA_INFO_BASENAME;
   const char* BG_IMAGE_DIR = DEFAULT_BG_DIR;
@@ -106,6 +133,7 @@ class MainWindow : public QMainWindow {
   const double LOADING_PERCENT = PERCENT;
   const double IMAGE_SIZE = classifier::DEFAULT_IMAGE_SIZE;
   const double TRAINING_STEP = classifier::DEFAULT_TRAINING_STEP;
+  const int TOP_K = classifier::DEFAULT_TOP_K;
   const double LEFT = TRAINING_STEP_LEFT;
   const double DELTA = TRAINING_STEP_DELTA;
 };
@@ -113,6 +141,7 @@ class MainWindow : public QMainWindow {
 #undef FACE_IMAGE_ROOT_DIR
 #undef FACE_MODEL_BASE_NAME
 #undef FACE_MODEL_EXTENSION
+#undef FACE_BUNDLE_EXTENSION
 #undef IMAGE_OUTPUT_EXTENSION
 #undef NAME_MAP
 
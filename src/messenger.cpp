@@ -0,0 +1,24 @@
+#include "messenger.h"
+
+namespace classifier {
+
+/****** Messenger ******/
+void Messenger::setMessageCallback(const MessageCallback& callback) {
+  std::lock_guard<std::mutex> lock(callbackMutex);
+  this->callback = callback;
+}
+
+void Messenger::sendMessage(const string& message) {
+  MessageCallback current;
+  {
+    // a callback replaced meanwhile still finishes this message
+    std::lock_guard<std::mutex> lock(callbackMutex);
+    current = callback;
+  }
+  if (current) {
+    current(message);
+  }
+}
+/*----- end of Messenger -----*/
+
+} /* classifier */
@@ -0,0 +1,38 @@
+#ifndef MESSENGER_H
+#define MESSENGER_H
+
+#include <functional>
+#include <mutex>
+#include <string>
+
+using std::string;
+
+namespace classifier {
+
+// receives the progress messages of a core object. it runs on
+// whatever thread sends the message, gui code has to hand the
+// text over to its own thread.
+typedef std::function<void(const string& message)> MessageCallback;
+
+// base of the core classes that report progress. without a
+// callback the messages are dropped.
+class Messenger {
+ public:
+  Messenger() {}
+  virtual ~Messenger() {}
+  void setMessageCallback(const MessageCallback& callback);
+
+ protected:
+  void sendMessage(const string& message);
+
+ private:
+  Messenger(const Messenger&);
+  Messenger& operator=(const Messenger&);
+
+  std::mutex callbackMutex;
+  MessageCallback callback;
+};
+
+} /* classifier */
+
+#endif /* end of include guard: MESSENGER_H */
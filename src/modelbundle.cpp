@@ -0,0 +1,280 @@
+#include "modelbundle.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#if defined(__unix__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "common.h"
+
+#define SECTION_ALIGNMENT 64
+#define TEMP_SUFFIX ".tmp"
+
+using std::ofstream;
+using std::ifstream;
+using std::ios;
+
+namespace classifier {
+// constants
+const uint32_t MODEL_BUNDLE_MAGIC = 0x424d5246;   // "FRMB"
+const uint32_t MODEL_BUNDLE_VERSION = 1;
+
+// local types
+typedef struct FileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t sectionCount;
+  uint32_t reserved;
+} FileHeader;
+
+typedef struct SectionEntry {
+  uint32_t tag;
+  uint32_t reserved;
+  uint64_t offset;
+  uint64_t size;
+} SectionEntry;
+
+static uint64_t align(uint64_t offset) {
+  return (offset + SECTION_ALIGNMENT - 1) /
+      SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+/****** MappedFile ******/
+MappedFile::MappedFile() : address(nullptr), length(0) {}
+
+MappedFile::~MappedFile() {
+  this->close();
+}
+
+bool MappedFile::open(const string path) {
+  this->close();
+#if defined(__unix__)
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) == -1 || info.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+  void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping stays valid after the descriptor is closed
+  ::close(fd);
+  if (mapped == MAP_FAILED) {
+    return false;
+  }
+  address = static_cast<const char*>(mapped);
+  length = info.st_size;
+  return true;
+#else
+  ifstream in(path.c_str(), ios::in | ios::binary);
+  if (!in.is_open()) {
+    return false;
+  }
+  in.seekg(0, ios::end);
+  buffer.resize(static_cast<size_t>(in.tellg()));
+  in.seekg(0, ios::beg);
+  if (buffer.empty() || !in.read(&buffer[0], buffer.size())) {
+    buffer.clear();
+    return false;
+  }
+  address = &buffer[0];
+  length = buffer.size();
+  return true;
+#endif
+}
+
+void MappedFile::close() {
+#if defined(__unix__)
+  if (address != nullptr) {
+    munmap(const_cast<char*>(address), length);
+  }
+#endif
+  buffer.clear();
+  address = nullptr;
+  length = 0;
+}
+
+const char* MappedFile::data() const {
+  return address;
+}
+
+size_t MappedFile::size() const {
+  return length;
+}
+/*----- end of MappedFile -----*/
+
+/****** ModelBundleWriter ******/
+void ModelBundleWriter::addSection(uint32_t tag, const void* data,
+                                   size_t size) {
+  const char* bytes = static_cast<const char*>(data);
+  sections.push_back(pair<uint32_t, vector<char> >(
+      tag, vector<char>(bytes, bytes + size)));
+}
+
+void ModelBundleWriter::addSection(uint32_t tag, const void* head,
+                                   size_t headSize, const void* data,
+                                   size_t size) {
+  vector<char> content(headSize + size);
+  memcpy(&content[0], head, headSize);
+  if (size > 0) {
+    memcpy(&content[headSize], data, size);
+  }
+  sections.push_back(pair<uint32_t, vector<char> >(tag, content));
+}
+
+bool ModelBundleWriter::write(const string path) const {
+  // a live model may have the target mapped, and a crash must not
+  // leave it truncated. written aside and renamed over it
+  const string temp = path + TEMP_SUFFIX;
+  ofstream out(temp.c_str(), ios::out | ios::binary | ios::trunc);
+  if (!out.is_open()) {
+    return false;
+  }
+
+  FileHeader header;
+  header.magic = MODEL_BUNDLE_MAGIC;
+  header.version = MODEL_BUNDLE_VERSION;
+  header.sectionCount = sections.size();
+  header.reserved = 0;
+
+  // every section starts on an aligned offset so it can be used
+  // in place from the mapped file
+  vector<SectionEntry> entries(sections.size());
+  uint64_t offset = align(sizeof(FileHeader) +
+                          sizeof(SectionEntry) * sections.size());
+  for (size_t i = 0 ; i < sections.size() ; i ++) {
+    entries[i].tag = sections[i].first;
+    entries[i].reserved = 0;
+    entries[i].offset = offset;
+    entries[i].size = sections[i].second.size();
+    offset = align(offset + entries[i].size);
+  }
+
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  if (!entries.empty()) {
+    out.write(reinterpret_cast<const char*>(&entries[0]),
+              sizeof(SectionEntry) * entries.size());
+  }
+  const char padding[SECTION_ALIGNMENT] = {0};
+  for (size_t i = 0 ; i < sections.size() ; i ++) {
+    const uint64_t position = static_cast<uint64_t>(out.tellp());
+    out.write(padding, entries[i].offset - position);
+    if (!sections[i].second.empty()) {
+      out.write(&sections[i].second[0], sections[i].second.size());
+    }
+  }
+  out.close();
+  if (!out.good() || !replaceFile(temp, path)) {
+    remove(temp.c_str());
+    return false;
+  }
+  return true;
+}
+/*----- end of ModelBundleWriter -----*/
+
+/****** ModelBundleReader ******/
+bool ModelBundleReader::open(const string path) {
+  table.clear();
+  file = std::make_shared<MappedFile>();
+  if (!file->open(path) || file->size() < sizeof(FileHeader)) {
+    file.reset();
+    return false;
+  }
+
+  FileHeader header;
+  memcpy(&header, file->data(), sizeof(header));
+  if (header.magic != MODEL_BUNDLE_MAGIC ||
+      header.version > MODEL_BUNDLE_VERSION ||
+      sizeof(FileHeader) + sizeof(SectionEntry) * header.sectionCount >
+      file->size()) {
+#ifdef DEBUG
+    fprintf(stderr, "not a model bundle or unsupported version\n");
+#endif
+    file.reset();
+    return false;
+  }
+
+  const char* entries = file->data() + sizeof(FileHeader);
+  for (uint32_t i = 0 ; i < header.sectionCount ; i ++) {
+    SectionEntry entry;
+    memcpy(&entry, entries + sizeof(SectionEntry) * i, sizeof(entry));
+    if (entry.offset + entry.size > file->size()) {
+      file.reset();
+      table.clear();
+      return false;
+    }
+    table[entry.tag] = pair<uint64_t, uint64_t>(entry.offset, entry.size);
+  }
+  return true;
+}
+
+const char* ModelBundleReader::section(uint32_t tag, size_t& size) const {
+  map<uint32_t, pair<uint64_t, uint64_t> >::const_iterator it =
+      table.find(tag);
+  if (!file || it == table.end()) {
+    size = 0;
+    return nullptr;
+  }
+  size = static_cast<size_t>(it->second.second);
+  return file->data() + it->second.first;
+}
+
+std::shared_ptr<MappedFile> ModelBundleReader::getFile() const {
+  return file;
+}
+/*----- end of ModelBundleReader -----*/
+
+/****** name map ******/
+void encodeNames(const map<int, string>& names, vector<char>& blob) {
+  // count, then (label, length, bytes) per entry
+  blob.clear();
+  const int32_t count = names.size();
+  blob.insert(blob.end(), reinterpret_cast<const char*>(&count),
+              reinterpret_cast<const char*>(&count) + sizeof(count));
+  for (map<int, string>::const_iterator it = names.begin() ;
+       it != names.end() ; it ++) {
+    const int32_t label = it->first;
+    const int32_t length = it->second.size();
+    blob.insert(blob.end(), reinterpret_cast<const char*>(&label),
+                reinterpret_cast<const char*>(&label) + sizeof(label));
+    blob.insert(blob.end(), reinterpret_cast<const char*>(&length),
+                reinterpret_cast<const char*>(&length) + sizeof(length));
+    blob.insert(blob.end(), it->second.begin(), it->second.end());
+  }
+}
+
+bool decodeNames(const char* blob, size_t size, map<int, string>& names) {
+  names.clear();
+  if (blob == nullptr || size < sizeof(int32_t)) {
+    return false;
+  }
+  int32_t count = 0;
+  size_t pos = 0;
+  memcpy(&count, blob, sizeof(count));
+  pos += sizeof(count);
+  for (int32_t i = 0 ; i < count ; i ++) {
+    int32_t label = 0, length = 0;
+    if (pos + 2 * sizeof(int32_t) > size) return false;
+    memcpy(&label, blob + pos, sizeof(label));
+    memcpy(&length, blob + pos + sizeof(label), sizeof(length));
+    pos += 2 * sizeof(int32_t);
+    if (length < 0 || pos + length > size) return false;
+    names[label] = string(blob + pos, length);
+    pos += length;
+  }
+  return true;
+}
+/*----- end of name map -----*/
+
+} /* classifier */
+
+#undef SECTION_ALIGNMENT
+#undef TEMP_SUFFIX
@@ -0,0 +1,132 @@
+#ifndef MODELBUNDLE_H
+#define MODELBUNDLE_H
+
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using std::string;
+using std::map;
+using std::vector;
+using std::pair;
+
+namespace classifier {
+
+// constants
+extern const uint32_t MODEL_BUNDLE_MAGIC;
+extern const uint32_t MODEL_BUNDLE_VERSION;
+
+// sections of a model bundle
+typedef enum {
+  BUNDLE_METADATA = 1,    // BundleMetadata
+  BUNDLE_NAMES,           // label -> name map
+  BUNDLE_SVM,             // SVMEvaluator blob
+  BUNDLE_GALLERY,         // GalleryHeader + float rows
+  BUNDLE_GALLERY_LABELS,  // int32 per gallery row
+  BUNDLE_GRAPH,           // GraphHeader + flattened hnsw links
+  BUNDLE_CALIBRATION,     // BundleCalibration
+  BUNDLE_PROJECTION,      // ProjectionHeader + mean + basis rows
+  BUNDLE_SELECTION        // SelectionHeader + int32 per kept column
+} BundleSection;
+
+typedef struct BundleMetadata {
+  int32_t backend;
+  int32_t featureType;
+  int32_t imageWidth;
+  int32_t imageHeight;
+  int32_t varCount;
+  int32_t distance;
+  float rejectionThreshold;
+  int32_t flags;            // BUNDLE_FLAG_*
+} BundleMetadata;
+
+// metadata flags
+typedef enum {
+  BUNDLE_FLAG_REJECTION = 1   // rejectionThreshold is set
+} BundleFlag;
+
+typedef struct BundleCalibration {
+  float plattA;
+  float plattB;
+  int32_t reserved[2];
+} BundleCalibration;
+
+typedef struct ProjectionHeader {
+  int32_t type;
+  int32_t inputLength;
+  int32_t outputLength;
+  int32_t reserved;
+} ProjectionHeader;
+
+typedef struct SelectionHeader {
+  int32_t inputLength;
+  int32_t count;
+  int32_t reserved[2];
+} SelectionHeader;
+
+typedef struct GalleryHeader {
+  int32_t rows;
+  int32_t cols;
+  int32_t reserved[2];
+} GalleryHeader;
+
+typedef struct GraphHeader {
+  int32_t m;
+  int32_t efConstruction;
+  int32_t entryPoint;
+  int32_t maxLevel;
+} GraphHeader;
+
+// read only view of a whole file
+// memory mapped on unix, read into memory elsewhere
+class MappedFile {
+ public:
+  MappedFile();
+  ~MappedFile();
+  bool open(const string path);
+  void close();
+  const char* data() const;
+  size_t size() const;
+
+ private:
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+
+  const char* address;
+  size_t length;
+  vector<char> buffer;
+};
+
+// single file, versioned container of aligned binary sections
+class ModelBundleWriter {
+ public:
+  void addSection(uint32_t tag, const void* data, size_t size);
+  void addSection(uint32_t tag, const void* head, size_t headSize,
+                  const void* data, size_t size);
+  bool write(const string path) const;
+
+ private:
+  vector<pair<uint32_t, vector<char> > > sections;
+};
+
+class ModelBundleReader {
+ public:
+  bool open(const string path);
+  const char* section(uint32_t tag, size_t& size) const;
+  std::shared_ptr<MappedFile> getFile() const;
+
+ private:
+  std::shared_ptr<MappedFile> file;
+  map<uint32_t, pair<uint64_t, uint64_t> > table;
+};
+
+// label -> name map encoding
+void encodeNames(const map<int, string>& names, vector<char>& blob);
+bool decodeNames(const char* blob, size_t size, map<int, string>& names);
+
+} /* classifier */
+
+#endif /* end of include guard: MODELBUNDLE_H */
@@ -0,0 +1,19 @@
+#include "modelhandle.h"
+
+/****** ModelHandle ******/
+ModelHandle::ModelHandle() {}
+
+std::shared_ptr<FaceClassifier> ModelHandle::get() const {
+  return std::atomic_load(&current);
+}
+
+std::shared_ptr<FaceClassifier> ModelHandle::swap(
+    const std::shared_ptr<FaceClassifier>& next) {
+  return std::atomic_exchange(&current, next);
+}
+
+std::shared_ptr<FaceClassifier> ModelHandle::wrap(
+    FaceClassifier* classifier) {
+  return std::shared_ptr<FaceClassifier>(classifier);
+}
+/*----- end of ModelHandle -----*/
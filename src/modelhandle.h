@@ -0,0 +1,31 @@
+#ifndef MODELHANDLE_H
+#define MODELHANDLE_H
+
+#include <memory>
+
+#include "classifier.h"
+
+using classifier::FaceClassifier;
+
+// the live face classifier, swapped as a whole
+// readers take a snapshot with get() and keep using it even when a newer
+// model is published meanwhile. the old model is released once its last
+// snapshot is dropped, so a model is never changed while being used.
+class ModelHandle {
+ public:
+  ModelHandle();
+  std::shared_ptr<FaceClassifier> get() const;
+  std::shared_ptr<FaceClassifier> swap(
+      const std::shared_ptr<FaceClassifier>& next);
+
+  // owning pointer, the last snapshot deletes it on any thread
+  static std::shared_ptr<FaceClassifier> wrap(FaceClassifier* classifier);
+
+ private:
+  ModelHandle(const ModelHandle&);
+  ModelHandle& operator=(const ModelHandle&);
+
+  std::shared_ptr<FaceClassifier> current;
+};
+
+#endif /* end of include guard: MODELHANDLE_H */
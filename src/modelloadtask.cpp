@@ -0,0 +1,74 @@
+#include "modelloadtask.h"
+
+ModelLoadTask::ModelLoadTask(QString _modelPath,
+                             QString _extraPath,
+                             QString _bundlePath,
+                             bool _readBundle,
+                             bool _writeBundle,
+                             QMap<int, QString> _names) {
+  modelPath = _modelPath;
+  extraPath = _extraPath;
+  bundlePath = _bundlePath;
+  readBundle = _readBundle;
+  writeBundle = _writeBundle;
+  names = _names;
+}
+
+void ModelLoadTask::run() {
+  FaceClassifier* loading = new FaceClassifier();
+  loading->setMessageCallback([this](const std::string& message) {
+    sendMessage(QString::fromStdString(message));
+  });
+
+  bool success = false;
+  if (readBundle && QFile::exists(bundlePath)) {
+    std::map<int, std::string> stored;
+    success = loading->loadBundle(bundlePath.toStdString(), stored);
+    if (success) {
+      sendMessage("model bundle loaded: " + bundlePath);
+      for (std::map<int, std::string>::iterator it = stored.begin() ;
+           it != stored.end() ; it ++) {
+        bundleNames.insert(it->first, QString(it->second.c_str()));
+      }
+    }
+  }
+
+  if (!success && modelPath.length() > 0) {
+    success = loading->load(modelPath.toStdString(),
+                            extraPath.toStdString()) &&
+        loading->isLoaded();
+    if (success) {
+      sendMessage("model loaded: " + modelPath);
+    }
+    // next load can skip the xml parsing
+    if (success && writeBundle && loading->getBackend() !=
+        FaceClassifier::ONE_VS_REST_BACKEND) {
+      std::map<int, std::string> stored;
+      QMapIterator<int, QString> it(names);
+      while (it.hasNext()) {
+        it.next();
+        stored[it.key()] = it.value().toStdString();
+      }
+      if (loading->saveBundle(bundlePath.toStdString(), stored)) {
+        sendMessage("model bundle written: " + bundlePath);
+      }
+    }
+  }
+
+  // the task goes away, whoever publishes the model listens next
+  loading->setMessageCallback(classifier::MessageCallback());
+  if (success) {
+    result = ModelHandle::wrap(loading);
+  } else {
+    delete loading;
+  }
+  loaded(success);
+}
+
+std::shared_ptr<FaceClassifier> ModelLoadTask::getClassifier() const {
+  return result;
+}
+
+QMap<int, QString> ModelLoadTask::getBundleNames() const {
+  return bundleNames;
+}
@@ -0,0 +1,44 @@
+#ifndef MODELLOADTASK_H
+#define MODELLOADTASK_H
+
+#include <QThread>
+#include <QString>
+#include <QFile>
+#include <QMap>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "classifier.h"
+#include "modelhandle.h"
+
+using classifier::FaceClassifier;
+
+// loads a model into a new classifier off the gui thread
+// the result is only handed out once it is completely loaded,
+// ready to be published through a ModelHandle.
+class ModelLoadTask : public QThread {
+  Q_OBJECT
+ public:
+  ModelLoadTask(QString _modelPath,
+                QString _extraPath,
+                QString _bundlePath,
+                bool _readBundle = true,
+                bool _writeBundle = true,
+                QMap<int, QString> _names = QMap<int, QString>());
+  virtual void run();
+  std::shared_ptr<FaceClassifier> getClassifier() const;
+  QMap<int, QString> getBundleNames() const;
+
+ signals:
+  void sendMessage(QString message);
+  void loaded(bool success);
+
+ private:
+  QString modelPath, extraPath, bundlePath;
+  bool readBundle, writeBundle;
+  QMap<int, QString> names, bundleNames;
+  std::shared_ptr<FaceClassifier> result;
+};
+
+#endif /* end of include guard: MODELLOADTASK_H */
@@ -0,0 +1,128 @@
+#include "modelselection.h"
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+
+namespace classifier {
+// constants
+const double DEFAULT_LATENCY_TARGET = 10;
+
+/****** ModelSelection ******/
+ModelSelection::ModelSelection(const FaceClassifierParams& params,
+                               double latencyTarget) {
+  this->params = params;
+  this->latencyTarget = latencyTarget;
+}
+
+FaceClassifier* ModelSelection::select(const vector<FeatureType>& types,
+                                       vector<Mat>& data, Mat& labels,
+                                       const DataSplit& split,
+                                       const vector<double>& extractionTime,
+                                       const TrainingBudget& budget) {
+  reports.clear();
+  selected = -1;
+  if (types.empty() || data.size() != types.size()) {
+    return nullptr;
+  }
+  const int count = static_cast<int>(types.size());
+
+  // the candidates share the cores instead of each taking all of them,
+  // the thread count is process wide so it is set once for all fits
+  const int previousThreads = cv::getNumThreads();
+  const int threads = budget.threads > 0 ?
+      budget.threads : cv::getNumberOfCPUs();
+  cv::setNumThreads(std::max(1, threads / count));
+  TrainingBudget candidateBudget = budget;
+  candidateBudget.threads = 0;
+  candidateBudget.memoryBytes = budget.memoryBytes / count;
+
+  vector<std::unique_ptr<FaceClassifier> > candidates;
+  for (int i = 0 ; i < count ; i ++) {
+    FaceClassifierParams candidateParams = params;
+    candidateParams.featureType = types[i];
+    candidates.emplace_back(new FaceClassifier(candidateParams, data[i],
+                                               labels));
+    candidates[i]->setSplit(split);
+    candidates[i]->setBudget(candidateBudget);
+    // called on the worker threads, the callback has to cope
+    const string prefix = string("[") + featureName(types[i]) + "] ";
+    candidates[i]->setMessageCallback(
+        [this, prefix](const string& message) {
+          sendMessage(prefix + message);
+        });
+  }
+
+  sendMessage(string("training ") + toString(count) +
+              string(" feature types at once..."));
+  vector<std::thread> workers;
+  for (int i = 0 ; i < count ; i ++) {
+    FaceClassifier* candidate = candidates[i].get();
+    workers.emplace_back([candidate]() { candidate->train(); });
+  }
+  for (size_t i = 0 ; i < workers.size() ; i ++) {
+    workers[i].join();
+  }
+  cv::setNumThreads(previousThreads);
+
+  // latency is measured one candidate at a time, undisturbed
+  int best = -1, fastest = 0;
+  for (int i = 0 ; i < count ; i ++) {
+    CandidateReport report;
+    report.featureType = types[i];
+    report.accuracy = candidates[i]->testAccuracy();
+    report.extractionTime = i < static_cast<int>(extractionTime.size()) ?
+        extractionTime[i] : 0;
+    report.predictionTime = candidates[i]->predictionLatency();
+    const double latency = report.extractionTime + report.predictionTime;
+    report.withinTarget = latencyTarget <= 0 || latency <= latencyTarget;
+    reports.push_back(report);
+
+    sendMessage(string(featureName(types[i])) +
+                string(" | test accuracy: ") +
+                toString(report.accuracy) +
+                string(" | extraction: ") +
+                toString(report.extractionTime) +
+                string(" ms | prediction: ") +
+                toString(report.predictionTime) +
+                string(" ms") +
+                string(report.withinTarget ? "" : " | over target"));
+
+    if (latency < reports[fastest].extractionTime +
+        reports[fastest].predictionTime) {
+      fastest = i;
+    }
+    if (report.withinTarget &&
+        (best < 0 || report.accuracy > reports[best].accuracy)) {
+      best = i;
+    }
+  }
+
+  if (best < 0) {
+    sendMessage(string("no feature type within ") +
+                toString(latencyTarget) +
+                string(" ms | using the fastest one"));
+    best = fastest;
+  }
+  sendMessage(string("selected ") + featureName(types[best]) +
+              string(" | test accuracy: ") +
+              toString(reports[best].accuracy));
+
+  selected = best;
+  FaceClassifier* winner = candidates[best].release();
+  winner->setMessageCallback(MessageCallback());
+  // the length based guess cannot tell every type apart
+  winner->setFeatureType(types[best]);
+  return winner;
+}
+
+const vector<CandidateReport>& ModelSelection::getReports() const {
+  return reports;
+}
+
+int ModelSelection::getSelected() const {
+  return selected;
+}
+/*----- end of ModelSelection -----*/
+
+} /* classifier */
@@ -0,0 +1,57 @@
+#ifndef MODELSELECTION_H
+#define MODELSELECTION_H
+
+#include <opencv2/core.hpp>
+
+#include <vector>
+
+#include "classifier.h"
+#include "datasplit.h"
+#include "messenger.h"
+
+using std::vector;
+using cv::Mat;
+
+namespace classifier {
+
+// constants
+extern const double DEFAULT_LATENCY_TARGET;
+
+// how one feature type did on the held out rows
+typedef struct CandidateReport {
+  FeatureType featureType;
+  double accuracy;
+  double extractionTime;    // ms per image
+  double predictionTime;    // ms per sample
+  bool withinTarget;        // extraction + prediction meets the target
+} CandidateReport;
+
+// trains one classifier per feature type at the same time, all on
+// features extracted from the same decoded images and the same split.
+// the most accurate candidate within the latency target is kept,
+// the fastest one if none of them meets it.
+class ModelSelection : public Messenger {
+ public:
+  ModelSelection(const FaceClassifierParams& params,
+                 double latencyTarget = DEFAULT_LATENCY_TARGET);
+  virtual ~ModelSelection() {}
+  // data[i] holds the features of types[i], the caller owns the result
+  FaceClassifier* select(const vector<FeatureType>& types,
+                         vector<Mat>& data, Mat& labels,
+                         const DataSplit& split,
+                         const vector<double>& extractionTime,
+                         const TrainingBudget& budget);
+  const vector<CandidateReport>& getReports() const;
+  // index into types of the last selection, -1 if there was none
+  int getSelected() const;
+
+ private:
+  FaceClassifierParams params;
+  double latencyTarget;
+  vector<CandidateReport> reports;
+  int selected = -1;
+};
+
+} /* classifier */
+
+#endif /* end of include guard: MODELSELECTION_H */
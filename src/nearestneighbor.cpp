@@ -0,0 +1,403 @@
+#include "nearestneighbor.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cstdio>
+#include <map>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define DEFAULT_PROTOTYPE_CANDIDATES 3
+
+#define GALLERY_KEY "gallery"
+#define LABELS_KEY "labels"
+#define DISTANCE_KEY "distance"
+
+#ifdef DEBUG
+#include <iostream>
+using std::cout;
+using std::endl;
+#endif
+
+using std::map;
+using std::pair;
+using cv::FileStorage;
+
+namespace classifier {
+
+/****** distance kernels ******/
+#if defined(__SSE2__)
+static inline float horizontalSum(__m128 v) {
+  __m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+  __m128 sums = _mm_add_ps(v, shuffled);
+  shuffled = _mm_movehl_ps(shuffled, sums);
+  sums = _mm_add_ss(sums, shuffled);
+  return _mm_cvtss_f32(sums);
+}
+#endif
+
+float chiSquareDistance(const float* a, const float* b, int length) {
+  float result = 0;
+  int i = 0;
+#if defined(__SSE2__)
+  const __m128 zero = _mm_setzero_ps();
+  __m128 acc = _mm_setzero_ps();
+  for ( ; i + 4 <= length ; i += 4) {
+    const __m128 x = _mm_loadu_ps(a + i);
+    const __m128 y = _mm_loadu_ps(b + i);
+    const __m128 d = _mm_sub_ps(x, y);
+    const __m128 s = _mm_add_ps(x, y);
+    // empty bins divide by zero, mask them out
+    const __m128 mask = _mm_cmpgt_ps(s, zero);
+    const __m128 q = _mm_div_ps(_mm_mul_ps(d, d), s);
+    acc = _mm_add_ps(acc, _mm_and_ps(mask, q));
+  }
+  result = horizontalSum(acc);
+#endif
+  for ( ; i < length ; i ++) {
+    const float s = a[i] + b[i];
+    if (s > 0) {
+      const float d = a[i] - b[i];
+      result += d * d / s;
+    }
+  }
+  return result;
+}
+
+float intersectionDistance(const float* a, const float* b, int length) {
+  float result = 0;
+  int i = 0;
+#if defined(__SSE2__)
+  __m128 acc = _mm_setzero_ps();
+  for ( ; i + 4 <= length ; i += 4) {
+    acc = _mm_add_ps(acc, _mm_min_ps(_mm_loadu_ps(a + i),
+                                     _mm_loadu_ps(b + i)));
+  }
+  result = horizontalSum(acc);
+#endif
+  for ( ; i < length ; i ++) {
+    result += std::min(a[i], b[i]);
+  }
+  // histograms are l1 normalized so the intersection is in [0, 1]
+  return 1.0f - result;
+}
+
+float squaredL2Distance(const float* a, const float* b, int length) {
+  float result = 0;
+  int i = 0;
+#if defined(__SSE2__)
+  __m128 acc = _mm_setzero_ps();
+  for ( ; i + 4 <= length ; i += 4) {
+    const __m128 d = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+    acc = _mm_add_ps(acc, _mm_mul_ps(d, d));
+  }
+  result = horizontalSum(acc);
+#endif
+  for ( ; i < length ; i ++) {
+    const float d = a[i] - b[i];
+    result += d * d;
+  }
+  return result;
+}
+
+float dotProduct(const float* a, const float* b, int length) {
+  float result = 0;
+  int i = 0;
+#if defined(__SSE2__)
+  __m128 acc = _mm_setzero_ps();
+  for ( ; i + 4 <= length ; i += 4) {
+    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i),
+                                     _mm_loadu_ps(b + i)));
+  }
+  result = horizontalSum(acc);
+#endif
+  for ( ; i < length ; i ++) {
+    result += a[i] * b[i];
+  }
+  return result;
+}
+
+float histogramDistance(HistogramDistance type,
+                        const float* a, const float* b, int length) {
+  switch (type) {
+    case HISTOGRAM_INTERSECTION:
+      return intersectionDistance(a, b, length);
+    case CHI_SQUARE:
+    default:
+      return chiSquareDistance(a, b, length);
+  }
+}
+/*----- end of distance kernels -----*/
+
+/****** NearestNeighborClassifier ******/
+NearestNeighborClassifier::NearestNeighborClassifier() {
+  this->distance = CHI_SQUARE;
+  this->usePrototypes = true;
+  this->prototypeCandidates = DEFAULT_PROTOTYPE_CANDIDATES;
+}
+
+NearestNeighborClassifier::NearestNeighborClassifier(
+    HistogramDistance distance) {
+  this->distance = distance;
+  this->usePrototypes = true;
+  this->prototypeCandidates = DEFAULT_PROTOTYPE_CANDIDATES;
+}
+
+void NearestNeighborClassifier::setDistance(HistogramDistance distance) {
+  this->distance = distance;
+}
+
+HistogramDistance NearestNeighborClassifier::getDistance() const {
+  return this->distance;
+}
+
+void NearestNeighborClassifier::setPrototypeRejection(bool enable,
+                                                      int candidates) {
+  this->usePrototypes = enable;
+  this->prototypeCandidates = candidates > 0 ? candidates : 1;
+}
+
+void NearestNeighborClassifier::clear() {
+  gallery.release();
+  galleryLabels.release();
+  prototypes.release();
+  prototypeLabels.clear();
+  members.clear();
+}
+
+void NearestNeighborClassifier::normalize(const Mat& sample,
+                                          Mat& normalized) {
+  sample.convertTo(normalized, CV_32FC1);
+  const double total = cv::sum(normalized)[0];
+  if (total > 0) {
+    normalized *= 1.0 / total;
+  }
+}
+
+void NearestNeighborClassifier::enroll(const Mat& samples,
+                                       const Mat& labels) {
+  if (samples.rows != labels.rows || labels.type() != CV_32SC1) {
+#ifdef DEBUG
+    fprintf(stderr, "inconsistant samples and labels\n");
+#endif
+    return;
+  }
+
+  Mat normalized;
+  for (int i = 0 ; i < samples.rows ; i ++) {
+    if (gallery.data && samples.cols != gallery.cols) {
+#ifdef DEBUG
+      fprintf(stderr, "inconsistant feature length\n");
+#endif
+      return;
+    }
+    normalize(samples.row(i), normalized);
+    // push_back keeps the gallery in one contiguous block
+    gallery.push_back(normalized);
+    galleryLabels.push_back(labels.ptr<int>(i)[0]);
+  }
+  updatePrototypes();
+}
+
+void NearestNeighborClassifier::enroll(const Mat& samples, int label) {
+  Mat labels(samples.rows, 1, CV_32SC1, cv::Scalar(label));
+  enroll(samples, labels);
+}
+
+void NearestNeighborClassifier::updatePrototypes() {
+  map<int, int> index;
+  prototypeLabels.clear();
+  members.clear();
+  for (int i = 0 ; i < galleryLabels.rows ; i ++) {
+    const int label = galleryLabels.ptr<int>(i)[0];
+    if (index.find(label) == index.end()) {
+      index.insert(pair<int, int>(label, prototypeLabels.size()));
+      prototypeLabels.push_back(label);
+      members.push_back(vector<int>());
+    }
+    members[index[label]].push_back(i);
+  }
+
+  prototypes = Mat::zeros(prototypeLabels.size(), gallery.cols, CV_32FC1);
+  for (size_t p = 0 ; p < members.size() ; p ++) {
+    Mat prototype = prototypes.row(p);
+    for (size_t m = 0 ; m < members[p].size() ; m ++) {
+      prototype += gallery.row(members[p][m]);
+    }
+    prototype *= 1.0 / members[p].size();
+  }
+}
+
+int NearestNeighborClassifier::predict(const Mat& sample,
+                                       float* minDistance) const {
+  if (!isTrained() || sample.cols != gallery.cols) {
+#ifdef DEBUG
+    fprintf(stderr, "gallery empty or inconsistant feature length\n");
+#endif
+    return INT_MAX;
+  }
+
+  Mat query;
+  normalize(sample.row(0), query);
+  const float* q = query.ptr<float>(0);
+  const int length = gallery.cols;
+
+  float bestDistance = FLT_MAX;
+  int bestLabel = INT_MAX;
+
+  if (usePrototypes &&
+      static_cast<int>(prototypeLabels.size()) > prototypeCandidates) {
+    // rank identities by their prototype and only scan the closest
+    vector<pair<float, int> > ranked(prototypeLabels.size());
+    for (int p = 0 ; p < prototypes.rows ; p ++) {
+      ranked[p] = pair<float, int>(
+          histogramDistance(distance, q, prototypes.ptr<float>(p), length),
+          p);
+    }
+    std::partial_sort(ranked.begin(),
+                      ranked.begin() + prototypeCandidates,
+                      ranked.end());
+
+    for (int c = 0 ; c < prototypeCandidates ; c ++) {
+      const vector<int>& rows = members[ranked[c].second];
+      for (size_t m = 0 ; m < rows.size() ; m ++) {
+        const float d = histogramDistance(distance, q,
+                                          gallery.ptr<float>(rows[m]),
+                                          length);
+        if (d < bestDistance) {
+          bestDistance = d;
+          bestLabel = prototypeLabels[ranked[c].second];
+        }
+      }
+    }
+  } else {
+    for (int i = 0 ; i < gallery.rows ; i ++) {
+      const float d = histogramDistance(distance, q,
+                                        gallery.ptr<float>(i), length);
+      if (d < bestDistance) {
+        bestDistance = d;
+        bestLabel = galleryLabels.ptr<int>(i)[0];
+      }
+    }
+  }
+
+  if (minDistance != nullptr) {
+    *minDistance = bestDistance;
+  }
+  return bestLabel;
+}
+
+void NearestNeighborClassifier::searchIdentities(
+    const Mat& sample, int k,
+    vector<pair<float, int> >& identities) const {
+  identities.clear();
+  if (!isTrained() || sample.cols != gallery.cols || k <= 0) {
+    return;
+  }
+
+  Mat query;
+  normalize(sample.row(0), query);
+  const float* q = query.ptr<float>(0);
+  const int length = gallery.cols;
+
+  // closest gallery row of every identity
+  vector<pair<float, int> > ranked(prototypeLabels.size());
+  for (size_t p = 0 ; p < prototypeLabels.size() ; p ++) {
+    ranked[p] = pair<float, int>(0, static_cast<int>(p));
+  }
+  size_t candidates = ranked.size();
+  if (usePrototypes) {
+    // only scan the identities whose prototype is close enough
+    for (size_t p = 0 ; p < ranked.size() ; p ++) {
+      ranked[p].first = histogramDistance(distance, q,
+                                          prototypes.ptr<float>(p), length);
+    }
+    candidates = std::min(ranked.size(), static_cast<size_t>(
+        std::max(k, prototypeCandidates)));
+    std::partial_sort(ranked.begin(), ranked.begin() + candidates,
+                      ranked.end());
+  }
+
+  for (size_t c = 0 ; c < candidates ; c ++) {
+    const vector<int>& rows = members[ranked[c].second];
+    float best = FLT_MAX;
+    for (size_t m = 0 ; m < rows.size() ; m ++) {
+      best = std::min(best, histogramDistance(distance, q,
+                                              gallery.ptr<float>(rows[m]),
+                                              length));
+    }
+    identities.push_back(pair<float, int>(
+        best, prototypeLabels[ranked[c].second]));
+  }
+
+  const size_t count = std::min(identities.size(), static_cast<size_t>(k));
+  std::partial_sort(identities.begin(), identities.begin() + count,
+                    identities.end());
+  identities.resize(count);
+}
+
+bool NearestNeighborClassifier::isTrained() const {
+  return gallery.rows > 0;
+}
+
+int NearestNeighborClassifier::getVarCount() const {
+  return gallery.cols;
+}
+
+const Mat& NearestNeighborClassifier::getGallery() const {
+  return gallery;
+}
+
+const Mat& NearestNeighborClassifier::getLabels() const {
+  return galleryLabels;
+}
+
+void NearestNeighborClassifier::attach(const Mat& normalizedGallery,
+                                       const Mat& labels) {
+  // used as is, the gallery may point into a mapped model bundle
+  gallery = normalizedGallery;
+  galleryLabels = labels;
+  updatePrototypes();
+}
+
+bool NearestNeighborClassifier::save(const string path) const {
+  FileStorage fs(path, FileStorage::WRITE);
+  if (!fs.isOpened()) {
+    return false;
+  }
+  fs << DISTANCE_KEY << static_cast<int>(distance);
+  fs << GALLERY_KEY << gallery;
+  fs << LABELS_KEY << galleryLabels;
+  return true;
+}
+
+bool NearestNeighborClassifier::load(const string path) {
+  FileStorage fs(path, FileStorage::READ);
+  if (!fs.isOpened()) {
+    return false;
+  }
+  int type = CHI_SQUARE;
+  fs[DISTANCE_KEY] >> type;
+  distance = static_cast<HistogramDistance>(type);
+  fs[GALLERY_KEY] >> gallery;
+  fs[LABELS_KEY] >> galleryLabels;
+  if (gallery.rows != galleryLabels.rows) {
+    clear();
+    return false;
+  }
+  updatePrototypes();
+  return isTrained();
+}
+/*----- end of NearestNeighborClassifier -----*/
+
+} /* classifier */
+
+#undef DEFAULT_PROTOTYPE_CANDIDATES
+
+#undef GALLERY_KEY
+#undef LABELS_KEY
+#undef DISTANCE_KEY
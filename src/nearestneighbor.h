@@ -0,0 +1,74 @@
+#ifndef NEARESTNEIGHBOR_H
+#define NEARESTNEIGHBOR_H
+
+#include <opencv2/core.hpp>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+using std::string;
+using std::vector;
+using std::pair;
+using cv::Mat;
+
+namespace classifier {
+
+// supported histogram distance
+typedef enum {
+  CHI_SQUARE,               // sum (a - b)^2 / (a + b)
+  HISTOGRAM_INTERSECTION    // 1 - sum min(a, b)
+} HistogramDistance;
+
+// distance kernels over two float vectors of the same length
+// (SSE2 when available, scalar otherwise)
+float chiSquareDistance(const float* a, const float* b, int length);
+float intersectionDistance(const float* a, const float* b, int length);
+float histogramDistance(HistogramDistance type,
+                        const float* a, const float* b, int length);
+float squaredL2Distance(const float* a, const float* b, int length);
+float dotProduct(const float* a, const float* b, int length);
+
+// nearest neighbor recognizer over l1 normalized histograms
+// all enrolled samples live in one contiguous gallery matrix,
+// optional per-identity prototypes (mean histograms) are used to
+// reject unlikely identities before the exhaustive gallery scan
+class NearestNeighborClassifier {
+ public:
+  NearestNeighborClassifier();
+  explicit NearestNeighborClassifier(HistogramDistance distance);
+  void setDistance(HistogramDistance distance);
+  HistogramDistance getDistance() const;
+  void setPrototypeRejection(bool enable, int candidates);
+  void clear();
+  void enroll(const Mat& samples, const Mat& labels);
+  void enroll(const Mat& samples, int label);
+  int predict(const Mat& sample, float* minDistance = nullptr) const;
+  void searchIdentities(const Mat& sample, int k,
+                        vector<pair<float, int> >& identities) const;
+  bool isTrained() const;
+  int getVarCount() const;
+  const Mat& getGallery() const;
+  const Mat& getLabels() const;
+  bool save(const string path) const;
+  bool load(const string path);
+  void attach(const Mat& normalizedGallery, const Mat& labels);
+
+  static void normalize(const Mat& sample, Mat& normalized);
+
+ private:
+  void updatePrototypes();
+
+  HistogramDistance distance;
+  bool usePrototypes;
+  int prototypeCandidates;
+  Mat gallery;          // CV_32FC1, one normalized histogram per row
+  Mat galleryLabels;    // CV_32SC1, one label per gallery row
+  Mat prototypes;       // CV_32FC1, one mean histogram per identity
+  vector<int> prototypeLabels;
+  vector<vector<int> > members;   // gallery rows of each prototype
+};
+
+} /* classifier */
+
+#endif /* end of include guard: NEARESTNEIGHBOR_H */
@@ -0,0 +1,289 @@
+#include "onevsrest.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <set>
+
+#define POSITIVE_LABEL 1
+#define NEGATIVE_LABEL 0
+#define SAMPLING_SEED 0x5eed
+
+#define GAMMA_KEY "gamma"
+#define C_KEY "c"
+#define POOL_KEY "pool"
+#define POOL_LABELS_KEY "poolLabels"
+#define COMPONENTS_KEY "components"
+#define LABEL_KEY "label"
+
+using std::set;
+using cv::ml::TrainData;
+using cv::ml::ROW_SAMPLE;
+using cv::ml::StatModel;
+using cv::FileStorage;
+using cv::FileNode;
+using cv::FileNodeIterator;
+
+namespace classifier {
+// constants
+const int MAX_NEGATIVE_SAMPLES = 2000;
+
+/****** OneVsRestSVM ******/
+class OneVsRestSVM::ComponentTrainer : public cv::ParallelLoopBody {
+ public:
+  ComponentTrainer(const OneVsRestSVM& owner, const vector<int>& order,
+                   vector<Ptr<SVM> >& trained)
+      : owner(owner), order(order), trained(trained) {}
+
+  virtual void operator()(const cv::Range& range) const {
+    for (int i = range.start ; i < range.end ; i ++) {
+      trained[i] = owner.trainComponent(order[i], owner.pool,
+                                        owner.poolLabels);
+    }
+  }
+
+ private:
+  const OneVsRestSVM& owner;
+  const vector<int>& order;
+  vector<Ptr<SVM> >& trained;
+};
+
+OneVsRestSVM::OneVsRestSVM() {
+  this->gamma = 0.1;
+  this->c = 1.0;
+  this->components = std::make_shared<const Components>();
+}
+
+void OneVsRestSVM::setParams(double gamma, double c) {
+  this->gamma = gamma;
+  this->c = c;
+}
+
+std::shared_ptr<const OneVsRestSVM::Components>
+OneVsRestSVM::snapshot() const {
+  return std::atomic_load(&components);
+}
+
+void OneVsRestSVM::publish(std::shared_ptr<const Components> next) {
+  std::atomic_store(&components, next);
+}
+
+Ptr<SVM> OneVsRestSVM::trainComponent(int label, const Mat& data,
+                                      const Mat& labels) const {
+  // positives are all samples of this identity, negatives are a
+  // bounded random subset of everyone else
+  vector<int> positives, negatives;
+  for (int i = 0 ; i < labels.rows ; i ++) {
+    if (labels.ptr<int>(i)[0] == label) {
+      positives.push_back(i);
+    } else {
+      negatives.push_back(i);
+    }
+  }
+  if (positives.empty()) {
+    return Ptr<SVM>();
+  }
+
+  cv::RNG rng(SAMPLING_SEED + label);
+  if (static_cast<int>(negatives.size()) > MAX_NEGATIVE_SAMPLES) {
+    for (int i = 0 ; i < MAX_NEGATIVE_SAMPLES ; i ++) {
+      std::swap(negatives[i],
+                negatives[rng.uniform(i, static_cast<int>(negatives.size()))]);
+    }
+    negatives.resize(MAX_NEGATIVE_SAMPLES);
+  }
+
+  Mat x(positives.size() + negatives.size(), data.cols, CV_32FC1);
+  Mat y(x.rows, 1, CV_32SC1);
+  for (size_t i = 0 ; i < positives.size() ; i ++) {
+    data.row(positives[i]).copyTo(x.row(i));
+    y.ptr<int>(i)[0] = POSITIVE_LABEL;
+  }
+  for (size_t i = 0 ; i < negatives.size() ; i ++) {
+    data.row(negatives[i]).copyTo(x.row(positives.size() + i));
+    y.ptr<int>(positives.size() + i)[0] = NEGATIVE_LABEL;
+  }
+
+  Ptr<SVM> svm = SVM::create();
+  svm->setType(SVM::C_SVC);
+  svm->setKernel(SVM::RBF);
+  svm->setGamma(gamma);
+  svm->setC(c);
+  if (!negatives.empty()) {
+    // balance the rare positive class, weights follow label order
+    Mat weights(2, 1, CV_64FC1);
+    weights.at<double>(0) = 1.0;
+    weights.at<double>(1) = static_cast<double>(negatives.size()) /
+        positives.size();
+    svm->setClassWeights(weights);
+    svm->train(TrainData::create(x, ROW_SAMPLE, y));
+  } else {
+    // a single identity has nothing to separate from
+    return Ptr<SVM>();
+  }
+  return svm;
+}
+
+void OneVsRestSVM::train(const Mat& data, const Mat& labels) {
+  std::lock_guard<std::mutex> lock(poolMutex);
+  data.copyTo(pool);
+  labels.copyTo(poolLabels);
+
+  set<int> identities;
+  for (int i = 0 ; i < labels.rows ; i ++) {
+    identities.insert(labels.ptr<int>(i)[0]);
+  }
+  vector<int> order(identities.begin(), identities.end());
+  vector<Ptr<SVM> > trained(order.size());
+
+  // components are independent, train them in parallel
+  cv::parallel_for_(cv::Range(0, order.size()),
+                    ComponentTrainer(*this, order, trained));
+
+  std::shared_ptr<Components> next = std::make_shared<Components>();
+  for (size_t i = 0 ; i < order.size() ; i ++) {
+    if (trained[i]) {
+      next->insert(std::make_pair(order[i], trained[i]));
+    }
+  }
+  publish(next);
+}
+
+void OneVsRestSVM::enroll(const Mat& samples, int label) {
+  Ptr<SVM> component;
+  {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (pool.data && samples.cols != pool.cols) {
+#ifdef DEBUG
+      fprintf(stderr, "inconsistant feature length\n");
+#endif
+      return;
+    }
+    for (int i = 0 ; i < samples.rows ; i ++) {
+      pool.push_back(samples.row(i));
+      poolLabels.push_back(label);
+    }
+    component = trainComponent(label, pool, poolLabels);
+  }
+  if (!component) {
+    return;
+  }
+
+  // copy on write: the old map stays valid for in flight predictions
+  std::shared_ptr<Components> next =
+      std::make_shared<Components>(*snapshot());
+  (*next)[label] = component;
+  publish(next);
+}
+
+void OneVsRestSVM::decisionValues(const Mat& sample,
+                                  vector<pair<float, int> >& scores) const {
+  std::shared_ptr<const Components> current = snapshot();
+  scores.clear();
+  for (Components::const_iterator it = current->begin() ;
+       it != current->end() ; it ++) {
+    // opencv returns a positive raw value for the lower label
+    // (NEGATIVE_LABEL), so flip it to score the identity
+    const float raw = it->second->predict(sample, cv::noArray(),
+                                          StatModel::RAW_OUTPUT);
+    scores.push_back(pair<float, int>(-raw, it->first));
+  }
+  std::sort(scores.rbegin(), scores.rend());
+}
+
+int OneVsRestSVM::predict(const Mat& sample, float* score) const {
+  vector<pair<float, int> > scores;
+  decisionValues(sample, scores);
+  if (scores.empty()) {
+    return INT_MAX;
+  }
+  if (score != nullptr) {
+    *score = scores[0].first;
+  }
+  return scores[0].second;
+}
+
+bool OneVsRestSVM::isTrained() const {
+  return !snapshot()->empty();
+}
+
+int OneVsRestSVM::getVarCount() const {
+  std::shared_ptr<const Components> current = snapshot();
+  if (current->empty()) {
+    return 0;
+  }
+  return current->begin()->second->getVarCount();
+}
+
+size_t OneVsRestSVM::size() const {
+  return snapshot()->size();
+}
+
+bool OneVsRestSVM::save(const string path) const {
+  FileStorage fs(path, FileStorage::WRITE);
+  if (!fs.isOpened()) {
+    return false;
+  }
+
+  std::shared_ptr<const Components> current = snapshot();
+  fs << GAMMA_KEY << gamma;
+  fs << C_KEY << c;
+  {
+    // the pool is kept so enrollment still has negatives after reload
+    std::lock_guard<std::mutex> lock(poolMutex);
+    fs << POOL_KEY << pool;
+    fs << POOL_LABELS_KEY << poolLabels;
+  }
+  fs << COMPONENTS_KEY << "[";
+  for (Components::const_iterator it = current->begin() ;
+       it != current->end() ; it ++) {
+    fs << "{";
+    fs << LABEL_KEY << it->first;
+    it->second->write(fs);
+    fs << "}";
+  }
+  fs << "]";
+  return true;
+}
+
+bool OneVsRestSVM::load(const string path) {
+  FileStorage fs(path, FileStorage::READ);
+  if (!fs.isOpened()) {
+    return false;
+  }
+
+  fs[GAMMA_KEY] >> gamma;
+  fs[C_KEY] >> c;
+  {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    fs[POOL_KEY] >> pool;
+    fs[POOL_LABELS_KEY] >> poolLabels;
+  }
+
+  std::shared_ptr<Components> next = std::make_shared<Components>();
+  FileNode list = fs[COMPONENTS_KEY];
+  for (FileNodeIterator it = list.begin() ; it != list.end() ; it ++) {
+    int label = 0;
+    (*it)[LABEL_KEY] >> label;
+    Ptr<SVM> svm = cv::Algorithm::read<SVM>(*it);
+    if (svm && svm->isTrained()) {
+      next->insert(std::make_pair(label, svm));
+    }
+  }
+  publish(next);
+  return isTrained();
+}
+/*----- end of OneVsRestSVM -----*/
+
+} /* classifier */
+
+#undef POSITIVE_LABEL
+#undef NEGATIVE_LABEL
+#undef SAMPLING_SEED
+
+#undef GAMMA_KEY
+#undef C_KEY
+#undef POOL_KEY
+#undef POOL_LABELS_KEY
+#undef COMPONENTS_KEY
+#undef LABEL_KEY
@@ -0,0 +1,63 @@
+#ifndef ONEVSREST_H
+#define ONEVSREST_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/ml.hpp>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+using std::string;
+using std::map;
+using std::vector;
+using std::pair;
+using cv::Mat;
+using cv::Ptr;
+using cv::ml::SVM;
+
+namespace classifier {
+
+// constants
+extern const int MAX_NEGATIVE_SAMPLES;
+
+// one binary rbf svm per identity (identity vs. everyone else)
+// enrolling or updating a person only retrains that person's
+// component, the component map is swapped atomically so predictions
+// running on other threads never see a half trained model
+class OneVsRestSVM {
+ public:
+  OneVsRestSVM();
+  void setParams(double gamma, double c);
+  void train(const Mat& data, const Mat& labels);
+  void enroll(const Mat& samples, int label);
+  int predict(const Mat& sample, float* score = nullptr) const;
+  void decisionValues(const Mat& sample,
+                      vector<pair<float, int> >& scores) const;
+  bool isTrained() const;
+  int getVarCount() const;
+  size_t size() const;
+  bool save(const string path) const;
+  bool load(const string path);
+
+ private:
+  typedef map<int, Ptr<SVM> > Components;
+  class ComponentTrainer;
+
+  Ptr<SVM> trainComponent(int label, const Mat& data,
+                          const Mat& labels) const;
+  std::shared_ptr<const Components> snapshot() const;
+  void publish(std::shared_ptr<const Components> next);
+
+  std::shared_ptr<const Components> components;
+  mutable std::mutex poolMutex;   // guards the enrollment pool
+  Mat pool, poolLabels;           // every enrolled feature row
+  double gamma, c;
+};
+
+} /* classifier */
+
+#endif /* end of include guard: ONEVSREST_H */
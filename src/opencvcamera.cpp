@@ -1,32 +1,79 @@
 #include "opencvcamera.h"
 
 OpenCVCamera::OpenCVCamera() {
-  if (!capture.isOpened()) {
-    capture = VideoCapture(0);
-  }
+  // capture runs on its own thread, the gui only picks up frames
+  grabber.start(0, IMAGE_WIDTH, IMAGE_HEIGHT);
 #ifdef QT_DEBUG
   cout << "init VideoCapture" << endl;
 #endif
-  faceFinder = CascadeClassifier(FACE_FINDER_MODEL);
+  faceFinder.load(FACE_FINDER_MODEL);
 }
 
 OpenCVCamera::~OpenCVCamera() {
 #ifdef QT_DEBUG
   cout << "close VideoCapture" << endl;
 #endif
-  capture.release();
+  grabber.stop();
+}
+
+bool OpenCVCamera::open(FrameSource* source, bool paced) {
+  grabber.stop();
+  // ids and templates of the old source mean nothing here
+  tracker.reset();
+  tracks.clear();
+#ifdef QT_DEBUG
+  if (source) {
+    cout << "open " << source->describe() << endl;
+  }
+#endif
+  return grabber.start(source, paced);
+}
+
+bool OpenCVCamera::open(const string& spec, const string& recordDir,
+                        bool paced) {
+  FrameSource* source = FrameSource::create(spec, IMAGE_WIDTH,
+                                            IMAGE_HEIGHT);
+  if (source == nullptr) {
+    return false;
+  }
+  if (!recordDir.empty()) {
+    source = new RecordingSource(source, recordDir);
+  }
+  return this->open(source, paced);
+}
+
+bool OpenCVCamera::grab() {
+  if (!grabber.latest(frame)) {
+    return false;
+  }
+  // the only conversion every frame needs, detection, tracking and
+  // recognition all work on this gray copy
+  cvtColor(frame, gray, CV_BGR2GRAY);
+  if (tracking) {
+    tracker.update(gray, tracks);
+  } else {
+    vector<Rect> faces;
+    faceFinder.detect(gray, faces);
+    tracks.clear();
+    for (size_t i = 0 ; i < faces.size() ; i ++) {
+      FaceTrack track = {static_cast<int>(i), faces[i], 1, 0};
+      tracks.push_back(track);
+    }
+  }
+  mainStale = true;
+  faceStale = true;
+  return true;
 }
 
 QImage OpenCVCamera::getCurrentFrame() {
-  if (capture.isOpened()) {
-    capture.read(frame);
-    frame.copyTo(main);
-    cvtColor(main, main, CV_BGR2RGB);
+  if (mainStale) {
+    mainStale = false;
+    cvtColor(frame, main, CV_BGR2RGB);
 
     mainImage = QImage((uchar*) main.data,
                    main.cols, main.rows,
                    main.step, QImage::Format_RGB888);
-  } else {
+  } else if (mainImage.isNull()) {
     mainImage = QImage(IMAGE_WIDTH, IMAGE_HEIGHT,
                    QImage::Format_RGB888);
   }
@@ -34,25 +81,60 @@ QImage OpenCVCamera::getCurrentFrame() {
 }
 
 QImage OpenCVCamera::getCurrentFace() {
-  if (frame.data) {
-    vector<Rect> faces;
-    faceFinder.detectMultiScale(frame, faces);
-    if (faces.size() > 0) {
-      frame(faces[0]).copyTo(face);
-      cvtColor(face, face, CV_BGR2RGB);
-
-      faceImage = QImage(face.data,
-                         face.cols, face.rows,
-                         face.step, QImage::Format_RGB888);
-    } else {
-      faceImage = QImage();
-    }
+  if (!faceStale) {
+    // nothing new from the camera, the last result still holds
+    return faceImage;
+  }
+  faceStale = false;
+  if (tracks.size() > 0) {
+    // converting the roi copies it out of the frame
+    cvtColor(frame(tracks[0].box), face, CV_BGR2RGB);
+
+    faceImage = QImage(face.data,
+                       face.cols, face.rows,
+                       face.step, QImage::Format_RGB888);
   } else {
     faceImage = QImage();
   }
   return faceImage;
 }
 
-void OpenCVCamera::getCurrentFaceMat(Mat& face) {
-  cvtColor(this->face, face, CV_RGB2BGR);
+bool OpenCVCamera::getCurrentFaceMat(Mat& face) {
+  if (!frame.data || tracks.empty()) {
+    return false;
+  }
+  frame(tracks[0].box).copyTo(face);
+  return true;
+}
+
+uint64_t OpenCVCamera::getDroppedFrames() const {
+  return grabber.getDroppedFrames();
+}
+
+double OpenCVCamera::getLatency() const {
+  return grabber.getMeanLatency();
+}
+
+void OpenCVCamera::setDetectionParams(const DetectionParams& params) {
+  faceFinder.setParams(params);
+}
+
+void OpenCVCamera::setTracking(bool enable) {
+  tracking = enable;
+  tracker.reset();
+}
+
+const vector<FaceTrack>& OpenCVCamera::getTracks() const {
+  return tracks;
+}
+
+const vector<Mat>& OpenCVCamera::getFaceSamples(cv::Size size) {
+  samples.resize(tracks.size());
+  for (size_t i = 0 ; i < tracks.size() ; i ++) {
+    // same size every frame, so resize writes into the old buffer.
+    // linear like the training loader, the features depend on it
+    cv::resize(gray(tracks[i].box), samples[i], size, 0, 0,
+               cv::INTER_LINEAR);
+  }
+  return samples;
 }
@@ -9,15 +9,13 @@
 #include <opencv2/highgui.hpp>
 #include <opencv2/objdetect.hpp>
 
+#include "facedetector.h"
+#include "facetracker.h"
+#include "framegrabber.h"
+
 #define DEFAULT_WIDTH 640
 #define DEFAULT_HEIGHT 480
 
-#if defined(__unix__)
-#define OBJECT_DETECT_MODEL "/usr/local/share/OpenCV/haarcascades/haarcascade_frontalface_alt2.xml"
-#elif defined(__WIN32)
-#define OBJECT_DETECT_MODEL "./haarcascade_frontalface_alt2.xml"
-#endif
-
 #ifdef QT_DEBUG
 #include <iostream>
 using std::cout;
@@ -25,32 +23,55 @@ using std::endl;
 #endif
 
 using std::vector;
-using cv::VideoCapture;
 using cv::Mat;
 using cv::Rect;
 using cv::cvtColor;
-using cv::CascadeClassifier;
 
 class OpenCVCamera {
  public:
   OpenCVCamera();
   ~OpenCVCamera();
+  // switches to another source, e.g. a video or a recording.
+  // takes ownership, false if it cannot be opened
+  bool open(FrameSource* source, bool paced = true);
+  // a FrameSource::create() spec, recorded into recordDir unless empty
+  bool open(const string& spec, const string& recordDir,
+            bool paced = true);
+  // picks up the newest frame and finds the faces in it, false while
+  // the camera has nothing new. everything below reads this frame.
+  bool grab();
+  // display copies, only converted when asked for
   QImage getCurrentFrame();
   QImage getCurrentFace();
-  void getCurrentFaceMat(Mat& face);
+  // BGR crop of the main face, false when there is none
+  bool getCurrentFaceMat(Mat& face);
+  uint64_t getDroppedFrames() const;
+  double getLatency() const;
+  void setDetectionParams(const DetectionParams& params);
+  // follow faces between detections, off runs the detector every frame
+  void setTracking(bool enable);
+  const vector<FaceTrack>& getTracks() const;
+  // gray crops of every track resized to size, in the order of
+  // getTracks(). the buffers are reused and overwritten by the next call
+  const vector<Mat>& getFaceSamples(cv::Size size);
 
  private:
-  VideoCapture capture;
-  CascadeClassifier faceFinder;
-  Mat frame, main, face;
+  FrameGrabber grabber;
+  FaceDetector faceFinder;
+  FaceTracker tracker{&faceFinder};
+  bool tracking = true;
+  vector<FaceTrack> tracks;
+  bool mainStale = false;   // display images lag behind the frame
+  bool faceStale = false;
+  Mat frame, gray, main, face;
+  vector<Mat> samples;
   QImage mainImage, faceImage;
   const int IMAGE_WIDTH = DEFAULT_WIDTH;
   const int IMAGE_HEIGHT = DEFAULT_HEIGHT;
-  const char* FACE_FINDER_MODEL = OBJECT_DETECT_MODEL;
+  const char* FACE_FINDER_MODEL = DEFAULT_DETECTION_MODEL;
 };
 
 #undef DEFAULT_WIDTH
 #undef DEFAULT_HEIGHT
-#undef OBJECT_DETECT_MODEL
 
 #endif // OPENCVCAMERA_H
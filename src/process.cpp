@@ -9,6 +9,7 @@ using cv::getRotationMatrix2D;
 using cv::saturate_cast;
 using cv::max;
 using cv::cvtColor;
+using cv::integral;
 
 namespace process {
   void changeBrightness(Mat& image, double alpha) {
@@ -89,7 +90,7 @@ namespace process {
     } else if (image.channels() == 4) {
       cvtColor(image, gray, CV_BGRA2GRAY);
     } else if (image.channels() == 1) {
-      image.copyTo(gray);
+      gray = image;
     } else {
 #ifdef DEBUG
       cout << "ERROR: image null" << endl;
@@ -135,7 +136,7 @@ namespace process {
     } else if (image.channels() == 4) {
       cvtColor(image, gray, CV_BGRA2GRAY);
     } else if (image.channels() == 1) {
-      image.copyTo(gray);
+      gray = image;
     } else {
 #ifdef DEBUG
       cout << "ERROR: image null" << endl;
@@ -227,7 +228,7 @@ namespace process {
     } else if (image.channels() == 4) {
       cvtColor(image, gray, CV_BGRA2GRAY);
     } else if (image.channels() == 1) {
-      image.copyTo(gray);
+      gray = image;
     } else {
 #ifdef DEBUG
       cout << "ERROR: image null" << endl;
@@ -293,8 +294,43 @@ namespace process {
     return value;
   }
 
-  void computeHaar(Mat& image, Mat& haar,
-                  unsigned int& featureLength) {
+  // sum of a box from an integral image
+  static inline int boxSum(const Mat& sums, int x, int y, int w, int h) {
+    return sums.ptr<int>(y + h)[x + w] - sums.ptr<int>(y)[x + w] -
+        sums.ptr<int>(y + h)[x] + sums.ptr<int>(y)[x];
+  }
+
+  // 5 bit haar code of the 4x4 box at (x, y)
+  static inline float haarCode(const Mat& sums, int x, int y) {
+    float code = 0;
+    // edge feature 1
+    if (boxSum(sums, x, y, 2, 4) > boxSum(sums, x + 2, y, 2, 4)) {
+      code += 1;
+    }
+    // edge feature 2
+    if (boxSum(sums, x, y, 4, 2) > boxSum(sums, x, y + 2, 4, 2)) {
+      code += 2;
+    }
+    // line feature 1
+    if (boxSum(sums, x, y, 1, 4) + boxSum(sums, x + 3, y, 1, 4) >
+        boxSum(sums, x + 1, y, 2, 4)) {
+      code += 4;
+    }
+    // line feature 2
+    if (boxSum(sums, x, y, 4, 1) + boxSum(sums, x, y + 3, 4, 1) >
+        boxSum(sums, x, y + 1, 4, 2)) {
+      code += 8;
+    }
+    // rect feature
+    if (boxSum(sums, x, y, 2, 2) + boxSum(sums, x + 2, y + 2, 2, 2) >
+        boxSum(sums, x + 2, y, 2, 2) + boxSum(sums, x, y + 2, 2, 2)) {
+      code += 16;
+    }
+    return code;
+  }
+
+  // gray integral image and the haar grid size
+  static bool haarIntegral(Mat& image, Mat& sums, int& xBound, int& yBound) {
     Mat gray;
 
     if (image.channels() == 3) {
@@ -302,74 +338,64 @@ namespace process {
     } else if (image.channels() == 4) {
       cvtColor(image, gray, CV_BGRA2GRAY);
     } else if (image.channels() == 1) {
-      image.copyTo(gray);
+      gray = image;
     } else {
 #ifdef DEBUG
       cout << "ERROR: image null" << endl;
 #endif
-      return;
+      return false;
     }
 
-    const unsigned int boxSize = 4;
-    const int xBound = gray.cols - boxSize;
-    const int yBound = gray.rows - boxSize;
+    xBound = gray.cols - static_cast<int>(HAAR_BOX_SIZE);
+    yBound = gray.rows - static_cast<int>(HAAR_BOX_SIZE);
     if (xBound <= 0 || yBound <= 0) {
 #ifdef DEBUG
       cout << "ERROR: image too small" << endl;
 #endif
+      return false;
+    }
+
+    // every box sum is four lookups instead of a pass over the box
+    integral(gray, sums, CV_32S);
+    return true;
+  }
+
+  void computeHaar(Mat& image, Mat& haar,
+                  unsigned int& featureLength) {
+    Mat sums;
+    int xBound = 0, yBound = 0;
+    if (!haarIntegral(image, sums, xBound, yBound)) {
       return;
     }
 
     featureLength = xBound * yBound;
     haar = Mat::zeros(1, featureLength, CV_32FC1);
-
+    float* codes = haar.ptr<float>(0);
     for (int y = 0 ; y < yBound ; y ++) {
       for (int x = 0 ; x < xBound ; x ++) {
-        const int index = y * xBound + x;
-        Rect roi(x, y, boxSize, boxSize);
-        Mat computeRegion = gray(roi).clone();
-        Mat region1, region2, region3, region4;
-
-        // edge feature 1
-        region1 = computeRegion(Rect(0, 0, 2, 4));
-        region2 = computeRegion(Rect(2, 0, 2, 4));
-        if (sum(region1) > sum(region2)) {
-          haar.ptr<float>()[index] += 1;
-        }
-
-        // edge feature 2
-        region1 = computeRegion(Rect(0, 0, 4, 2));
-        region2 = computeRegion(Rect(0, 2, 4, 2));
-        if (sum(region1) > sum(region2)) {
-          haar.ptr<float>()[index] += 2;
-        }
-
-        // line feature 1
-        region1 = computeRegion(Rect(0, 0, 1, 4));
-        region2 = computeRegion(Rect(1, 0, 2, 4));
-        region3 = computeRegion(Rect(3, 0, 1, 4));
-        if (sum(region1) + sum(region3) > sum(region2)) {
-          haar.ptr<float>()[index] += 4;
-        }
+        codes[y * xBound + x] = haarCode(sums, x, y);
+      }
+    }
+  }
 
-        // line feature 2
-        region1 = computeRegion(Rect(0, 0, 4, 1));
-        region2 = computeRegion(Rect(0, 1, 4, 2));
-        region3 = computeRegion(Rect(0, 3, 4, 1));
-        if (sum(region1) + sum(region3) > sum(region2)) {
-          haar.ptr<float>()[index] += 8;
-        }
+  void computeHaar(Mat& image, Mat& haar,
+                   const std::vector<int>& positions) {
+    Mat sums;
+    int xBound = 0, yBound = 0;
+    if (!haarIntegral(image, sums, xBound, yBound)) {
+      return;
+    }
 
-        // rect feature
-        region1 = computeRegion(Rect(0, 0, 2, 2));
-        region2 = computeRegion(Rect(2, 0, 2, 2));
-        region3 = computeRegion(Rect(0, 2, 2, 2));
-        region4 = computeRegion(Rect(2, 2, 2, 2));
-        if (sum(region1) + sum(region4) >
-            sum(region2) + sum(region3)) {
-          haar.ptr<float>()[index] += 16;
-        }
+    // only the selected positions, cost grows with their count
+    haar = Mat::zeros(1, positions.size(), CV_32FC1);
+    float* codes = haar.ptr<float>(0);
+    for (size_t i = 0 ; i < positions.size() ; i ++) {
+      if (positions[i] < 0 || positions[i] >= xBound * yBound) {
+        haar.release();
+        return;
       }
+      codes[i] = haarCode(sums, positions[i] % xBound,
+                          positions[i] / xBound);
     }
   }
 
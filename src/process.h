@@ -4,6 +4,8 @@
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 
+#include <vector>
+
 #ifdef DEBUG
 #include <iostream>
 using std::cout;
@@ -16,6 +18,8 @@ namespace process {
   const unsigned int LBP_FEATURE_LENGTH = 256;
   const unsigned int LTP_FEATURE_LENGTH = 9841;
   const unsigned int CSLTP_FEATURE_LENGTH = 121;
+  const unsigned int HAAR_BOX_SIZE = 4;
+  const unsigned int HAAR_CODE_COUNT = 32;
   void changeBrightness(Mat& image, double alpha);
   void changeBrightness(Mat& image, double alpha, double beta);
   void rotateImage(Mat& image, const double deg);
@@ -24,6 +28,9 @@ namespace process {
   void computeCSLTP(Mat& image, Mat& csltp, int threshold);
   void computeHaar(Mat& image, Mat& haar,
                    unsigned int& featureLength);
+  // haar codes at the given positions (y * (cols - 4) + x) only
+  void computeHaar(Mat& image, Mat& haar,
+                   const std::vector<int>& positions);
 }
 
 #endif /* end of include guard: PROCESS_H */
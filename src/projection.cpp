@@ -0,0 +1,139 @@
+#include "projection.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <set>
+
+using cv::PCA;
+using cv::LDA;
+using cv::gemm;
+
+namespace classifier {
+// constants
+const int DEFAULT_PROJECTION_COMPONENTS = 100;
+
+/****** Projection ******/
+Projection::Projection() : type(NO_PROJECTION) {}
+
+bool Projection::fit(const Mat& data, const Mat& labels,
+                     ProjectionType type, int components) {
+  this->clear();
+  if (type == NO_PROJECTION || data.rows < 2 ||
+      data.type() != CV_32FC1 || labels.rows != data.rows) {
+    return false;
+  }
+
+  std::set<int> classes;
+  for (int i = 0 ; i < labels.rows ; i ++) {
+    classes.insert(labels.ptr<int>(i)[0]);
+  }
+  const int classCount = static_cast<int>(classes.size());
+  const int maxComponents = std::min(data.rows - 1, data.cols);
+  if (type != PCA_PROJECTION &&
+      (classCount < 2 || data.rows - classCount < 1)) {
+#ifdef DEBUG
+    fprintf(stderr, "not enough classes for lda, using pca only\n");
+#endif
+    type = PCA_PROJECTION;
+  }
+
+  // fisherfaces keep n - c components, pca + lda the requested size.
+  // any lda needs at most n - c so the within class scatter is not
+  // singular, small enrollments hit that before the requested size
+  int pcaComponents = type == LDA_PROJECTION ?
+      data.rows - classCount : components;
+  if (type != PCA_PROJECTION) {
+    pcaComponents = std::min(pcaComponents, data.rows - classCount);
+  }
+  pcaComponents = std::max(1, std::min(pcaComponents, maxComponents));
+
+  PCA pca(data, Mat(), PCA::DATA_AS_ROW, pcaComponents);
+  pca.mean.convertTo(this->mean, CV_32FC1);
+  Mat eigenvectors;
+  pca.eigenvectors.convertTo(eigenvectors, CV_32FC1);
+  this->basis = eigenvectors.t();
+  this->offset = this->mean * this->basis;
+  this->type = type;
+
+  if (type != PCA_PROJECTION) {
+    // lda runs in the pca space, the two bases fold into one
+    Mat reduced;
+    this->apply(data, reduced);
+    LDA lda(std::min(classCount - 1, this->basis.cols));
+    lda.compute(reduced, labels);
+    Mat discriminants;
+    lda.eigenvectors().convertTo(discriminants, CV_32FC1);
+    this->basis = this->basis * discriminants;
+    this->offset = this->mean * this->basis;
+  }
+  return true;
+}
+
+bool Projection::attach(ProjectionType type, const Mat& mean,
+                        const Mat& basis) {
+  this->clear();
+  if (type == NO_PROJECTION || mean.type() != CV_32FC1 ||
+      basis.type() != CV_32FC1 || mean.rows != 1 ||
+      mean.cols != basis.rows || basis.cols == 0) {
+    return false;
+  }
+  this->type = type;
+  this->mean = mean;
+  this->basis = basis;
+  this->offset = mean * basis;
+  return true;
+}
+
+void Projection::clear() {
+  type = NO_PROJECTION;
+  mean.release();
+  basis.release();
+  offset.release();
+}
+
+void Projection::apply(const Mat& samples, Mat& projected) const {
+  if (!isEnabled()) {
+    projected = samples;
+    return;
+  }
+  if (samples.rows == 1) {
+    // x * W - mean * W, one gemm
+    gemm(samples, basis, 1, offset, -1, projected);
+    return;
+  }
+  gemm(samples, basis, 1, Mat(), 0, projected);
+  const float* shift = offset.ptr<float>(0);
+  for (int i = 0 ; i < projected.rows ; i ++) {
+    float* row = projected.ptr<float>(i);
+    for (int j = 0 ; j < projected.cols ; j ++) {
+      row[j] -= shift[j];
+    }
+  }
+}
+
+bool Projection::isEnabled() const {
+  return type != NO_PROJECTION && !basis.empty();
+}
+
+ProjectionType Projection::getType() const {
+  return type;
+}
+
+int Projection::getInputLength() const {
+  return basis.rows;
+}
+
+int Projection::getOutputLength() const {
+  return basis.cols;
+}
+
+const Mat& Projection::getMean() const {
+  return mean;
+}
+
+const Mat& Projection::getBasis() const {
+  return basis;
+}
+/*----- end of Projection -----*/
+
+} /* classifier */
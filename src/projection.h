@@ -0,0 +1,50 @@
+#ifndef PROJECTION_H
+#define PROJECTION_H
+
+#include <opencv2/core.hpp>
+
+using cv::Mat;
+
+namespace classifier {
+
+// constants
+extern const int DEFAULT_PROJECTION_COMPONENTS;
+
+typedef enum {
+  NO_PROJECTION = 0,
+  PCA_PROJECTION,      // principal components only
+  LDA_PROJECTION,      // fisherfaces, pca to n - c then lda
+  PCA_LDA_PROJECTION   // pca to the requested size then lda
+} ProjectionType;
+
+// linear dimensionality reduction fitted on the training rows
+// y = (x - mean) * basis, evaluated with a single gemm.
+// pca and lda are folded into one basis, so applying the
+// combined projection costs the same as applying one of them.
+class Projection {
+ public:
+  Projection();
+  bool fit(const Mat& data, const Mat& labels,
+           ProjectionType type, int components);
+  // adopts mean (1 x input) and basis (input x output) without copy
+  bool attach(ProjectionType type, const Mat& mean, const Mat& basis);
+  void clear();
+  void apply(const Mat& samples, Mat& projected) const;
+
+  bool isEnabled() const;
+  ProjectionType getType() const;
+  int getInputLength() const;
+  int getOutputLength() const;
+  const Mat& getMean() const;
+  const Mat& getBasis() const;
+
+ private:
+  ProjectionType type;
+  Mat mean;      // 1 x input, CV_32FC1
+  Mat basis;     // input x output, CV_32FC1
+  Mat offset;    // mean * basis, subtracted after the product
+};
+
+} /* classifier */
+
+#endif /* end of include guard: PROJECTION_H */
@@ -0,0 +1,253 @@
+#include "recognitionworker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+// a prediction holds while the box moves less than this part of its
+// size, and for at most this many recognized frames
+#define CACHE_TOLERANCE 0.1
+#define CACHE_FRAMES 10
+
+/****** RecognitionWorker ******/
+RecognitionWorker::RecognitionWorker(const ModelHandle* model)
+    : model(model), running(true) {}
+
+RecognitionWorker::~RecognitionWorker() {
+  this->stop();
+}
+
+void RecognitionWorker::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+  }
+  pending.notify_all();
+  this->wait();
+}
+
+void RecognitionWorker::setRate(double rate) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (rate > 0) {
+    this->rate = rate;
+  }
+}
+
+void RecognitionWorker::setWindow(int size, VotingMode mode) {
+  std::lock_guard<std::mutex> lock(mutex);
+  this->windowSize = size > 0 ? size : 1;
+  this->mode = mode;
+}
+
+void RecognitionWorker::setFacesPerFrame(int faces) {
+  std::lock_guard<std::mutex> lock(mutex);
+  this->facesPerFrame = faces > 0 ? faces : 1;
+}
+
+void RecognitionWorker::submit(const vector<FaceTrack>& tracks,
+                               const vector<Mat>& faces) {
+  if (tracks.size() != faces.size()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    // an unprocessed older frame is simply replaced, the copies go
+    // into buffers of an earlier frame and need no allocation
+    frameTracks = tracks;
+    frameFaces.resize(faces.size());
+    for (size_t i = 0 ; i < faces.size() ; i ++) {
+      faces[i].copyTo(frameFaces[i]);
+    }
+    hasFrame = true;
+  }
+  pending.notify_one();
+}
+
+void RecognitionWorker::run() {
+  while (true) {
+    double period = 0;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      pending.wait(lock, [this]() { return hasFrame || !running; });
+      if (!running) {
+        break;
+      }
+      // take the frame, submit refills the buffers we hand back
+      busyTracks.swap(frameTracks);
+      busyFaces.swap(frameFaces);
+      hasFrame = false;
+      period = 1000.0 / rate;
+    }
+    const auto begin = std::chrono::steady_clock::now();
+
+    std::shared_ptr<FaceClassifier> current = model->get();
+    if (current != faceClassifier) {
+      // votes and cached results belong to the previous model
+      faceClassifier = current;
+      states.clear();
+    }
+    frames ++;
+    this->recognize(busyTracks, busyFaces);
+
+    // at most rate frames per second, stop still wakes us up
+    const double spent = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - begin).count();
+    if (spent < period) {
+      std::unique_lock<std::mutex> lock(mutex);
+      pending.wait_for(lock,
+                       std::chrono::duration<double, std::milli>(
+                           period - spent),
+                       [this]() { return !running; });
+    }
+  }
+}
+
+void RecognitionWorker::recognize(const vector<FaceTrack>& tracks,
+                                  vector<Mat>& faces) {
+  vector<int> trackIds;
+  for (size_t i = 0 ; i < tracks.size() ; i ++) {
+    trackIds.push_back(tracks[i].id);
+  }
+  // tracks that left the frame are done
+  for (auto it = states.begin() ; it != states.end() ; ) {
+    if (std::find(trackIds.begin(), trackIds.end(), it->first) ==
+        trackIds.end()) {
+      it = states.erase(it);
+    } else {
+      it ++;
+    }
+  }
+  if (!faceClassifier || !faceClassifier->isLoaded()) {
+    return;
+  }
+
+  // faces whose last prediction no longer holds
+  vector<int> candidates;
+  for (size_t i = 0 ; i < faces.size() ; i ++) {
+    if (faces[i].data && !isCached(states[trackIds[i]], tracks[i])) {
+      candidates.push_back(static_cast<int>(i));
+    }
+  }
+
+  // unidentified tracks first, then the longest waiting ones
+  std::sort(candidates.begin(), candidates.end(),
+            [this, &trackIds](int a, int b) {
+              const TrackState& sa = states[trackIds[a]];
+              const TrackState& sb = states[trackIds[b]];
+              const bool knownA = sa.published != INT_MAX;
+              const bool knownB = sb.published != INT_MAX;
+              if (knownA != knownB) {
+                return !knownA;
+              }
+              return sa.lastFrame < sb.lastFrame;
+            });
+  int budget = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    budget = facesPerFrame;
+  }
+  if (static_cast<int>(candidates.size()) > budget) {
+    candidates.resize(budget);
+  }
+  if (candidates.empty()) {
+    return;
+  }
+
+  vector<Mat> batch;
+  for (size_t i = 0 ; i < candidates.size() ; i ++) {
+    batch.push_back(faces[candidates[i]]);
+  }
+  vector<vector<RecognitionResult> > results;
+  vector<int> labels;
+  faceClassifier->recognize(batch, 1, results, labels);
+
+  for (size_t i = 0 ; i < candidates.size() ; i ++) {
+    if (labels[i] == INT_MAX || results[i].empty()) {
+      continue;
+    }
+    const int trackId = trackIds[candidates[i]];
+    TrackState& state = states[trackId];
+    state.box = tracks[candidates[i]].box;
+    state.cached = true;
+    state.lastFrame = frames;
+    RecognitionResult result = results[i][0];
+    if (labels[i] == classifier::UNKNOWN_LABEL) {
+      result.label = labels[i];
+      result.name.clear();
+    }
+    this->vote(trackId, state, result);
+  }
+}
+
+bool RecognitionWorker::isCached(const TrackState& state,
+                                 const FaceTrack& track) const {
+  // score 1 is a fresh detection, the box may now hold someone else
+  if (!state.cached || track.score >= 1 ||
+      frames - state.lastFrame >= CACHE_FRAMES) {
+    return false;
+  }
+  const Rect& a = state.box;
+  const Rect& b = track.box;
+  const double tolerance = CACHE_TOLERANCE * std::max(a.width, a.height);
+  return std::abs(a.x - b.x) <= tolerance &&
+      std::abs(a.y - b.y) <= tolerance &&
+      std::abs(a.width - b.width) <= tolerance &&
+      std::abs(a.height - b.height) <= tolerance;
+}
+
+void RecognitionWorker::vote(int trackId, TrackState& state,
+                             const RecognitionResult& result) {
+  int size = 0;
+  VotingMode votingMode = MAJORITY_VOTE;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    size = windowSize;
+    votingMode = mode;
+  }
+
+  std::deque<Vote>& window = state.window;
+  Vote v = {result.label, result.confidence, result.name};
+  window.push_back(v);
+  while (static_cast<int>(window.size()) > size) {
+    window.pop_front();
+  }
+
+  // label -> (votes, summed confidence)
+  std::map<int, std::pair<int, double> > tally;
+  for (size_t i = 0 ; i < window.size() ; i ++) {
+    tally[window[i].label].first ++;
+    tally[window[i].label].second += window[i].confidence;
+  }
+  std::map<int, std::pair<int, double> >::const_iterator best =
+      tally.begin();
+  for (auto it = tally.begin() ; it != tally.end() ; it ++) {
+    const bool better = votingMode == MAJORITY_VOTE ?
+        it->second.first > best->second.first :
+        it->second.second > best->second.second;
+    if (better) {
+      best = it;
+    }
+  }
+
+  // the winner has to hold more than half of a full window
+  const bool stable = votingMode == MAJORITY_VOTE ?
+      best->second.first * 2 > size :
+      best->second.second * 2 > size;
+  if (!stable || best->first == state.published) {
+    return;
+  }
+  state.published = best->first;
+
+  std::string name;
+  for (size_t i = 0 ; i < window.size() ; i ++) {
+    if (window[i].label == best->first) {
+      name = window[i].name;
+    }
+  }
+  identified(trackId, best->first, QString(name.c_str()),
+             static_cast<float>(best->second.second / best->second.first));
+}
+/*----- end of RecognitionWorker -----*/
+
+#undef CACHE_TOLERANCE
+#undef CACHE_FRAMES
@@ -0,0 +1,106 @@
+#ifndef RECOGNITIONWORKER_H
+#define RECOGNITIONWORKER_H
+
+#include <QThread>
+#include <QString>
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "classifier.h"
+#include "facetracker.h"
+#include "modelhandle.h"
+
+#define DEFAULT_RECOGNITION_RATE 5
+#define DEFAULT_VOTE_WINDOW 7
+#define DEFAULT_FACES_PER_FRAME 4
+
+using classifier::FaceClassifier;
+using classifier::RecognitionResult;
+using cv::Mat;
+
+// recognizes the tracked faces continuously off the gui thread.
+// the gui hands in the newest crops of a frame, an older frame not
+// processed yet is replaced, and the worker predicts at most rate
+// frames per second. all faces of a frame are recognized as one batch,
+// at most facesPerFrame of them: new and not yet identified tracks
+// first, then the ones waiting longest. predictions of a track are
+// aggregated over a sliding window and an identity is only published
+// once it wins the window, so a single bad frame does not flip the
+// result. a track keeps its last prediction while its box stays put,
+// it is predicted again once the box moves, the tracker redetects it
+// or the prediction gets too old.
+class RecognitionWorker : public QThread {
+  Q_OBJECT
+ public:
+  enum VotingMode {
+    MAJORITY_VOTE,    // most frequent label in the window
+    SCORE_AVERAGE     // highest mean confidence in the window
+  };
+
+  explicit RecognitionWorker(const ModelHandle* model);
+  virtual ~RecognitionWorker();
+  virtual void run();
+  void stop();
+  void setRate(double rate);
+  void setWindow(int size, VotingMode mode);
+  void setFacesPerFrame(int faces);
+  // newest crops of a frame with their tracks, any crop the
+  // classifier accepts. gray at its image size skips all conversions
+  void submit(const vector<FaceTrack>& tracks, const vector<Mat>& faces);
+
+ signals:
+  void identified(int trackId, int label, QString name, float confidence);
+  void sendMessage(QString message);
+
+ private:
+  typedef struct Vote {
+    int label;
+    float confidence;
+    std::string name;
+  } Vote;
+
+  typedef struct TrackState {
+    cv::Rect box;               // where the last prediction was made
+    bool cached = false;
+    uint64_t lastFrame = 0;     // frame of the last prediction
+    std::deque<Vote> window;
+    int published = INT_MAX;    // label last published
+  } TrackState;
+
+  bool isCached(const TrackState& state, const FaceTrack& track) const;
+  void recognize(const vector<FaceTrack>& tracks, vector<Mat>& faces);
+  void vote(int trackId, TrackState& state,
+            const RecognitionResult& result);
+
+  const ModelHandle* model;   // not owned
+  std::mutex mutex;
+  std::condition_variable pending;
+  bool running;
+  bool hasFrame = false;
+  vector<FaceTrack> frameTracks;  // newest frame, guarded by mutex
+  vector<Mat> frameFaces;     // buffers swap with busyFaces
+  double rate = DEFAULT_RECOGNITION_RATE;
+  int windowSize = DEFAULT_VOTE_WINDOW;
+  VotingMode mode = MAJORITY_VOTE;
+  int facesPerFrame = DEFAULT_FACES_PER_FRAME;
+
+  // worker thread only
+  std::shared_ptr<FaceClassifier> faceClassifier;
+  std::map<int, TrackState> states;
+  vector<FaceTrack> busyTracks;
+  vector<Mat> busyFaces;
+  uint64_t frames = 0;
+};
+
+#undef DEFAULT_RECOGNITION_RATE
+#undef DEFAULT_VOTE_WINDOW
+#undef DEFAULT_FACES_PER_FRAME
+
+#endif /* end of include guard: RECOGNITIONWORKER_H */
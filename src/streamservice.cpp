@@ -0,0 +1,324 @@
+#include "streamservice.h"
+
+#include <algorithm>
+#include <chrono>
+#include <opencv2/imgproc.hpp>
+
+// detect workers nap this long when none of their streams has a frame
+#define POLL_INTERVAL_MS 2
+// weight of the newest frame in the smoothed statistics
+#define STATS_SMOOTHING 0.1
+
+// constants
+const int DEFAULT_DETECT_THREADS = 2;
+const int DEFAULT_RECOGNIZE_THREADS = 1;
+const int DEFAULT_SERVICE_BATCH = 32;
+
+static double elapsedMs(int64_t from, int64_t to) {
+  return (to - from) * 1000.0 / cv::getTickFrequency();
+}
+
+static void smooth(double& mean, double value) {
+  mean = mean == 0 ? value :
+      (1 - STATS_SMOOTHING) * mean + STATS_SMOOTHING * value;
+}
+
+/****** StreamService ******/
+StreamService::StreamService(const ModelHandle* model,
+                             const ServiceParams& params)
+    : model(model), params(params), running(false) {
+  this->params.detectThreads = std::max(1, params.detectThreads);
+  this->params.recognizeThreads = std::max(1, params.recognizeThreads);
+  this->params.maxBatch = std::max(1, params.maxBatch);
+}
+
+StreamService::~StreamService() {
+  this->stop();
+}
+
+int StreamService::addStream(FrameSource* source) {
+  if (running || source == nullptr) {
+    delete source;
+    return -1;
+  }
+  std::unique_ptr<Stream> stream(new Stream());
+  stream->id = static_cast<int>(streams.size());
+  stream->name = source->describe();
+  if (!stream->detector.load(params.detectorModel)) {
+    sendMessage("cannot load face detection model " + params.detectorModel);
+    delete source;
+    return -1;
+  }
+  stream->detector.setParams(params.detection);
+  stream->tracker.reset(new FaceTracker(&stream->detector));
+  // frames flow right away, until start() only the newest is kept
+  stream->grabber.reset(new FrameGrabber());
+  if (!stream->grabber->start(source, params.paced)) {
+    sendMessage("cannot open " + stream->name);
+    return -1;
+  }
+  sendMessage("stream " + toString(stream->id) + ": " + stream->name);
+  streams.push_back(std::move(stream));
+  return streams.back()->id;
+}
+
+void StreamService::setResultCallback(const ResultCallback& callback) {
+  this->callback = callback;
+}
+
+bool StreamService::start() {
+  if (running || streams.empty()) {
+    return false;
+  }
+  running = true;
+  // no more workers than streams, an idle one would only poll
+  const int workers = std::min(params.detectThreads,
+                               static_cast<int>(streams.size()));
+  for (int i = 0 ; i < workers ; i ++) {
+    detectors.emplace_back(&StreamService::detectLoop, this, i, workers);
+  }
+  for (int i = 0 ; i < params.recognizeThreads ; i ++) {
+    recognizers.emplace_back(&StreamService::recognizeLoop, this);
+  }
+  sendMessage(toString(streams.size()) + " streams on " +
+              toString(workers) + " detect and " +
+              toString(params.recognizeThreads) + " recognition threads");
+  return true;
+}
+
+void StreamService::stop() {
+  {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    running = false;
+  }
+  queued.notify_all();
+  for (size_t i = 0 ; i < detectors.size() ; i ++) {
+    detectors[i].join();
+  }
+  for (size_t i = 0 ; i < recognizers.size() ; i ++) {
+    recognizers[i].join();
+  }
+  detectors.clear();
+  recognizers.clear();
+  for (size_t i = 0 ; i < streams.size() ; i ++) {
+    streams[i]->grabber->stop();
+  }
+}
+
+bool StreamService::isFinished() {
+  for (size_t i = 0 ; i < streams.size() ; i ++) {
+    if (!streams[i]->drained) {
+      return false;
+    }
+  }
+  std::lock_guard<std::mutex> lock(queueMutex);
+  return order.empty() && busy == 0;
+}
+
+void StreamService::getStats(vector<StreamStats>& stats) {
+  stats.clear();
+  for (size_t i = 0 ; i < streams.size() ; i ++) {
+    Stream& stream = *streams[i];
+    StreamStats s;
+    s.stream = stream.id;
+    s.source = stream.name;
+    s.captured = stream.grabber->getCapturedFrames();
+    s.dropped = stream.grabber->getDroppedFrames();
+    s.finished = stream.grabber->isFinished();
+    std::lock_guard<std::mutex> lock(stream.statsMutex);
+    s.processed = stream.frames;
+    s.recognized = stream.recognized;
+    s.skipped = stream.skipped;
+    s.fps = stream.interval > 0 ? 1000.0 / stream.interval : 0;
+    s.detectMs = stream.detectMs;
+    s.latencyMs = stream.latencyMs;
+    stats.push_back(s);
+  }
+}
+
+void StreamService::detectLoop(int worker, int workers) {
+  while (running) {
+    bool any = false;
+    for (size_t i = worker ; i < streams.size() ; i += workers) {
+      any = this->process(*streams[i]) || any;
+    }
+    if (!any) {
+      std::this_thread::sleep_for(
+          std::chrono::milliseconds(POLL_INTERVAL_MS));
+    }
+  }
+}
+
+bool StreamService::process(Stream& stream) {
+  // finished before an empty latest() means the last frame is taken
+  const bool finished = stream.grabber->isFinished();
+  if (!stream.grabber->latest(stream.frame)) {
+    if (finished) {
+      stream.drained = true;
+    }
+    return false;
+  }
+  const int64_t begin = cv::getTickCount();
+  const int64_t captureTick = begin - static_cast<int64_t>(
+      stream.grabber->getLatency() * cv::getTickFrequency() / 1000.0);
+
+  if (stream.frame.channels() == 3) {
+    cv::cvtColor(stream.frame, stream.gray, CV_BGR2GRAY);
+  } else {
+    stream.gray = stream.frame;
+  }
+  if (params.tracking) {
+    stream.tracker->update(stream.gray, stream.tracks);
+  } else {
+    vector<Rect> faces;
+    stream.detector.detect(stream.gray, faces);
+    stream.tracks.clear();
+    for (size_t i = 0 ; i < faces.size() ; i ++) {
+      FaceTrack track = {static_cast<int>(i), faces[i], 1, 0};
+      stream.tracks.push_back(track);
+    }
+  }
+
+  PendingFrame frame;
+  frame.stream = stream.id;
+  frame.frame = stream.frames;
+  frame.captureTick = captureTick;
+  std::shared_ptr<FaceClassifier> current = model->get();
+  if (!stream.tracks.empty() && current && current->isLoaded()) {
+    // gray crops at the model size, the classifier takes them as is.
+    // linear like the training loader, the features depend on it
+    frame.tracks = stream.tracks;
+    frame.samples.resize(stream.tracks.size());
+    for (size_t i = 0 ; i < stream.tracks.size() ; i ++) {
+      cv::resize(stream.gray(stream.tracks[i].box), frame.samples[i],
+                 current->getImageSize(), 0, 0, cv::INTER_LINEAR);
+    }
+  }
+  const int64_t end = cv::getTickCount();
+  {
+    std::lock_guard<std::mutex> lock(stream.statsMutex);
+    stream.frames ++;
+    smooth(stream.detectMs, elapsedMs(begin, end));
+    if (stream.lastTick != 0) {
+      smooth(stream.interval, elapsedMs(stream.lastTick, end));
+    }
+    stream.lastTick = end;
+  }
+
+  if (frame.samples.empty()) {
+    return true;
+  }
+  bool replaced = false;
+  {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    auto it = pending.find(stream.id);
+    if (it != pending.end()) {
+      // keeps its place in the queue, only the content is newer
+      it->second = std::move(frame);
+      replaced = true;
+    } else {
+      pending[stream.id] = std::move(frame);
+      order.push_back(stream.id);
+    }
+  }
+  if (replaced) {
+    std::lock_guard<std::mutex> lock(stream.statsMutex);
+    stream.skipped ++;
+  } else {
+    queued.notify_one();
+  }
+  return true;
+}
+
+void StreamService::recognizeLoop() {
+  while (true) {
+    vector<PendingFrame> frames;
+    {
+      std::unique_lock<std::mutex> lock(queueMutex);
+      queued.wait(lock, [this]() { return !order.empty() || !running; });
+      if (!running) {
+        break;
+      }
+      // whole frames, oldest first, until the batch is full
+      size_t faces = 0;
+      while (!order.empty()) {
+        PendingFrame& next = pending[order.front()];
+        if (!frames.empty() &&
+            faces + next.samples.size() >
+            static_cast<size_t>(params.maxBatch)) {
+          break;
+        }
+        faces += next.samples.size();
+        frames.push_back(std::move(next));
+        pending.erase(order.front());
+        order.pop_front();
+      }
+      busy ++;
+    }
+    this->recognize(frames);
+    {
+      std::lock_guard<std::mutex> lock(queueMutex);
+      busy --;
+    }
+  }
+}
+
+void StreamService::recognize(vector<PendingFrame>& frames) {
+  // one snapshot for the batch, a newer model applies to the next one
+  std::shared_ptr<FaceClassifier> current = model->get();
+  vector<Mat> batch;
+  for (size_t i = 0 ; i < frames.size() ; i ++) {
+    batch.insert(batch.end(), frames[i].samples.begin(),
+                 frames[i].samples.end());
+  }
+  vector<vector<RecognitionResult> > results;
+  vector<int> labels;
+  if (current && current->isLoaded()) {
+    current->recognize(batch, 1, results, labels);
+  }
+  results.resize(batch.size());
+  labels.resize(batch.size(), INT_MAX);
+
+  const int64_t now = cv::getTickCount();
+  size_t offset = 0;
+  for (size_t i = 0 ; i < frames.size() ; i ++) {
+    PendingFrame& frame = frames[i];
+    StreamResult result;
+    result.stream = frame.stream;
+    result.frame = frame.frame;
+    result.tracks.swap(frame.tracks);
+    result.latencyMs = elapsedMs(frame.captureTick, now);
+    for (size_t j = 0 ; j < frame.samples.size() ; j ++, offset ++) {
+      RecognitionResult best = {INT_MAX, string(), 0, 0};
+      if (!results[offset].empty()) {
+        best = results[offset][0];
+      }
+      result.labels.push_back(labels[offset]);
+      result.results.push_back(best);
+    }
+
+    Stream& stream = *streams[frame.stream];
+    std::lock_guard<std::mutex> delivery(stream.deliveryMutex);
+    const bool stale = frame.frame < stream.delivered;
+    {
+      std::lock_guard<std::mutex> lock(stream.statsMutex);
+      if (stale) {
+        stream.skipped ++;
+      } else {
+        stream.recognized ++;
+        smooth(stream.latencyMs, result.latencyMs);
+      }
+    }
+    if (stale) {
+      continue;
+    }
+    stream.delivered = frame.frame + 1;
+    if (callback) {
+      callback(result);
+    }
+  }
+}
+/*----- end of StreamService -----*/
+
+#undef POLL_INTERVAL_MS
+#undef STATS_SMOOTHING
@@ -0,0 +1,150 @@
+#ifndef STREAMSERVICE_H
+#define STREAMSERVICE_H
+
+#include <limits.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "classifier.h"
+#include "facedetector.h"
+#include "facetracker.h"
+#include "framegrabber.h"
+#include "framesource.h"
+#include "messenger.h"
+#include "modelhandle.h"
+
+using std::string;
+using std::vector;
+using cv::Mat;
+using classifier::FaceClassifier;
+using classifier::RecognitionResult;
+
+// constants
+extern const int DEFAULT_DETECT_THREADS;
+extern const int DEFAULT_RECOGNIZE_THREADS;
+extern const int DEFAULT_SERVICE_BATCH;
+
+typedef struct ServiceParams {
+  int detectThreads = DEFAULT_DETECT_THREADS;   // streams are spread over
+  int recognizeThreads = DEFAULT_RECOGNIZE_THREADS;
+  int maxBatch = DEFAULT_SERVICE_BATCH;         // faces per recognize()
+  bool tracking = true;
+  bool paced = true;          // replay recorded sources at their speed
+  DetectionParams detection;
+  string detectorModel = DEFAULT_DETECTION_MODEL;
+} ServiceParams;
+
+// counters of one stream, means are smoothed over the recent frames
+typedef struct StreamStats {
+  int stream;
+  string source;
+  uint64_t captured;      // frames read from the source
+  uint64_t dropped;       // never picked up by the detect worker
+  uint64_t processed;     // detected or tracked
+  uint64_t recognized;    // frames whose faces went through the model
+  uint64_t skipped;       // overtaken by a newer frame of the stream
+  double fps;             // processed frames per second
+  double detectMs;        // gray conversion, detection and cropping
+  double latencyMs;       // capture to recognition result
+  bool finished;          // a finite source ran out
+} StreamStats;
+
+// the faces of one frame, results[i] belongs to tracks[i]
+typedef struct StreamResult {
+  int stream;
+  uint64_t frame;                     // index among processed frames
+  vector<FaceTrack> tracks;
+  vector<int> labels;                 // INT_MAX if not recognized
+  vector<RecognitionResult> results;  // best candidate per track
+  double latencyMs;
+} StreamResult;
+
+// runs on a recognition thread. the results of one stream arrive in
+// frame order, one at a time, different streams may overlap
+typedef std::function<void(const StreamResult& result)> ResultCallback;
+
+// recognizes faces on many frame sources at once with one model.
+// every stream has its own grabber, detector and tracker, and the
+// streams are spread over detectThreads workers. the workers crop
+// the faces of the newest frame of each stream and hand them to a
+// central queue holding at most one frame per stream, an older one
+// still waiting is replaced. recognizeThreads threads take frames
+// from the queue in arrival order and predict their faces in
+// batches of up to maxBatch. all of them share the classifier
+// published in the model handle, which is only read.
+class StreamService : public classifier::Messenger {
+ public:
+  explicit StreamService(const ModelHandle* model,
+                         const ServiceParams& params = ServiceParams());
+  ~StreamService();
+  // takes ownership, -1 if the source cannot be opened
+  int addStream(FrameSource* source);
+  void setResultCallback(const ResultCallback& callback);
+  bool start();
+  void stop();
+  // every stream ran out of frames and everything was recognized
+  bool isFinished();
+  void getStats(vector<StreamStats>& stats);
+
+ private:
+  typedef struct Stream {
+    int id;
+    string name;
+    std::unique_ptr<FrameGrabber> grabber;
+    FaceDetector detector;
+    std::unique_ptr<FaceTracker> tracker;
+    Mat frame, gray;
+    vector<FaceTrack> tracks;
+    uint64_t frames = 0;
+    int64_t lastTick = 0;
+    std::atomic<bool> drained{false};   // finished and nothing left
+    // batches finish out of order with several recognizers, a result
+    // older than the last delivered one is dropped
+    std::mutex deliveryMutex;
+    uint64_t delivered = 0;             // next frame that may arrive
+    // written by the detect worker and the recognizers
+    std::mutex statsMutex;
+    uint64_t recognized = 0, skipped = 0;
+    double interval = 0, detectMs = 0, latencyMs = 0;
+  } Stream;
+
+  typedef struct PendingFrame {
+    int stream;
+    uint64_t frame;
+    int64_t captureTick;      // estimated from the grabber latency
+    vector<FaceTrack> tracks;
+    vector<Mat> samples;      // gray, model image size
+  } PendingFrame;
+
+  StreamService(const StreamService&);
+  StreamService& operator=(const StreamService&);
+  void detectLoop(int worker, int workers);
+  bool process(Stream& stream);
+  void recognizeLoop();
+  void recognize(vector<PendingFrame>& frames);
+
+  const ModelHandle* model;   // not owned
+  ServiceParams params;
+  vector<std::unique_ptr<Stream> > streams;
+  ResultCallback callback;
+  std::atomic<bool> running;
+  vector<std::thread> detectors, recognizers;
+
+  std::mutex queueMutex;
+  std::condition_variable queued;
+  std::map<int, PendingFrame> pending;    // newest frame per stream
+  std::deque<int> order;                  // streams waiting, oldest first
+  int busy = 0;                           // batches being recognized
+};
+
+#endif /* end of include guard: STREAMSERVICE_H */
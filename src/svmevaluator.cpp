@@ -0,0 +1,366 @@
+#include "svmevaluator.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "nearestneighbor.h"
+
+#define BLOB_ALIGNMENT 16
+#define SVM_ROOT_KEY "opencv_ml_svm"
+#define CLASS_LABELS_KEY "class_labels"
+
+using cv::FileStorage;
+
+namespace classifier {
+
+static size_t align(size_t offset) {
+  return (offset + BLOB_ALIGNMENT - 1) / BLOB_ALIGNMENT * BLOB_ALIGNMENT;
+}
+
+/****** SVMEvaluator ******/
+SVMEvaluator::SVMEvaluator() {
+  this->release();
+}
+
+void SVMEvaluator::release() {
+  memset(&header, 0, sizeof(header));
+  supportVectors = nullptr;
+  classLabels = nullptr;
+  rho = nullptr;
+  dfStart = nullptr;
+  svIndex = nullptr;
+  alpha = nullptr;
+  storage.clear();
+  wideVectors.release();
+  squaredNorms.release();
+}
+
+void SVMEvaluator::swap(SVMEvaluator& other) {
+  std::swap(header, other.header);
+  std::swap(supportVectors, other.supportVectors);
+  std::swap(classLabels, other.classLabels);
+  std::swap(rho, other.rho);
+  std::swap(dfStart, other.dfStart);
+  std::swap(svIndex, other.svIndex);
+  std::swap(alpha, other.alpha);
+  storage.swap(other.storage);
+  cv::swap(wideVectors, other.wideVectors);
+  cv::swap(squaredNorms, other.squaredNorms);
+}
+
+void SVMEvaluator::layout(size_t offsets[6], size_t& total) const {
+  const size_t dfCount = header.classCount * (header.classCount - 1) / 2;
+  size_t offset = align(sizeof(Header));
+  offsets[0] = offset;
+  offset = align(offset + sizeof(float) *
+                 header.svCount * header.varCount);
+  offsets[1] = offset;
+  offset = align(offset + sizeof(int32_t) * header.classCount);
+  offsets[2] = offset;
+  offset = align(offset + sizeof(double) * dfCount);
+  offsets[3] = offset;
+  offset = align(offset + sizeof(int32_t) * (dfCount + 1));
+  offsets[4] = offset;
+  offset = align(offset + sizeof(int32_t) * header.alphaCount);
+  offsets[5] = offset;
+  total = offset + sizeof(double) * header.alphaCount;
+}
+
+bool SVMEvaluator::build(const Ptr<SVM>& svm,
+                         const vector<int>& labels) {
+  release();
+  if (!svm || !svm->isTrained() || labels.size() < 2) {
+    return false;
+  }
+  const int kernelType = svm->getKernelType();
+  if (kernelType != SVM::LINEAR && kernelType != SVM::POLY &&
+      kernelType != SVM::RBF && kernelType != SVM::SIGMOID) {
+#ifdef DEBUG
+    fprintf(stderr, "unsupported kernel for svm evaluator\n");
+#endif
+    return false;
+  }
+
+  Mat sv;
+  svm->getSupportVectors().convertTo(sv, CV_32FC1);
+
+  Header h;
+  memset(&h, 0, sizeof(h));
+  h.kernelType = kernelType;
+  h.varCount = svm->getVarCount();
+  h.svCount = sv.rows;
+  h.classCount = static_cast<int32_t>(labels.size());
+  h.gamma = svm->getGamma();
+  h.coef0 = svm->getCoef0();
+  h.degree = svm->getDegree();
+
+  // collect all decision functions (one per class pair)
+  const int dfCount = h.classCount * (h.classCount - 1) / 2;
+  vector<double> rhos, alphas;
+  vector<int32_t> starts(1, 0), indices;
+  for (int i = 0 ; i < dfCount ; i ++) {
+    Mat a, idx;
+    rhos.push_back(svm->getDecisionFunction(i, a, idx));
+    for (int k = 0 ; k < static_cast<int>(idx.total()) ; k ++) {
+      alphas.push_back(a.ptr<double>(0)[k]);
+      indices.push_back(idx.ptr<int>(0)[k]);
+    }
+    starts.push_back(static_cast<int32_t>(indices.size()));
+  }
+  h.alphaCount = static_cast<int32_t>(indices.size());
+
+  header = h;
+  size_t offsets[6], total = 0;
+  layout(offsets, total);
+  storage.assign(total, 0);
+
+  char* base = &storage[0];
+  memcpy(base, &header, sizeof(Header));
+  for (int i = 0 ; i < sv.rows ; i ++) {
+    memcpy(base + offsets[0] + sizeof(float) * i * h.varCount,
+           sv.ptr<float>(i), sizeof(float) * h.varCount);
+  }
+  for (int i = 0 ; i < h.classCount ; i ++) {
+    const int32_t label = labels[i];
+    memcpy(base + offsets[1] + sizeof(int32_t) * i,
+           &label, sizeof(int32_t));
+  }
+  memcpy(base + offsets[2], rhos.data(), sizeof(double) * rhos.size());
+  memcpy(base + offsets[3], starts.data(),
+         sizeof(int32_t) * starts.size());
+  memcpy(base + offsets[4], indices.data(),
+         sizeof(int32_t) * indices.size());
+  memcpy(base + offsets[5], alphas.data(),
+         sizeof(double) * alphas.size());
+
+  // point into our own storage exactly like into a mapped bundle
+  return attach(&storage[0], storage.size());
+}
+
+bool SVMEvaluator::attach(const char* blob, size_t size) {
+  if (blob == nullptr || size < sizeof(Header)) {
+    return false;
+  }
+  memcpy(&header, blob, sizeof(Header));
+  if (header.classCount < 2 || header.varCount <= 0 ||
+      header.svCount <= 0 || header.alphaCount < 0) {
+    memset(&header, 0, sizeof(header));
+    return false;
+  }
+
+  size_t offsets[6], total = 0;
+  layout(offsets, total);
+  if (total > size) {
+#ifdef DEBUG
+    fprintf(stderr, "truncated svm blob\n");
+#endif
+    memset(&header, 0, sizeof(header));
+    return false;
+  }
+
+  supportVectors = reinterpret_cast<const float*>(blob + offsets[0]);
+  classLabels = reinterpret_cast<const int32_t*>(blob + offsets[1]);
+  rho = reinterpret_cast<const double*>(blob + offsets[2]);
+  dfStart = reinterpret_cast<const int32_t*>(blob + offsets[3]);
+  svIndex = reinterpret_cast<const int32_t*>(blob + offsets[4]);
+  alpha = reinterpret_cast<const double*>(blob + offsets[5]);
+
+  Mat(header.svCount, header.varCount, CV_32FC1,
+      const_cast<float*>(supportVectors)).convertTo(wideVectors, CV_64FC1);
+  squaredNorms.create(1, header.svCount, CV_64FC1);
+  for (int i = 0 ; i < header.svCount ; i ++) {
+    squaredNorms.ptr<double>(0)[i] = wideVectors.row(i).dot(
+        wideVectors.row(i));
+  }
+  return true;
+}
+
+void SVMEvaluator::serialize(vector<char>& blob) const {
+  blob.clear();
+  if (!isReady()) {
+    return;
+  }
+  size_t offsets[6], total = 0;
+  layout(offsets, total);
+  blob.assign(total, 0);
+
+  char* base = &blob[0];
+  const size_t dfCount = header.classCount * (header.classCount - 1) / 2;
+  memcpy(base, &header, sizeof(Header));
+  memcpy(base + offsets[0], supportVectors,
+         sizeof(float) * header.svCount * header.varCount);
+  memcpy(base + offsets[1], classLabels,
+         sizeof(int32_t) * header.classCount);
+  memcpy(base + offsets[2], rho, sizeof(double) * dfCount);
+  memcpy(base + offsets[3], dfStart, sizeof(int32_t) * (dfCount + 1));
+  memcpy(base + offsets[4], svIndex,
+         sizeof(int32_t) * header.alphaCount);
+  memcpy(base + offsets[5], alpha, sizeof(double) * header.alphaCount);
+}
+
+bool SVMEvaluator::isReady() const {
+  return supportVectors != nullptr;
+}
+
+int SVMEvaluator::getVarCount() const {
+  return header.varCount;
+}
+
+int SVMEvaluator::getClassCount() const {
+  return header.classCount;
+}
+
+int SVMEvaluator::getClassLabel(int index) const {
+  return classLabels[index];
+}
+
+void SVMEvaluator::kernel(const float* sample,
+                          vector<double>& values) const {
+  values.resize(header.svCount);
+  const int length = header.varCount;
+  for (int i = 0 ; i < header.svCount ; i ++) {
+    const float* sv = supportVectors + static_cast<size_t>(i) * length;
+    switch (header.kernelType) {
+      case SVM::LINEAR:
+        values[i] = dotProduct(sample, sv, length);
+        break;
+      case SVM::POLY:
+        values[i] = pow(header.gamma * dotProduct(sample, sv, length) +
+                        header.coef0, header.degree);
+        break;
+      case SVM::SIGMOID:
+        values[i] = tanh(header.gamma * dotProduct(sample, sv, length) +
+                         header.coef0);
+        break;
+      case SVM::RBF:
+      default:
+        values[i] = exp(-header.gamma *
+                        squaredL2Distance(sample, sv, length));
+        break;
+    }
+  }
+}
+
+void SVMEvaluator::kernel(const Mat& samples, Mat& values) const {
+  // double like the per sample path, see wideVectors
+  Mat wide;
+  samples.convertTo(wide, CV_64FC1);
+  cv::gemm(wide, wideVectors, 1, Mat(), 0, values, cv::GEMM_2_T);
+
+  const double* norms = squaredNorms.ptr<double>(0);
+  for (int r = 0 ; r < values.rows ; r ++) {
+    double* row = values.ptr<double>(r);
+    const double sampleNorm = header.kernelType == SVM::RBF ?
+        wide.row(r).dot(wide.row(r)) : 0;
+    for (int i = 0 ; i < values.cols ; i ++) {
+      switch (header.kernelType) {
+        case SVM::LINEAR:
+          break;
+        case SVM::POLY:
+          row[i] = pow(header.gamma * row[i] + header.coef0, header.degree);
+          break;
+        case SVM::SIGMOID:
+          row[i] = tanh(header.gamma * row[i] + header.coef0);
+          break;
+        case SVM::RBF:
+        default:
+          // |x - sv|^2 = |x|^2 + |sv|^2 - 2 x.sv
+          row[i] = exp(-header.gamma *
+                       std::max(0.0, sampleNorm + norms[i] - 2 * row[i]));
+          break;
+      }
+    }
+  }
+}
+
+bool SVMEvaluator::classScores(const Mat& sample, vector<int>& votes,
+                               vector<double>& margins) const {
+  if (!isReady() || sample.cols != header.varCount ||
+      sample.type() != CV_32FC1) {
+    return false;
+  }
+
+  vector<double> values;
+  kernel(sample.ptr<float>(0), values);
+  decide(values.data(), votes, margins);
+  return true;
+}
+
+bool SVMEvaluator::classScores(const Mat& samples,
+                               vector<vector<int> >& votes,
+                               vector<vector<double> >& margins) const {
+  if (!isReady() || samples.cols != header.varCount ||
+      samples.type() != CV_32FC1) {
+    return false;
+  }
+
+  Mat values;
+  kernel(samples, values);
+  votes.resize(samples.rows);
+  margins.resize(samples.rows);
+  for (int r = 0 ; r < samples.rows ; r ++) {
+    decide(values.ptr<double>(r), votes[r], margins[r]);
+  }
+  return true;
+}
+
+void SVMEvaluator::decide(const double* values, vector<int>& votes,
+                          vector<double>& margins) const {
+  // one-vs-one voting, same rule as cv::ml::SVM
+  // the margin of a class is its worst pairwise decision value,
+  // positive only when it wins against every other class
+  votes.assign(header.classCount, 0);
+  margins.assign(header.classCount, DBL_MAX);
+  int df = 0;
+  for (int i = 0 ; i < header.classCount ; i ++) {
+    for (int j = i + 1 ; j < header.classCount ; j ++, df ++) {
+      double sum = -rho[df];
+      for (int k = dfStart[df] ; k < dfStart[df + 1] ; k ++) {
+        sum += alpha[k] * values[svIndex[k]];
+      }
+      votes[sum > 0 ? i : j] ++;
+      margins[i] = std::min(margins[i], sum);
+      margins[j] = std::min(margins[j], -sum);
+    }
+  }
+}
+
+int SVMEvaluator::predict(const Mat& sample) const {
+  vector<int> votes;
+  vector<double> margins;
+  if (!classScores(sample, votes, margins)) {
+    return INT_MAX;
+  }
+
+  int best = 0;
+  for (int i = 1 ; i < header.classCount ; i ++) {
+    if (votes[i] > votes[best]) {
+      best = i;
+    }
+  }
+  return classLabels[best];
+}
+
+void SVMEvaluator::readClassLabels(const std::string modelPath,
+                                   vector<int>& labels) {
+  labels.clear();
+  FileStorage fs(modelPath, FileStorage::READ);
+  if (fs.isOpened()) {
+    Mat classLabels;
+    fs[SVM_ROOT_KEY][CLASS_LABELS_KEY] >> classLabels;
+    for (size_t i = 0 ; i < classLabels.total() ; i ++) {
+      labels.push_back(classLabels.ptr<int>(0)[i]);
+    }
+  }
+}
+/*----- end of SVMEvaluator -----*/
+
+} /* classifier */
+
+#undef BLOB_ALIGNMENT
+#undef SVM_ROOT_KEY
+#undef CLASS_LABELS_KEY
@@ -0,0 +1,83 @@
+#ifndef SVMEVALUATOR_H
+#define SVMEVALUATOR_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/ml.hpp>
+
+#include <stdint.h>
+#include <vector>
+
+using std::vector;
+using cv::Mat;
+using cv::Ptr;
+using cv::ml::SVM;
+
+namespace classifier {
+
+// flat copy of a trained one-vs-one cv::ml::SVM
+// the whole model is a single relocatable blob, so it can be evaluated
+// straight from a memory mapped model bundle without parsing.
+// kernel values of all support vectors are computed once per sample
+// and shared by every pairwise decision function.
+class SVMEvaluator {
+ public:
+  SVMEvaluator();
+  bool build(const Ptr<SVM>& svm, const vector<int>& classLabels);
+  bool attach(const char* blob, size_t size);
+  void serialize(vector<char>& blob) const;
+  void release();
+  // exchanges the models, pointers into an owned blob stay valid
+  void swap(SVMEvaluator& other);
+  bool isReady() const;
+  int getVarCount() const;
+  int getClassCount() const;
+  int getClassLabel(int index) const;
+  int predict(const Mat& sample) const;
+  bool classScores(const Mat& sample, vector<int>& votes,
+                   vector<double>& margins) const;
+  // one row per sample, the kernel values of the whole batch
+  // come from a single matrix product with the support vectors
+  bool classScores(const Mat& samples, vector<vector<int> >& votes,
+                   vector<vector<double> >& margins) const;
+  void kernel(const float* sample, vector<double>& values) const;
+  void kernel(const Mat& samples, Mat& values) const;
+
+  static void readClassLabels(const std::string modelPath,
+                              vector<int>& classLabels);
+
+ private:
+  struct Header {
+    int32_t kernelType;
+    int32_t varCount;
+    int32_t svCount;
+    int32_t classCount;
+    int32_t alphaCount;
+    int32_t reserved;
+    double gamma;
+    double coef0;
+    double degree;
+  };
+
+  SVMEvaluator(const SVMEvaluator&);
+  SVMEvaluator& operator=(const SVMEvaluator&);
+  void layout(size_t offsets[6], size_t& total) const;
+  void decide(const double* values, vector<int>& votes,
+              vector<double>& margins) const;
+
+  Header header;
+  const float* supportVectors;    // svCount x varCount
+  const int32_t* classLabels;     // classCount, ascending
+  const double* rho;              // one per decision function
+  const int32_t* dfStart;         // decision function ranges in alpha
+  const int32_t* svIndex;         // alphaCount
+  const double* alpha;            // alphaCount
+  vector<char> storage;           // owned blob when built from an svm
+  // batched kernels run in double, float products over raw histogram
+  // counts cancel badly in |x|^2 + |sv|^2 - 2 x.sv
+  Mat wideVectors;                // svCount x varCount, CV_64FC1
+  Mat squaredNorms;               // 1 x svCount, for batched rbf
+};
+
+} /* classifier */
+
+#endif /* end of include guard: SVMEVALUATOR_H */
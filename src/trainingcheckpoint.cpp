@@ -0,0 +1,204 @@
+#include "trainingcheckpoint.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "common.h"
+#include "modelbundle.h"
+
+#define DATA_FILE "features.frc"
+#define SEARCH_FILE "search.yml"
+#define SEARCH_TEMP_FILE "search.tmp.yml"
+#define BEST_MODEL_FILE "best.xml"
+#define BEST_MODEL_TEMP_FILE "best.tmp.xml"
+
+#define FINGERPRINT_KEY "fingerprint"
+#define ITERATION_KEY "iteration"
+#define GAMMA_KEY "gamma"
+#define DEGREE_KEY "degree"
+#define MAX_ACCURACY_KEY "maxAccuracy"
+#define MAX_GAMMA_KEY "maxGamma"
+#define WORSE_COUNT_KEY "worseCount"
+#define GAMMAS_KEY "gammas"
+#define ACCURACIES_KEY "accuracies"
+
+using cv::FileStorage;
+
+namespace classifier {
+
+// sections of the feature checkpoint
+typedef enum {
+  CHECKPOINT_FINGERPRINT = 1,   // fingerprint bytes
+  CHECKPOINT_FEATURES,          // GalleryHeader + float rows
+  CHECKPOINT_LABELS,            // int32 per row
+  CHECKPOINT_TRAIN_INDEX,       // int32 per training row
+  CHECKPOINT_TEST_INDEX,        // int32 per testing row
+  CHECKPOINT_NAMES              // label -> name map
+} CheckpointSection;
+
+static void readIndex(const ModelBundleReader& reader, uint32_t tag,
+                      vector<int>& index) {
+  size_t size = 0;
+  const char* section = reader.section(tag, size);
+  index.resize(section == nullptr ? 0 : size / sizeof(int32_t));
+  if (!index.empty()) {
+    memcpy(index.data(), section, index.size() * sizeof(int32_t));
+  }
+}
+
+/****** TrainingCheckpoint ******/
+TrainingCheckpoint::TrainingCheckpoint(const string directory,
+                                       const string fingerprint)
+    : directory(directory), fingerprint(fingerprint) {
+  // fails harmlessly when the directory is already there
+  createDirectory(directory);
+}
+
+string TrainingCheckpoint::path(const char* name) const {
+  return directory + string(SEPARATOR) + string(name);
+}
+
+bool TrainingCheckpoint::saveData(const Mat& data, const Mat& labels,
+                                  const DataSplit& split,
+                                  const map<int, string>& names) const {
+  if (data.type() != CV_32FC1 || labels.rows != data.rows) {
+    return false;
+  }
+  const Mat rows = data.isContinuous() ? data : data.clone();
+  const Mat rowLabels = labels.isContinuous() ? labels : labels.clone();
+
+  ModelBundleWriter writer;
+  writer.addSection(CHECKPOINT_FINGERPRINT, fingerprint.data(),
+                    fingerprint.size());
+  GalleryHeader header = {rows.rows, rows.cols, {0, 0}};
+  writer.addSection(CHECKPOINT_FEATURES, &header, sizeof(header),
+                    rows.data, rows.total() * sizeof(float));
+  writer.addSection(CHECKPOINT_LABELS, rowLabels.data,
+                    rowLabels.total() * sizeof(int32_t));
+  writer.addSection(CHECKPOINT_TRAIN_INDEX, split.getTrainIndex().data(),
+                    split.getTrainIndex().size() * sizeof(int32_t));
+  writer.addSection(CHECKPOINT_TEST_INDEX, split.getTestIndex().data(),
+                    split.getTestIndex().size() * sizeof(int32_t));
+  vector<char> blob;
+  encodeNames(names, blob);
+  writer.addSection(CHECKPOINT_NAMES, blob.data(), blob.size());
+
+  // the writer replaces the file atomically
+  return writer.write(path(DATA_FILE));
+}
+
+bool TrainingCheckpoint::loadData(Mat& data, Mat& labels, DataSplit& split,
+                                  map<int, string>& names) const {
+  ModelBundleReader reader;
+  if (!reader.open(path(DATA_FILE))) {
+    return false;
+  }
+
+  size_t size = 0;
+  const char* section = reader.section(CHECKPOINT_FINGERPRINT, size);
+  if (section == nullptr || string(section, size) != fingerprint) {
+    return false;
+  }
+
+  GalleryHeader header;
+  size_t labelSize = 0;
+  section = reader.section(CHECKPOINT_FEATURES, size);
+  const char* labelSection = reader.section(CHECKPOINT_LABELS, labelSize);
+  if (section == nullptr || size < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, section, sizeof(header));
+  if (size < sizeof(header) + sizeof(float) * header.rows * header.cols ||
+      labelSize < sizeof(int32_t) * header.rows) {
+    return false;
+  }
+
+  // copied out, the mapping is closed with the reader
+  data = Mat(header.rows, header.cols, CV_32FC1,
+             const_cast<char*>(section + sizeof(header))).clone();
+  labels = Mat(header.rows, 1, CV_32SC1,
+               const_cast<char*>(labelSection)).clone();
+  vector<int> trainIndex, testIndex;
+  readIndex(reader, CHECKPOINT_TRAIN_INDEX, trainIndex);
+  readIndex(reader, CHECKPOINT_TEST_INDEX, testIndex);
+  split = DataSplit(trainIndex, testIndex);
+  section = reader.section(CHECKPOINT_NAMES, size);
+  return decodeNames(section, size, names);
+}
+
+bool TrainingCheckpoint::saveSearch(const SearchState& state) const {
+  const string temp = path(SEARCH_TEMP_FILE);
+  {
+    FileStorage fs(temp, FileStorage::WRITE);
+    if (!fs.isOpened()) {
+      return false;
+    }
+    fs << FINGERPRINT_KEY << fingerprint;
+    fs << ITERATION_KEY << state.iteration;
+    fs << GAMMA_KEY << state.gamma;
+    fs << DEGREE_KEY << state.degree;
+    fs << MAX_ACCURACY_KEY << state.maxAccuracy;
+    fs << MAX_GAMMA_KEY << state.maxGamma;
+    fs << WORSE_COUNT_KEY << state.worseCount;
+    fs << GAMMAS_KEY << state.gammas;
+    fs << ACCURACIES_KEY << state.accuracies;
+  }
+  return replaceFile(temp, path(SEARCH_FILE));
+}
+
+bool TrainingCheckpoint::loadSearch(SearchState& state) const {
+  FileStorage fs(path(SEARCH_FILE), FileStorage::READ);
+  if (!fs.isOpened()) {
+    return false;
+  }
+  string stored;
+  fs[FINGERPRINT_KEY] >> stored;
+  if (stored != fingerprint) {
+    return false;
+  }
+  fs[ITERATION_KEY] >> state.iteration;
+  fs[GAMMA_KEY] >> state.gamma;
+  fs[DEGREE_KEY] >> state.degree;
+  fs[MAX_ACCURACY_KEY] >> state.maxAccuracy;
+  fs[MAX_GAMMA_KEY] >> state.maxGamma;
+  fs[WORSE_COUNT_KEY] >> state.worseCount;
+  fs[GAMMAS_KEY] >> state.gammas;
+  fs[ACCURACIES_KEY] >> state.accuracies;
+  return true;
+}
+
+bool TrainingCheckpoint::saveBestModel(
+    const cv::Ptr<cv::ml::SVM>& svm) const {
+  // the extension tells opencv the format, so not a .tmp suffix
+  const string temp = path(BEST_MODEL_TEMP_FILE);
+  svm->save(temp);
+  return replaceFile(temp, path(BEST_MODEL_FILE));
+}
+
+string TrainingCheckpoint::getBestModelPath() const {
+  return path(BEST_MODEL_FILE);
+}
+
+void TrainingCheckpoint::clear() const {
+  remove(path(DATA_FILE).c_str());
+  remove(path(SEARCH_FILE).c_str());
+  remove(path(BEST_MODEL_FILE).c_str());
+}
+/*----- end of TrainingCheckpoint -----*/
+
+} /* classifier */
+
+#undef DATA_FILE
+#undef SEARCH_FILE
+#undef SEARCH_TEMP_FILE
+#undef BEST_MODEL_FILE
+#undef BEST_MODEL_TEMP_FILE
+#undef FINGERPRINT_KEY
+#undef ITERATION_KEY
+#undef GAMMA_KEY
+#undef DEGREE_KEY
+#undef MAX_ACCURACY_KEY
+#undef MAX_GAMMA_KEY
+#undef WORSE_COUNT_KEY
+#undef GAMMAS_KEY
+#undef ACCURACIES_KEY
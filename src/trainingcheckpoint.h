@@ -0,0 +1,61 @@
+#ifndef TRAININGCHECKPOINT_H
+#define TRAININGCHECKPOINT_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/ml.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "datasplit.h"
+
+using std::string;
+using std::map;
+using std::vector;
+using cv::Mat;
+
+namespace classifier {
+
+// progress of the gamma search, enough to continue it
+typedef struct SearchState {
+  int iteration = 0;          // next iteration to run
+  double gamma = 0;
+  double degree = 0;
+  double maxAccuracy = 0;
+  double maxGamma = 0;
+  int worseCount = 0;
+  vector<double> gammas;      // every evaluated gamma
+  vector<double> accuracies;  // and its test accuracy
+} SearchState;
+
+// on disk state of an interrupted training run
+// the loaded features and their split are written once, the search
+// state after every fit and the best svm whenever it improves.
+// every file is replaced atomically, a crash leaves the previous one.
+// a checkpoint written for another fingerprint is never loaded.
+class TrainingCheckpoint {
+ public:
+  TrainingCheckpoint(const string directory, const string fingerprint);
+
+  bool saveData(const Mat& data, const Mat& labels,
+                const DataSplit& split,
+                const map<int, string>& names) const;
+  bool loadData(Mat& data, Mat& labels, DataSplit& split,
+                map<int, string>& names) const;
+  bool saveSearch(const SearchState& state) const;
+  bool loadSearch(SearchState& state) const;
+  bool saveBestModel(const cv::Ptr<cv::ml::SVM>& svm) const;
+  string getBestModelPath() const;
+  void clear() const;
+
+ private:
+  string path(const char* name) const;
+
+  string directory;
+  string fingerprint;
+};
+
+} /* classifier */
+
+#endif /* end of include guard: TRAININGCHECKPOINT_H */
@@ -1,5 +1,7 @@
 #include "trainingtask.h"
 
+#define CHECKPOINT_DIR "checkpoint"
+
 #ifdef QT_DEBUG
 using std::cout;
 using std::endl;
@@ -8,6 +10,9 @@ using std::endl;
 using classifier::LoadingParams;
 using classifier::FaceClassifierParams;
 using classifier::TrainingDataLoader;
+using classifier::DataSplit;
+using classifier::TrainingCheckpoint;
+using classifier::ModelSelection;
 using std::map;
 using std::string;
 
@@ -20,7 +25,8 @@ TrainingTask::TrainingTask(QString _faceImageDirectory,
                            double _size,
                            double _trainingStep,
                            double _gamma,
-                           FeatureType _featureType) {
+                           FeatureType _featureType,
+                           FaceClassifier::FaceClassifierBackend _backend) {
   faceImageDirectory = _faceImageDirectory;
   modelBaseName = _modelBaseName;
   modelExtension = _modelExtension;
@@ -31,6 +37,7 @@ TrainingTask::TrainingTask(QString _faceImageDirectory,
   trainingSize = Size(_size, _size);
   defaultGamma = _gamma;
   featureType = _featureType;
+  backend = _backend;
 }
 
 TrainingTask::~TrainingTask() {
@@ -42,7 +49,86 @@ TrainingTask::~TrainingTask() {
 #endif
 }
 
+void TrainingTask::setBackgroundClass(bool enable) {
+  backgroundClass = enable;
+}
+
+void TrainingTask::setProjection(classifier::ProjectionType type) {
+  projection = type;
+}
+
+void TrainingTask::setBudget(const classifier::TrainingBudget& budget) {
+  this->budget = budget;
+}
+
+void TrainingTask::setAutoFeature(bool enable, double latencyTarget) {
+  autoFeature = enable;
+  this->latencyTarget = latencyTarget;
+}
+
+void TrainingTask::setEnrollment(std::shared_ptr<FaceClassifier> live,
+                                 QString person, int label,
+                                 QString modelPath, QString extraPath) {
+  liveClassifier = live;
+  enrollPerson = person;
+  enrollLabel = label;
+  enrollModelPath = modelPath;
+  enrollExtraPath = extraPath;
+}
+
+std::shared_ptr<FaceClassifier> TrainingTask::getEnrolledClassifier() const {
+  return enrolledClassifier;
+}
+
+void TrainingTask::runEnrollment() {
+  sendMessage("loading images of " + enrollPerson + "...");
+  // only the enrolled person is read, with the live model settings
+  LoadingParams params(faceImageDirectory.toStdString(), 1.0,
+                       liveClassifier->getFeatureType(),
+                       liveClassifier->getImageSize());
+  TrainingDataLoader loader(params);
+  loader.setMessageCallback(forwarder());
+  loader.loadPerson(enrollPerson.toStdString(), trainingData);
+
+  // the live model is shared with the recognizers and never changed,
+  // the person goes into a copy round tripped through the model files
+  const QString copyModelPath = modelBasePath + QDir::separator() +
+      modelBaseName + "enrolling" + modelExtension;
+  const QString copyExtraPath = modelBasePath + QDir::separator() +
+      extraInfoBaseName + "enrolling" + modelExtension;
+  liveClassifier->saveModel(copyModelPath.toStdString(),
+                            copyExtraPath.toStdString());
+  std::shared_ptr<FaceClassifier> copy =
+      ModelHandle::wrap(new FaceClassifier());
+  copy->setMessageCallback(forwarder());
+  const bool loaded = copy->load(copyModelPath.toStdString(),
+                                 copyExtraPath.toStdString());
+  QFile::remove(copyModelPath);
+  QFile::remove(copyExtraPath);
+
+  if (loaded && copy->enroll(trainingData, enrollLabel)) {
+    // enroll() guesses the type from the length, which is ambiguous
+    copy->setFeatureType(liveClassifier->getFeatureType());
+    sendMessage("saving model...");
+    copy->saveModel(enrollModelPath.toStdString(),
+                    enrollExtraPath.toStdString());
+    copy->setMessageCallback(classifier::MessageCallback());
+    enrolledClassifier = copy;
+    enrolled(enrollPerson, enrollLabel);
+  } else {
+    enrolled(enrollPerson, INT_MAX);
+  }
+}
+
 void TrainingTask::run() {
+  if (liveClassifier != nullptr) {
+    runEnrollment();
+    return;
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+
   // create image root directory if not exists
   QDir imageRoot(faceImageDirectory);
   if (!imageRoot.exists()) {
@@ -77,11 +163,39 @@ void TrainingTask::run() {
   LoadingParams params(faceImageDirectory.toStdString(),
                        loadingPercent,
                        featureType, trainingSize);
-  // load the images into matrix
-  TrainingDataLoader loader(params);
-  connect(&loader, SIGNAL(sendMessage(QString)), this,
-          SLOT(captureMessage(QString)));
-  loader.load(trainingData, trainingLabel, names);
+  params.includeBackground = backgroundClass;
+  // an interrupted run with the same settings and images resumes
+  TrainingCheckpoint checkpoint(
+      (modelBasePath + QDir::separator() + CHECKPOINT_DIR).toStdString(),
+      fingerprint(params).toStdString());
+  // every candidate type is extracted from one pass over the images
+  vector<FeatureType> types(1, featureType);
+  if (autoFeature) {
+    types = {classifier::LBP, classifier::LTP, classifier::CSLTP,
+             classifier::HAAR};
+  }
+  vector<Mat> data;
+  vector<double> extractionTime;
+  DataSplit split;
+  if (autoFeature) {
+    // the candidates train at once, a checkpoint follows one search
+    checkpoint.clear();
+    loadData(params, types, data, extractionTime, split);
+  } else if (checkpoint.loadData(trainingData, trainingLabel, split,
+                                 names)) {
+    sendMessage("training data restored from checkpoint");
+    for (auto it = names.begin() ; it != names.end() ; it ++) {
+      // the background class may have been forced in, see below
+      if (it->second == params.bgDir) {
+        backgroundClass = true;
+      }
+    }
+  } else {
+    checkpoint.clear();
+    loadData(params, types, data, extractionTime, split);
+    trainingData = data[0];
+    checkpoint.saveData(trainingData, trainingLabel, split, names);
+  }
   sendMessage("training data loaded");
 
   // old way to load data
@@ -93,19 +207,63 @@ void TrainingTask::run() {
     FaceClassifierParams classifierParam(trainingSize,
                                          defaultGamma, trainingStep,
                                          1.0 - loadingPercent);
-    faceClassifier = new FaceClassifier(classifierParam,
-                                        trainingData,
-                                        trainingLabel);
+    classifierParam.backend = backend;
+    classifierParam.projection = projection;
+    classifierParam.featureType = featureType;
+    classifier::TrainingBudget remaining = budget;
+    if (budget.seconds > 0) {
+      // whatever loading took is gone from the search
+      remaining.seconds = std::max(1.0,
+                                   budget.seconds - timer.elapsed() / 1000.0);
+    }
+
+    if (autoFeature) {
+      ModelSelection selection(classifierParam, latencyTarget);
+      selection.setMessageCallback(forwarder());
+      sendMessage("training started...");
+      faceClassifier = selection.select(types, data, trainingLabel, split,
+                                        extractionTime, remaining);
+      if (faceClassifier == nullptr) {
+        sendMessage("model selection failed");
+        // empty paths tell the receiver nothing was written
+        complete(QString(), QString(), QMap<int, QString>());
+        return;
+      }
+      featureType = types[selection.getSelected()];
+      trainingData = data[selection.getSelected()];
+      data.clear();
+      faceClassifier->setMessageCallback(forwarder());
+    } else {
+      faceClassifier = new FaceClassifier(classifierParam,
+                                          trainingData,
+                                          trainingLabel);
+      // train/test exactly as the loader laid the rows out
+      faceClassifier->setSplit(split);
+      faceClassifier->setCheckpoint(&checkpoint);
+      faceClassifier->setBudget(remaining);
 
-    // connect log message from training task
-    connect(faceClassifier, SIGNAL(sendMessage(QString)),
-            this, SLOT(captureMessage(QString)));
+      // forward log message from training task
+      faceClassifier->setMessageCallback(forwarder());
 
-    sendMessage("training started...");
-    faceClassifier->train();
+      sendMessage("training started...");
+      faceClassifier->train();
+    }
+    faceClassifier->calibrateConfidence();
+    if (!backgroundClass) {
+      // background images are only used to calibrate the rejection
+      sendMessage("calibrating rejection threshold...");
+      Mat impostors;
+      params.featureType = featureType;
+      TrainingDataLoader loader(params);
+      loader.setMessageCallback(forwarder());
+      loader.loadPerson(params.bgDir, impostors);
+      faceClassifier->calibrateRejection(impostors);
+    }
     sendMessage("saving model...");
     faceClassifier->saveModel(currentModelPath.toStdString(),
                               currentExtraInfoPath.toStdString());
+    faceClassifier->setCheckpoint(nullptr);
+    checkpoint.clear();
   }
 
   // prepare the data as QMap<int, QString>
@@ -116,6 +274,64 @@ void TrainingTask::run() {
   complete(currentModelPath, currentExtraInfoPath, nameMap);
 }
 
-void TrainingTask::captureMessage(QString message) {
-  sendMessage(message);
+void TrainingTask::loadData(LoadingParams& params,
+                            const vector<FeatureType>& types,
+                            vector<Mat>& data,
+                            vector<double>& extractionTime,
+                            DataSplit& split) {
+  TrainingDataLoader loader(params);
+  loader.setMessageCallback(forwarder());
+  loader.load(types, data, trainingLabel, names, split);
+  if (!backgroundClass && names.size() < 2 &&
+      backend == FaceClassifier::SVM_BACKEND) {
+    // a multi class svm needs at least two classes
+    sendMessage("only one identity, training the background class too");
+    backgroundClass = true;
+    params.includeBackground = true;
+    names.clear();
+    loadData(params, types, data, extractionTime, split);
+    return;
+  }
+  extractionTime.clear();
+  for (size_t i = 0 ; i < types.size() ; i ++) {
+    extractionTime.push_back(loader.getExtractionTime(types[i]));
+  }
 }
+
+QString TrainingTask::fingerprint(const LoadingParams& params) {
+  // every setting that changes the result, and the image set itself
+  QString description = faceImageDirectory + ";" +
+      QString::number(featureType) + ";" +
+      QString::number(trainingSize.width) + ";" +
+      QString::number(loadingPercent) + ";" +
+      QString::number(trainingStep) + ";" +
+      QString::number(defaultGamma) + ";" +
+      QString::number(backend) + ";" +
+      QString::number(projection) + ";" +
+      QString::number(budget.memoryBytes) + ";" +
+      QString::number(backgroundClass) + ";" +
+      QString::number(params.seed) + ";" +
+      QString::number(params.sessionGap);
+  qint64 fileCount = 0, newest = 0;
+  QDirIterator it(faceImageDirectory, QDir::Files,
+                  QDirIterator::Subdirectories);
+  while (it.hasNext()) {
+    it.next();
+    fileCount ++;
+    newest = qMax(newest, it.fileInfo().lastModified().toMSecsSinceEpoch());
+  }
+  description += ";" + QString::number(fileCount) +
+      ";" + QString::number(newest);
+  return QString(QCryptographicHash::hash(description.toUtf8(),
+                                          QCryptographicHash::Sha1).toHex());
+}
+
+classifier::MessageCallback TrainingTask::forwarder() {
+  // signals may be emitted from any thread, model selection
+  // reports from its training threads
+  return [this](const string& message) {
+    sendMessage(QString::fromStdString(message));
+  };
+}
+
+#undef CHECKPOINT_DIR
@@ -5,11 +5,18 @@
 #include <QString>
 #include <QDateTime>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QDirIterator>
+#include <QCryptographicHash>
 #include <QMap>
 #include <string>
 #include <map>
+#include <memory>
 
 #include "classifier.h"
+#include "modelhandle.h"
+#include "modelselection.h"
 
 using classifier::FaceClassifier;
 using classifier::FeatureType;
@@ -28,30 +35,63 @@ class TrainingTask : public QThread {
                double s = classifier::DEFAULT_IMAGE_SIZE,
                double ts = classifier::DEFAULT_TRAINING_STEP,
                double g = classifier::DEFAULT_GAMMA,
-               FeatureType ft = classifier::LBP);
+               FeatureType ft = classifier::LBP,
+               FaceClassifier::FaceClassifierBackend b =
+                   FaceClassifier::SVM_BACKEND);
   virtual ~TrainingTask();
   virtual void run();
-
- public slots:
-  void captureMessage(QString message);
+  void setBackgroundClass(bool enable);
+  void setProjection(classifier::ProjectionType type);
+  // the time budget covers loading too, not only the search
+  void setBudget(const classifier::TrainingBudget& budget);
+  // train every feature type and keep the best within the target
+  void setAutoFeature(bool enable, double latencyTarget =
+                          classifier::DEFAULT_LATENCY_TARGET);
+  void setEnrollment(std::shared_ptr<FaceClassifier> live,
+                     QString person, int label,
+                     QString modelPath, QString extraPath);
+  // a copy of the live model with the person enrolled, to be published
+  std::shared_ptr<FaceClassifier> getEnrolledClassifier() const;
 
  signals:
   void sendMessage(QString message);
   void complete(QString modelPath,
                 QString extraPath,
                 QMap<int, QString> names);
+  void enrolled(QString person, int label);
 
  private:
+  QString fingerprint(const classifier::LoadingParams& params);
+  // hands core messages on as sendMessage signals
+  classifier::MessageCallback forwarder();
+  void loadData(classifier::LoadingParams& params,
+                const vector<FeatureType>& types, vector<Mat>& data,
+                vector<double>& extractionTime,
+                classifier::DataSplit& split);
+
   QString faceImageDirectory, modelBaseName, modelExtension;
   QString modelBasePath, extraInfoBaseName;
   double loadingPercent;
   double trainingStep;
   double defaultGamma;
   FeatureType featureType;
+  FaceClassifier::FaceClassifierBackend backend;
+  bool backgroundClass = true;
+  classifier::ProjectionType projection = classifier::NO_PROJECTION;
+  classifier::TrainingBudget budget;
+  bool autoFeature = false;
+  double latencyTarget = classifier::DEFAULT_LATENCY_TARGET;
   map<int, string> names;
   FaceClassifier* faceClassifier = nullptr;
   Mat trainingData, trainingLabel;
   Size trainingSize;
+  // incremental enrollment into a copy of the live classifier
+  std::shared_ptr<FaceClassifier> liveClassifier;
+  std::shared_ptr<FaceClassifier> enrolledClassifier;
+  QString enrollPerson, enrollModelPath, enrollExtraPath;
+  int enrollLabel = 0;
+
+  void runEnrollment();
 };
 
 #endif // TRAININGTASK_H
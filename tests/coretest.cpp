@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/ml.hpp>
+
+#include "common.h"
+#include "svmevaluator.h"
+
+#define CLASS_COUNT 3
+#define SAMPLES_PER_CLASS 20
+#define VAR_COUNT 16
+#define MARGIN_TOLERANCE 1e-6
+
+using std::string;
+using std::vector;
+using cv::Mat;
+using cv::Ptr;
+using cv::RNG;
+using cv::ml::SVM;
+using cv::ml::TrainData;
+using classifier::SVMEvaluator;
+
+static int failures = 0;
+
+static void check(bool passed, const string& what) {
+  if (!passed) {
+    fprintf(stderr, "FAIL: %s\n", what.c_str());
+    failures ++;
+  }
+}
+
+/****** SVMEvaluator ******/
+// well separated clusters of histogram like counts, so no sample lies
+// on a decision boundary where float and double rounding could differ
+static void makeClusters(RNG& rng, int perClass, Mat& data, Mat& labels) {
+  data.create(CLASS_COUNT * perClass, VAR_COUNT, CV_32FC1);
+  labels.create(CLASS_COUNT * perClass, 1, CV_32SC1);
+  for (int c = 0 ; c < CLASS_COUNT ; c ++) {
+    for (int i = 0 ; i < perClass ; i ++) {
+      const int row = c * perClass + i;
+      float* values = data.ptr<float>(row);
+      for (int j = 0 ; j < VAR_COUNT ; j ++) {
+        const float center = j % CLASS_COUNT == c ? 8.0f : 1.0f;
+        values[j] = center + static_cast<float>(rng.uniform(-0.5, 0.5));
+      }
+      labels.ptr<int>(row)[0] = c * 10;
+    }
+  }
+}
+
+static void testKernel(int kernelType, const string& name) {
+  RNG rng(kernelType + 1);
+  Mat data, labels, samples, sampleLabels;
+  makeClusters(rng, SAMPLES_PER_CLASS, data, labels);
+  makeClusters(rng, SAMPLES_PER_CLASS / 2, samples, sampleLabels);
+
+  Ptr<SVM> svm = SVM::create();
+  svm->setType(SVM::C_SVC);
+  svm->setKernel(kernelType);
+  svm->setC(1);
+  svm->setGamma(1.0 / (VAR_COUNT * 16));
+  svm->setCoef0(kernelType == SVM::SIGMOID ? 0 : 1);
+  svm->setDegree(2);
+  svm->train(TrainData::create(data, cv::ml::ROW_SAMPLE, labels));
+  check(svm->isTrained(), name + " svm trained");
+
+  vector<int> classLabels;
+  for (int c = 0 ; c < CLASS_COUNT ; c ++) {
+    classLabels.push_back(c * 10);
+  }
+  SVMEvaluator evaluator;
+  check(evaluator.build(svm, classLabels), name + " evaluator built");
+  if (!evaluator.isReady()) {
+    return;
+  }
+
+  Mat expected;
+  svm->predict(samples, expected);
+  vector<vector<int> > votes;
+  vector<vector<double> > margins;
+  check(evaluator.classScores(samples, votes, margins),
+        name + " batched class scores");
+  if (static_cast<int>(votes.size()) != samples.rows) {
+    return;
+  }
+
+  for (int i = 0 ; i < samples.rows ; i ++) {
+    const string sample = name + " sample " + toString(i);
+    const int label = cvRound(expected.ptr<float>(i)[0]);
+    check(evaluator.predict(samples.row(i)) == label,
+          sample + " predict matches cv::ml::SVM");
+
+    int best = 0;
+    for (int c = 1 ; c < CLASS_COUNT ; c ++) {
+      if (votes[i][c] > votes[i][best]) {
+        best = c;
+      }
+    }
+    check(evaluator.getClassLabel(best) == label,
+          sample + " batched votes match cv::ml::SVM");
+
+    vector<int> singleVotes;
+    vector<double> singleMargins;
+    evaluator.classScores(samples.row(i), singleVotes, singleMargins);
+    check(singleVotes == votes[i], sample + " batched votes match single");
+    if (singleMargins.size() != margins[i].size()) {
+      check(false, sample + " batched margin count matches single");
+      continue;
+    }
+    for (size_t c = 0 ; c < singleMargins.size() ; c ++) {
+      const double difference = fabs(singleMargins[c] - margins[i][c]);
+      check(difference <= MARGIN_TOLERANCE *
+            std::max(1.0, fabs(singleMargins[c])),
+            sample + " batched margins match single");
+    }
+  }
+}
+/*----- end of SVMEvaluator -----*/
+
+/****** base64 ******/
+static void testBase64() {
+  check(encodeBase64("foobar", 6) == "Zm9vYmFy", "base64 of foobar");
+  check(encodeBase64("fooba", 5) == "Zm9vYmE=", "base64 of fooba");
+  check(encodeBase64("foob", 4) == "Zm9vYg==", "base64 of foob");
+  check(encodeBase64("", 0).empty(), "base64 of nothing");
+
+  RNG rng(7);
+  for (int length = 0 ; length <= 1000 ; length += length < 16 ? 1 : 97) {
+    string data(length, '\0');
+    for (int i = 0 ; i < length ; i ++) {
+      data[i] = static_cast<char>(rng.uniform(0, 256));
+    }
+    const string text = encodeBase64(data.data(), data.size());
+    check(text.size() == (data.size() + 2) / 3 * 4,
+          "base64 length of " + toString(length) + " bytes");
+    check(decodeBase64(text) == data,
+          "base64 round trip of " + toString(length) + " bytes");
+  }
+}
+/*----- end of base64 -----*/
+
+int main() {
+  testKernel(SVM::LINEAR, "linear");
+  testKernel(SVM::POLY, "poly");
+  testKernel(SVM::RBF, "rbf");
+  testKernel(SVM::SIGMOID, "sigmoid");
+  testBase64();
+
+  if (failures > 0) {
+    fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
+
+#undef CLASS_COUNT
+#undef SAMPLES_PER_CLASS
+#undef VAR_COUNT
+#undef MARGIN_TOLERANCE
@@ -0,0 +1,11 @@
+# checks of the core library, `make check` runs them
+
+TARGET = FaceRecognitionTests
+TEMPLATE = app
+
+CONFIG += console testcase
+CONFIG -= qt app_bundle
+
+include(../core/core.pri)
+
+SOURCES += coretest.cpp